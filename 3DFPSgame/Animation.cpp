@@ -0,0 +1,307 @@
+#include "Animation.hpp"
+#include "Model.hpp"
+
+#include <Jolt/Jolt.h>
+#include <Jolt/Math/Mat44.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+
+using namespace JPH;
+
+static size_t padded(size_t count) {
+    return (count + 3) & ~size_t(3);
+}
+
+void JointPose::resize(size_t jointCount) {
+    mJointCount = jointCount;
+    size_t size = padded(jointCount);
+    for (std::vector<float>* channel : { &tx, &ty, &tz, &rx, &ry, &rz, &sx, &sy, &sz })
+        channel->assign(size, 0.0f);
+    rw.assign(size, 1.0f);
+}
+
+void JointPose::set(size_t joint, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale) {
+    tx[joint] = translation.x;
+    ty[joint] = translation.y;
+    tz[joint] = translation.z;
+    rx[joint] = rotation.x;
+    ry[joint] = rotation.y;
+    rz[joint] = rotation.z;
+    rw[joint] = rotation.w;
+    sx[joint] = scale.x;
+    sy[joint] = scale.y;
+    sz[joint] = scale.z;
+}
+
+glm::mat4 JointPose::localMatrix(size_t joint) const {
+    glm::mat4 matrix = glm::mat4_cast(glm::quat(rw[joint], rx[joint], ry[joint], rz[joint]));
+    matrix[0] *= sx[joint];
+    matrix[1] *= sy[joint];
+    matrix[2] *= sz[joint];
+    matrix[3] = glm::vec4(tx[joint], ty[joint], tz[joint], 1.0f);
+    return matrix;
+}
+
+int Skeleton::find(const std::string& name) const {
+    auto it = mIndexByName.find(name);
+    return it == mIndexByName.end() ? -1 : it->second;
+}
+
+int Skeleton::addJoint(const std::string& name, int parent, const glm::mat4& inverseBindMatrix) {
+    int index = (int)names.size();
+    names.push_back(name);
+    parents.push_back(parent);
+    inverseBind.push_back(inverseBindMatrix);
+    mIndexByName.emplace(name, index);
+    return index;
+}
+
+// Index of the key at or before time and the fraction towards the next one
+static float findKey(const std::vector<float>& times, float time, size_t& outKey) {
+    if (times.size() < 2 || time <= times.front()) {
+        outKey = 0;
+        return 0.0f;
+    }
+    if (time >= times.back()) {
+        outKey = times.size() - 2;
+        return 1.0f;
+    }
+    outKey = (size_t)(std::upper_bound(times.begin(), times.end(), time) - times.begin()) - 1;
+    return (time - times[outKey]) / (times[outKey + 1] - times[outKey]);
+}
+
+void PoseSampler::sample(const Skeleton& skeleton, const AnimationClip& clip, float time, bool loop, JointPose& outPose) {
+    size_t jointCount = skeleton.size();
+    if (from.size() != jointCount) {
+        from.resize(jointCount);
+        to.resize(jointCount);
+        positionT.assign(padded(jointCount), 0.0f);
+        rotationT.assign(padded(jointCount), 0.0f);
+        scaleT.assign(padded(jointCount), 0.0f);
+    }
+    if (outPose.size() != jointCount)
+        outPose.resize(jointCount);
+
+    if (clip.duration > 0.0f)
+        time = loop ? std::fmod(std::max(time, 0.0f), clip.duration) : std::min(std::max(time, 0.0f), clip.duration);
+
+    // Scalar pass: find the bracketing keys per channel. Joints without keys get
+    // their rest value on both sides.
+    const JointPose& rest = skeleton.restPose;
+    for (size_t j = 0; j < jointCount; j++) {
+        const JointTrack* track = j < clip.tracks.size() ? &clip.tracks[j] : nullptr;
+        size_t key;
+
+        if (track && !track->positions.empty()) {
+            positionT[j] = findKey(track->positionTimes, time, key);
+            const glm::vec3& a = track->positions[key];
+            const glm::vec3& b = track->positions[std::min(key + 1, track->positions.size() - 1)];
+            from.tx[j] = a.x; from.ty[j] = a.y; from.tz[j] = a.z;
+            to.tx[j] = b.x; to.ty[j] = b.y; to.tz[j] = b.z;
+        }
+        else {
+            positionT[j] = 0.0f;
+            from.tx[j] = to.tx[j] = rest.tx[j];
+            from.ty[j] = to.ty[j] = rest.ty[j];
+            from.tz[j] = to.tz[j] = rest.tz[j];
+        }
+
+        if (track && !track->rotations.empty()) {
+            rotationT[j] = findKey(track->rotationTimes, time, key);
+            const glm::quat& a = track->rotations[key];
+            const glm::quat& b = track->rotations[std::min(key + 1, track->rotations.size() - 1)];
+            from.rx[j] = a.x; from.ry[j] = a.y; from.rz[j] = a.z; from.rw[j] = a.w;
+            to.rx[j] = b.x; to.ry[j] = b.y; to.rz[j] = b.z; to.rw[j] = b.w;
+        }
+        else {
+            rotationT[j] = 0.0f;
+            from.rx[j] = to.rx[j] = rest.rx[j];
+            from.ry[j] = to.ry[j] = rest.ry[j];
+            from.rz[j] = to.rz[j] = rest.rz[j];
+            from.rw[j] = to.rw[j] = rest.rw[j];
+        }
+
+        if (track && !track->scales.empty()) {
+            scaleT[j] = findKey(track->scaleTimes, time, key);
+            const glm::vec3& a = track->scales[key];
+            const glm::vec3& b = track->scales[std::min(key + 1, track->scales.size() - 1)];
+            from.sx[j] = a.x; from.sy[j] = a.y; from.sz[j] = a.z;
+            to.sx[j] = b.x; to.sy[j] = b.y; to.sz[j] = b.z;
+        }
+        else {
+            scaleT[j] = 0.0f;
+            from.sx[j] = to.sx[j] = rest.sx[j];
+            from.sy[j] = to.sy[j] = rest.sy[j];
+            from.sz[j] = to.sz[j] = rest.sz[j];
+        }
+    }
+
+    // SIMD pass over four joints at a time
+    auto load = [](const std::vector<float>& channel, size_t i) {
+        return Vec4::sLoadFloat4(reinterpret_cast<const Float4*>(&channel[i]));
+    };
+    auto store = [](std::vector<float>& channel, size_t i, Vec4Arg value) {
+        value.StoreFloat4(reinterpret_cast<Float4*>(&channel[i]));
+    };
+
+    for (size_t i = 0; i < padded(jointCount); i += 4) {
+        Vec4 t = load(positionT, i);
+        store(outPose.tx, i, load(from.tx, i) + (load(to.tx, i) - load(from.tx, i)) * t);
+        store(outPose.ty, i, load(from.ty, i) + (load(to.ty, i) - load(from.ty, i)) * t);
+        store(outPose.tz, i, load(from.tz, i) + (load(to.tz, i) - load(from.tz, i)) * t);
+
+        t = load(scaleT, i);
+        store(outPose.sx, i, load(from.sx, i) + (load(to.sx, i) - load(from.sx, i)) * t);
+        store(outPose.sy, i, load(from.sy, i) + (load(to.sy, i) - load(from.sy, i)) * t);
+        store(outPose.sz, i, load(from.sz, i) + (load(to.sz, i) - load(from.sz, i)) * t);
+    }
+
+    // Keys of one track sit on the same hemisphere in practice, but nlerp with the
+    // sign fix costs the same as without
+    for (size_t i = 0; i < padded(jointCount); i += 4) {
+        Vec4 t = load(rotationT, i);
+        Vec4 ax = load(from.rx, i), ay = load(from.ry, i), az = load(from.rz, i), aw = load(from.rw, i);
+        Vec4 bx = load(to.rx, i), by = load(to.ry, i), bz = load(to.rz, i), bw = load(to.rw, i);
+
+        Vec4 dot = ax * bx + ay * by + az * bz + aw * bw;
+        Vec4 sign = Vec4::sSelect(Vec4::sReplicate(1.0f), Vec4::sReplicate(-1.0f), Vec4::sLess(dot, Vec4::sZero()));
+        Vec4 x = ax + (bx * sign - ax) * t;
+        Vec4 y = ay + (by * sign - ay) * t;
+        Vec4 z = az + (bz * sign - az) * t;
+        Vec4 w = aw + (bw * sign - aw) * t;
+        Vec4 invLength = Vec4::sReplicate(1.0f) / (x * x + y * y + z * z + w * w).Sqrt();
+
+        store(outPose.rx, i, x * invLength);
+        store(outPose.ry, i, y * invLength);
+        store(outPose.rz, i, z * invLength);
+        store(outPose.rw, i, w * invLength);
+    }
+}
+
+void blendPoses(const JointPose& a, const JointPose& b, float weight, JointPose& outPose) {
+    if (outPose.size() != a.size())
+        outPose.resize(a.size());
+
+    Vec4 t = Vec4::sReplicate(weight);
+    auto lerp = [&](const std::vector<float>& from, const std::vector<float>& to, std::vector<float>& out, size_t i) {
+        Vec4 value = Vec4::sLoadFloat4(reinterpret_cast<const Float4*>(&from[i]));
+        value += (Vec4::sLoadFloat4(reinterpret_cast<const Float4*>(&to[i])) - value) * t;
+        value.StoreFloat4(reinterpret_cast<Float4*>(&out[i]));
+    };
+
+    for (size_t i = 0; i < padded(a.size()); i += 4) {
+        lerp(a.tx, b.tx, outPose.tx, i);
+        lerp(a.ty, b.ty, outPose.ty, i);
+        lerp(a.tz, b.tz, outPose.tz, i);
+        lerp(a.sx, b.sx, outPose.sx, i);
+        lerp(a.sy, b.sy, outPose.sy, i);
+        lerp(a.sz, b.sz, outPose.sz, i);
+
+        auto load = [i](const std::vector<float>& channel) { return Vec4::sLoadFloat4(reinterpret_cast<const Float4*>(&channel[i])); };
+        Vec4 ax = load(a.rx), ay = load(a.ry), az = load(a.rz), aw = load(a.rw);
+        Vec4 bx = load(b.rx), by = load(b.ry), bz = load(b.rz), bw = load(b.rw);
+        Vec4 dot = ax * bx + ay * by + az * bz + aw * bw;
+        Vec4 sign = Vec4::sSelect(Vec4::sReplicate(1.0f), Vec4::sReplicate(-1.0f), Vec4::sLess(dot, Vec4::sZero()));
+        Vec4 x = ax + (bx * sign - ax) * t;
+        Vec4 y = ay + (by * sign - ay) * t;
+        Vec4 z = az + (bz * sign - az) * t;
+        Vec4 w = aw + (bw * sign - aw) * t;
+        Vec4 invLength = Vec4::sReplicate(1.0f) / (x * x + y * y + z * z + w * w).Sqrt();
+        (x * invLength).StoreFloat4(reinterpret_cast<Float4*>(&outPose.rx[i]));
+        (y * invLength).StoreFloat4(reinterpret_cast<Float4*>(&outPose.ry[i]));
+        (z * invLength).StoreFloat4(reinterpret_cast<Float4*>(&outPose.rz[i]));
+        (w * invLength).StoreFloat4(reinterpret_cast<Float4*>(&outPose.rw[i]));
+    }
+}
+
+void computeSkinMatrices(const Skeleton& skeleton, const JointPose& pose, std::vector<glm::mat4>& scratchGlobals, glm::mat4* outSkin) {
+    scratchGlobals.resize(skeleton.size());
+    for (size_t j = 0; j < skeleton.size(); j++) {
+        glm::mat4 local = pose.localMatrix(j);
+        int parent = skeleton.parents[j];
+        scratchGlobals[j] = parent < 0 ? local : scratchGlobals[parent] * local;
+        outSkin[j] = skeleton.globalInverse * scratchGlobals[j] * skeleton.inverseBind[j];
+    }
+}
+
+void skinVertices(const std::vector<Vertex>& vertices, const std::vector<VertexSkin>& skin,
+    const glm::mat4* skinMatrices, Vertex* outVertices) {
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const VertexSkin& influences = skin[i];
+
+        // glm matrices are column major like Mat44, so they load directly
+        Mat44 blended = Mat44::sZero();
+        for (int k = 0; k < cMaxJointInfluences; k++) {
+            if (influences.weights[k] <= 0.0f)
+                continue;
+            Mat44 joint = Mat44::sLoadFloat4x4(reinterpret_cast<const Float4*>(&skinMatrices[influences.joints[k]][0][0]));
+            blended = blended + joint * influences.weights[k];
+        }
+
+        const Vertex& source = vertices[i];
+        Vertex& target = outVertices[i];
+        Vec3 position = blended * Vec3(source.position.x, source.position.y, source.position.z);
+        Vec3 normal = blended.Multiply3x3(Vec3(source.normal.x, source.normal.y, source.normal.z)).NormalizedOr(Vec3::sAxisY());
+        target.position = glm::vec3(position.GetX(), position.GetY(), position.GetZ());
+        target.normal = glm::vec3(normal.GetX(), normal.GetY(), normal.GetZ());
+        target.texCoords = source.texCoords;
+    }
+}
+
+PoseCache::PoseCache(float inSampleRate)
+    : mSampleRate(inSampleRate) {
+}
+
+void PoseCache::beginFrame() {
+    mEntries.clear();
+    mMatrices.clear();
+    mSamples = 0;
+    mHits = 0;
+}
+
+int64_t PoseCache::frameAt(const AnimationClip& clip, float time, bool loop) const {
+    if (loop && clip.duration > 0.0f)
+        time = std::fmod(std::max(time, 0.0f), clip.duration);
+    return (int64_t)std::floor(time * mSampleRate);
+}
+
+uint32_t PoseCache::acquire(const Skeleton& skeleton, const AnimationClip& clip, float time, bool loop) {
+    Key key{ &clip, frameAt(clip, time, loop) };
+    auto [it, inserted] = mEntries.emplace(key, (uint32_t)mMatrices.size());
+    if (!inserted) {
+        mHits++;
+        return it->second;
+    }
+
+    mSampler.sample(skeleton, clip, (float)key.frame / mSampleRate, loop, mPose);
+    mMatrices.resize(mMatrices.size() + skeleton.size());
+    computeSkinMatrices(skeleton, mPose, mGlobals, &mMatrices[it->second]);
+    mSamples++;
+    return it->second;
+}
+
+uint32_t PoseCache::acquire(const Skeleton& skeleton, const AnimationClip& from, float fromTime,
+    const AnimationClip& clip, float time, float weight, bool loop) {
+    int32_t step = (int32_t)std::lround(std::min(std::max(weight, 0.0f), 1.0f) * cBlendSteps);
+    if (step == 0)
+        return acquire(skeleton, from, fromTime, loop);
+    if (step == cBlendSteps || &from == &clip)
+        return acquire(skeleton, clip, time, loop);
+
+    Key key{ &clip, frameAt(clip, time, loop), &from, frameAt(from, fromTime, loop), step };
+    auto [it, inserted] = mEntries.emplace(key, (uint32_t)mMatrices.size());
+    if (!inserted) {
+        mHits++;
+        return it->second;
+    }
+
+    mSampler.sample(skeleton, from, (float)key.fromFrame / mSampleRate, loop, mFromPose);
+    mSampler.sample(skeleton, clip, (float)key.frame / mSampleRate, loop, mPose);
+    blendPoses(mFromPose, mPose, (float)step / cBlendSteps, mBlendedPose);
+    mMatrices.resize(mMatrices.size() + skeleton.size());
+    computeSkinMatrices(skeleton, mBlendedPose, mGlobals, &mMatrices[it->second]);
+    mSamples++;
+    return it->second;
+}
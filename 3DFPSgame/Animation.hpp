@@ -0,0 +1,140 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Vertex;
+
+// Joints a GPU-skinned mesh may use; bigger skeletons fall back to CPU skinning
+constexpr int cMaxGpuJoints = 64;
+constexpr int cMaxJointInfluences = 4;
+
+// Per-vertex joint influences, parallel to Mesh::vertices
+struct VertexSkin {
+    uint8_t joints[cMaxJointInfluences] = {};
+    float weights[cMaxJointInfluences] = {};
+};
+
+// Local joint transforms as a structure of arrays, so sampling and blending
+// run four joints at a time. Arrays are padded to a multiple of four.
+struct JointPose {
+    std::vector<float> tx, ty, tz;
+    std::vector<float> rx, ry, rz, rw;
+    std::vector<float> sx, sy, sz;
+
+    void resize(size_t jointCount);
+    size_t size() const { return mJointCount; }
+
+    void set(size_t joint, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+    glm::mat4 localMatrix(size_t joint) const;
+
+private:
+    size_t mJointCount = 0;
+};
+
+struct Skeleton {
+    std::vector<std::string> names;
+    std::vector<int> parents;             // -1 for the root; parents always come before children
+    std::vector<glm::mat4> inverseBind;   // mesh space to joint space
+    JointPose restPose;                   // for joints a clip doesn't animate
+    glm::mat4 globalInverse = glm::mat4(1.0f);
+
+    size_t size() const { return names.size(); }
+    int find(const std::string& name) const;
+    int addJoint(const std::string& name, int parent, const glm::mat4& inverseBindMatrix);
+
+private:
+    std::unordered_map<std::string, int> mIndexByName;
+};
+
+struct JointTrack {
+    std::vector<float> positionTimes;
+    std::vector<glm::vec3> positions;
+    std::vector<float> rotationTimes;
+    std::vector<glm::quat> rotations;
+    std::vector<float> scaleTimes;
+    std::vector<glm::vec3> scales;
+};
+
+struct AnimationClip {
+    std::string name;
+    float duration = 0.0f;            // seconds
+    std::vector<JointTrack> tracks;   // one per skeleton joint, empty ones hold the rest pose
+};
+
+// Keys bracketing the sample time for every joint, blended in a second SIMD pass
+struct PoseSampler {
+    JointPose from, to;
+    std::vector<float> positionT, rotationT, scaleT;
+
+    void sample(const Skeleton& skeleton, const AnimationClip& clip, float time, bool loop, JointPose& outPose);
+};
+
+// out = lerp(a, b, weight), rotations nlerped along the shortest arc
+void blendPoses(const JointPose& a, const JointPose& b, float weight, JointPose& outPose);
+
+// Walks the hierarchy and writes skeleton.size() skinning matrices
+void computeSkinMatrices(const Skeleton& skeleton, const JointPose& pose, std::vector<glm::mat4>& scratchGlobals, glm::mat4* outSkin);
+
+// Linear blend skinning with Jolt's SIMD Mat44, position and normal
+void skinVertices(const std::vector<Vertex>& vertices, const std::vector<VertexSkin>& skin,
+    const glm::mat4* skinMatrices, Vertex* outVertices);
+
+// Characters playing the same clip share one sampled pose per tick. Times are
+// snapped to sampleRate frames so characters a few milliseconds apart land on
+// the same entry; 30 Hz is below what anyone notices at gameplay distances.
+class PoseCache {
+public:
+    explicit PoseCache(float inSampleRate = 30.0f);
+
+    // Forget last frame's poses, keeping the storage
+    void beginFrame();
+
+    // Offset into matrices() of the clip's skinning matrices at time
+    uint32_t acquire(const Skeleton& skeleton, const AnimationClip& clip, float time, bool loop);
+    // Crossfade from one clip into another; weight is how far into clip, snapped
+    // to cBlendSteps so characters that switched on the same tick still share
+    uint32_t acquire(const Skeleton& skeleton, const AnimationClip& from, float fromTime,
+        const AnimationClip& clip, float time, float weight, bool loop);
+
+    static constexpr int32_t cBlendSteps = 8;
+
+    const std::vector<glm::mat4>& matrices() const { return mMatrices; }
+    uint32_t samples() const { return mSamples; }
+    uint32_t hits() const { return mHits; }
+
+private:
+    struct Key {
+        const AnimationClip* clip;
+        int64_t frame;
+        const AnimationClip* fromClip = nullptr;  // set while crossfading
+        int64_t fromFrame = 0;
+        int32_t blendStep = 0;
+        bool operator==(const Key& other) const {
+            return clip == other.clip && frame == other.frame
+                && fromClip == other.fromClip && fromFrame == other.fromFrame && blendStep == other.blendStep;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return (std::hash<const void*>()(key.clip) ^ (size_t)key.frame * 0x9E3779B1u)
+                + (std::hash<const void*>()(key.fromClip) ^ (size_t)key.fromFrame * 0x85EBCA6Bu) * 31 + (size_t)key.blendStep;
+        }
+    };
+
+    int64_t frameAt(const AnimationClip& clip, float time, bool loop) const;
+
+    float mSampleRate;
+    std::unordered_map<Key, uint32_t, KeyHash> mEntries;
+    std::vector<glm::mat4> mMatrices;
+    PoseSampler mSampler;
+    JointPose mPose;
+    JointPose mFromPose, mBlendedPose;
+    std::vector<glm::mat4> mGlobals;
+    uint32_t mSamples = 0;
+    uint32_t mHits = 0;
+};
@@ -0,0 +1,220 @@
+#include "Bots.hpp"
+#include "Determinism.hpp"
+
+#include <cmath>
+
+using namespace JPH;
+
+BotSystem::BotSystem(Physics& inPhysics, const NavGrid& inGrid, const BotSettings& inSettings)
+    : mPhysics(inPhysics),
+    mGrid(inGrid),
+    mSettings(inSettings),
+    mPathfinder(inGrid, inPhysics.getJobSystem()) {
+}
+
+BotSystem::~BotSystem() = default;
+
+uint32_t BotSystem::nextRandom() {
+    mRandomState ^= mRandomState << 13;
+    mRandomState ^= mRandomState >> 17;
+    mRandomState ^= mRandomState << 5;
+    return mRandomState;
+}
+
+uint32_t BotSystem::randomWalkableCell() {
+    for (int attempt = 0; attempt < 256; attempt++) {
+        uint32_t cell = nextRandom() % mGrid.cellCount();
+        if (mGrid.isWalkable(cell))
+            return cell;
+    }
+    return NavGrid::cInvalidCell;
+}
+
+void BotSystem::spawn(size_t count, uint32_t seed) {
+    if (!mGrid.isBuilt() || mGrid.walkableCount() == 0) {
+        std::cout << "Can't spawn bots without a nav grid." << std::endl;
+        return;
+    }
+
+    mRandomState = seed ? seed : 1;
+    if (mRoamGoals.empty()) {
+        for (unsigned int i = 0; i < mSettings.roamGoalCount; i++) {
+            uint32_t cell = randomWalkableCell();
+            if (cell != NavGrid::cInvalidCell)
+                mRoamGoals.push_back(cell);
+        }
+    }
+
+    mBots.reserve(mBots.size() + count);
+    JPH::PhysicsSystem& system = mPhysics.getPhysicsSystem();
+    for (size_t i = 0; i < count; i++) {
+        // A bot without bodies would be simulated as a ghost, so stop at capacity
+        if (system.GetNumBodies() + PhysicsCapacity::cBodiesPerPlayer > system.GetMaxBodies()) {
+            std::cout << "Physics is out of bodies after " << i << " of " << count << " bots." << std::endl;
+            break;
+        }
+        uint32_t cell = randomWalkableCell();
+        if (cell == NavGrid::cInvalidCell)
+            break;
+
+        // Drop them from a little above the floor so the capsule never starts inside it
+        glm::vec3 start = mGrid.cellCenter(cell) + glm::vec3(0.0f, 1.5f, 0.0f);
+        Bot bot;
+        bot.controller = std::make_unique<PlayerController>(start, mPhysics);
+        if (!bot.controller->hasBody()) {
+            std::cout << "Physics is out of bodies after " << i << " of " << count << " bots." << std::endl;
+            break;
+        }
+        bot.lastCheckPosition = start;
+        bot.yaw = static_cast<float>(nextRandom() % 360) - 180.0f;
+        mBots.push_back(std::move(bot));
+    }
+    std::cout << "Spawned " << mBots.size() << " bots" << std::endl;
+}
+
+void BotSystem::setProjectileSystem(ProjectileSystem* inProjectiles) {
+    for (Bot& bot : mBots)
+        bot.controller->setProjectileSystem(inProjectiles);
+}
+
+void BotSystem::setWeaponTable(const WeaponTable* inWeapons) {
+    for (Bot& bot : mBots)
+        bot.controller->setWeaponTable(inWeapons);
+}
+
+void BotSystem::update(const std::vector<glm::vec3>& targets, double deltaTime, bool deterministic) {
+    if (mBots.empty())
+        return;
+
+    mPathfinder.update(deterministic);
+
+    for (Bot& bot : mBots) {
+        PlayerInput input = think(bot, targets, static_cast<float>(deltaTime));
+        bot.controller->update(input, deltaTime);
+    }
+}
+
+int BotSystem::findVisibleTarget(const Bot& bot, const std::vector<glm::vec3>& targets) const {
+    const NarrowPhaseQuery& query = mPhysics.getPhysicsSystem().GetNarrowPhaseQuery();
+    glm::vec3 eye = bot.controller->position;
+
+    int best = -1;
+    float bestDistance = mSettings.engageRange;
+    for (size_t i = 0; i < targets.size(); i++) {
+        glm::vec3 toTarget = targets[i] - eye;
+        float distance = glm::length(toTarget);
+        if (distance >= bestDistance || distance < 0.01f)
+            continue;
+
+        // Player capsules aren't on the hitscan layers, so any hit here is a wall in the way
+        RRayCast sight(RVec3(eye.x, eye.y, eye.z), Vec3(toTarget.x, toTarget.y, toTarget.z));
+        RayCastResult hit;
+        if (query.CastRay(sight, hit, mSightFilter.broadPhase, mSightFilter.object))
+            continue;
+
+        best = static_cast<int>(i);
+        bestDistance = distance;
+    }
+    return best;
+}
+
+PlayerInput BotSystem::think(Bot& bot, const std::vector<glm::vec3>& targets, float deltaTime) {
+    PlayerInput input;
+    glm::vec3 position = bot.controller->position;
+
+    int target = findVisibleTarget(bot, targets);
+    if (target >= 0)
+        bot.goal = mGrid.findCell(targets[target]);
+    else if (bot.goal == NavGrid::cInvalidCell && !mRoamGoals.empty())
+        bot.goal = mRoamGoals[nextRandom() % mRoamGoals.size()];
+
+    // Head for the next cell along the shared route, or for the target itself once in sight
+    glm::vec3 lookAt = position;
+    bool moving = false;
+    uint32_t cell = mGrid.findCell(position);
+    uint32_t next;
+    if (cell == bot.goal && target < 0) {
+        bot.goal = NavGrid::cInvalidCell;  // arrived; pick another destination next tick
+    }
+    else if (mPathfinder.nextHop(cell, bot.goal, next)) {
+        lookAt = mGrid.cellCenter(next);
+        moving = next != cell;
+    }
+    if (target >= 0)
+        lookAt = targets[target];
+
+    glm::vec3 toLook = lookAt - position;
+    float horizontal = std::sqrt(toLook.x * toLook.x + toLook.z * toLook.z);
+    if (horizontal > 0.01f) {
+        float desiredYaw = glm::degrees(std::atan2(toLook.z, toLook.x));
+        float desiredPitch = target >= 0 ? glm::degrees(std::atan2(toLook.y, horizontal)) : 0.0f;
+
+        float maxTurn = mSettings.turnRate * deltaTime;
+        float yawError = std::remainder(desiredYaw - bot.yaw, 360.0f);
+        bot.yaw += glm::clamp(yawError, -maxTurn, maxTurn);
+        bot.pitch += glm::clamp(desiredPitch - bot.pitch, -maxTurn, maxTurn);
+
+        if (target >= 0 && std::abs(yawError) < mSettings.fireConeDegrees)
+            input.press(PlayerInput::Fire);
+    }
+    input.yaw = bot.yaw;
+    input.pitch = bot.pitch;
+
+    if (moving) {
+        input.press(PlayerInput::Forward);
+
+        // Jump when progress stalls, and give up on the goal if that doesn't help
+        bot.stuckTimer += deltaTime;
+        if (bot.stuckTimer >= mSettings.stuckCheckInterval) {
+            bool stuck = glm::length(position - bot.lastCheckPosition) < mSettings.stuckDistance;
+            bot.stuckChecks = stuck ? bot.stuckChecks + 1 : 0;
+            bot.lastCheckPosition = position;
+            bot.stuckTimer = 0.0f;
+            if (stuck)
+                input.press(PlayerInput::Jump);
+            if (bot.stuckChecks >= 3) {
+                bot.goal = NavGrid::cInvalidCell;
+                bot.stuckChecks = 0;
+            }
+        }
+    }
+
+    return input;
+}
+
+void BotSystem::appendPositions(std::vector<glm::vec3>& outPositions) const {
+    for (const Bot& bot : mBots)
+        outPositions.push_back(bot.controller->position);
+}
+
+void BotSystem::appendCharacters(std::vector<CharacterState>& outCharacters) const {
+    for (const Bot& bot : mBots) {
+        CharacterState state;
+        state.feet = bot.controller->position - glm::vec3(0.0f, bot.controller->getFootOffset(), 0.0f);
+        state.yawDegrees = bot.yaw;
+        outCharacters.push_back(state);
+    }
+}
+
+void BotSystem::appendActorFrames(std::vector<ActorFrame>& outFrames) const {
+    for (const Bot& bot : mBots) {
+        const PlayerInput& input = bot.controller->lastInput;
+        ActorFrame frame;
+        frame.position = bot.controller->position;
+        frame.yaw = input.yaw;
+        frame.pitch = input.pitch;
+        frame.buttons = input.buttons;
+        frame.weaponSlot = input.weaponSlot;
+        outFrames.push_back(frame);
+    }
+}
+
+void BotSystem::hashState(StateHasher& hasher) const {
+    hasher.add(mBots.size());
+    hasher.add(mRandomState);
+    for (const Bot& bot : mBots) {
+        hasher.add(bot.goal);
+        hasher.add(bot.yaw);
+        bot.controller->hashState(hasher);
+    }
+}
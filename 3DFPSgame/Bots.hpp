@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Characters.hpp"
+#include "Navigation.hpp"
+#include "PlayerController.hpp"
+#include "Recording.hpp"
+
+#include <memory>
+#include <vector>
+
+class StateHasher;
+class ProjectileSystem;
+class WeaponTable;
+
+struct BotSettings {
+    float engageRange = 30.0f;      // meters; closer visible targets are chased and shot
+    float fireConeDegrees = 4.0f;   // only pull the trigger when aimed this close
+    float turnRate = 360.0f;        // degrees per second
+    float stuckDistance = 0.3f;     // moving less than this per stuck check counts as stuck
+    float stuckCheckInterval = 1.0f;
+    unsigned int roamGoalCount = 8; // shared roam destinations, so paths get reused
+};
+
+// Server-side bots. Each one owns an ordinary PlayerController and drives it
+// through PlayerInput, exactly like a keyboard or a replay would, so bots move,
+// collide and shoot under the same rules as people.
+//
+// Navigation uses the shared NavPathfinder: a bot asks for the next cell towards
+// its goal every tick and simply stands still for the few ticks a fresh search
+// takes. Roaming bots pick from a small set of shared destinations, and bots
+// chasing the same player share that player's goal tree.
+class BotSystem {
+public:
+    BotSystem(Physics& inPhysics, const NavGrid& inGrid, const BotSettings& inSettings = BotSettings());
+    ~BotSystem();
+
+    // Places bots on random walkable cells; needs a built grid
+    void spawn(size_t count, uint32_t seed = 1);
+
+    void setProjectileSystem(ProjectileSystem* inProjectiles);
+    void setWeaponTable(const WeaponTable* inWeapons);
+
+    // targets are the positions bots hunt, usually the human players.
+    // deterministic runs the path searches inline so replays match.
+    void update(const std::vector<glm::vec3>& targets, double deltaTime, bool deterministic);
+
+    size_t count() const { return mBots.size(); }
+    void appendPositions(std::vector<glm::vec3>& outPositions) const;
+    void appendCharacters(std::vector<CharacterState>& outCharacters) const;
+    void appendActorFrames(std::vector<ActorFrame>& outFrames) const;
+    const NavPathfinder& getPathfinder() const { return mPathfinder; }
+    // index follows the appendPositions order
+    void addKnockback(size_t index, const glm::vec3& velocity) { mBots[index].controller->addKnockback(velocity); }
+
+    void hashState(StateHasher& hasher) const;
+
+private:
+    struct Bot {
+        std::unique_ptr<PlayerController> controller;
+        uint32_t goal = NavGrid::cInvalidCell;
+        float yaw = -90.0f;
+        float pitch = 0.0f;
+        glm::vec3 lastCheckPosition = glm::vec3(0.0f);
+        float stuckTimer = 0.0f;
+        unsigned int stuckChecks = 0;
+    };
+
+    PlayerInput think(Bot& bot, const std::vector<glm::vec3>& targets, float deltaTime);
+    int findVisibleTarget(const Bot& bot, const std::vector<glm::vec3>& targets) const;
+    uint32_t randomWalkableCell();
+    uint32_t nextRandom();
+
+    Physics& mPhysics;
+    const NavGrid& mGrid;
+    BotSettings mSettings;
+    NavPathfinder mPathfinder;
+    QueryFilter mSightFilter{ QueryLayers::HITSCAN };
+
+    std::vector<Bot> mBots;
+    std::vector<uint32_t> mRoamGoals;
+    uint32_t mRandomState = 1;
+};
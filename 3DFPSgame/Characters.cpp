@@ -0,0 +1,205 @@
+#include "Characters.hpp"
+#include "Model.hpp"
+#include "Renderer.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+CharacterAnimator::CharacterAnimator(const CharacterSettings& inSettings)
+    : mSettings(inSettings) {
+}
+
+CharacterAnimator::~CharacterAnimator() {
+    if (mReloadThread.joinable())
+        mReloadThread.join();
+}
+
+bool CharacterAnimator::load(const std::string& modelPath) {
+    // Uploaded by the render thread along with the first packet that draws it
+    mModelPath = modelPath;
+    return adopt(std::make_shared<Model>(modelPath, true));
+}
+
+bool CharacterAnimator::adopt(std::shared_ptr<Model> model) {
+    if (!model->isSkinned()) {
+        std::cout << "Character model " << mModelPath << " has no skeleton." << std::endl;
+        return false;
+    }
+    if (model->clips.empty()) {
+        std::cout << "Character model " << mModelPath << " has no animations." << std::endl;
+        return false;
+    }
+
+    // The old model's GL objects go with the next packet; draws in flight still hold it
+    if (mModel)
+        mPendingReleases.push_back(std::move(mModel));
+    mModel = std::move(model);
+    mUploadQueued = false;
+    mIdleClip = mModel->findClip(mSettings.idleClip);
+    mRunClip = mModel->findClip(mSettings.runClip);
+    if (!mIdleClip)
+        mIdleClip = &mModel->clips.front();
+    if (!mRunClip)
+        mRunClip = mIdleClip;
+
+    // Clips belonged to the old model; restart everyone on idle and let speed pick again
+    for (Instance& instance : mInstances) {
+        instance.clip = mIdleClip;
+        instance.time = 0.0f;
+        instance.fromClip = nullptr;
+        instance.blend = 1.0f;
+    }
+
+    std::cout << "Loaded character with " << mModel->skeleton.size() << " joints and "
+        << mModel->clips.size() << " clips" << std::endl;
+    return true;
+}
+
+bool CharacterAnimator::reloadIfUses(const std::string& file) {
+    if (!mModel || !mModel->usesFile(file))
+        return false;
+    if (mReloadThread.joinable())
+        mReloadAgain = true;
+    else
+        startReload();
+    return true;
+}
+
+void CharacterAnimator::startReload() {
+    mReloadThread = std::thread([this, path = mModelPath] {
+        std::shared_ptr<Model> model = std::make_shared<Model>(path, true);
+        std::lock_guard<std::mutex> lock(mReloadMutex);
+        mReloaded = std::move(model);
+    });
+}
+
+void CharacterAnimator::finishReload() {
+    std::shared_ptr<Model> reloaded;
+    {
+        std::lock_guard<std::mutex> lock(mReloadMutex);
+        reloaded = std::move(mReloaded);
+    }
+    if (!reloaded)
+        return;
+
+    mReloadThread.join();
+    if (!adopt(std::move(reloaded)))
+        std::cout << "Reload of " << mModelPath << " failed, keeping the old character" << std::endl;
+
+    if (mReloadAgain) {
+        mReloadAgain = false;
+        startReload();
+    }
+}
+
+void CharacterAnimator::update(const std::vector<CharacterState>& states, float deltaTime) {
+    if (mReloadThread.joinable())
+        finishReload();
+    if (!mModel)
+        return;
+
+    // New characters start at different points in the clip so crowds don't march in step
+    while (mInstances.size() < states.size()) {
+        Instance instance;
+        instance.feet = states[mInstances.size()].feet;
+        instance.clip = mIdleClip;
+        instance.time = std::fmod((float)mInstances.size() * 0.37f, std::max(mIdleClip->duration, 0.001f));
+        mInstances.push_back(instance);
+    }
+    mInstances.resize(states.size());
+
+    for (size_t i = 0; i < states.size(); i++) {
+        Instance& instance = mInstances[i];
+        glm::vec2 moved(states[i].feet.x - instance.feet.x, states[i].feet.z - instance.feet.z);
+        float speed = deltaTime > 0.0f ? glm::length(moved) / deltaTime : 0.0f;
+        instance.speed = glm::mix(instance.speed, speed, 0.2f);
+        instance.feet = states[i].feet;
+        instance.yawDegrees = states[i].yawDegrees;
+
+        const AnimationClip* clip = instance.speed > mSettings.runSpeed ? mRunClip : mIdleClip;
+        if (clip != instance.clip) {
+            // Fade out of whatever was showing rather than snapping to the new clip
+            instance.fromClip = instance.clip;
+            instance.fromTime = instance.time;
+            instance.clip = clip;
+            instance.time = 0.0f;
+            instance.blend = 0.0f;
+        }
+        instance.time += deltaTime;
+        if (clip->duration > 0.0f && instance.time > clip->duration)
+            instance.time = std::fmod(instance.time, clip->duration);
+
+        if (instance.blend < 1.0f) {
+            instance.fromTime += deltaTime;
+            instance.blend = mSettings.crossfadeTime > 0.0f ? std::min(instance.blend + deltaTime / mSettings.crossfadeTime, 1.0f) : 1.0f;
+            if (instance.blend >= 1.0f)
+                instance.fromClip = nullptr;
+        }
+    }
+}
+
+void CharacterAnimator::collectDraws(RenderPacket& packet) {
+    packet.releases.insert(packet.releases.end(), mPendingReleases.begin(), mPendingReleases.end());
+    mPendingReleases.clear();
+
+    if (!mModel || mInstances.empty())
+        return;
+
+    if (!mUploadQueued) {
+        packet.uploads.push_back(mModel);
+        mUploadQueued = true;
+    }
+
+    const Skeleton& skeleton = mModel->skeleton;
+    bool gpuSkinning = !mSettings.cpuSkinning && skeleton.size() <= (size_t)cMaxGpuJoints;
+    uint32_t matrixBase = (uint32_t)packet.skinMatrices.size();
+
+    glm::vec3 center = (mModel->boundsMin + mModel->boundsMax) * 0.5f;
+    glm::vec3 halfExtents = (mModel->boundsMax - mModel->boundsMin) * (0.5f + mSettings.boundsPadding);
+
+    mPoseCache.beginFrame();
+    mSkinnedPoses.clear();
+
+    for (const Instance& instance : mInstances) {
+        // Models face +Z; turn that onto the yaw's forward vector
+        float yaw = glm::radians(instance.yawDegrees);
+        float heading = std::atan2(std::cos(yaw), std::sin(yaw));
+        glm::mat4 world = glm::rotate(glm::translate(glm::mat4(1.0f), instance.feet), heading, glm::vec3(0.0f, 1.0f, 0.0f));
+
+        DrawItem item{ mModel.get(), world, transformBounds(center - halfExtents, center + halfExtents, world) };
+        uint32_t pose = instance.fromClip
+            ? mPoseCache.acquire(skeleton, *instance.fromClip, instance.fromTime, *instance.clip, instance.time, instance.blend, true)
+            : mPoseCache.acquire(skeleton, *instance.clip, instance.time, true);
+
+        if (gpuSkinning) {
+            item.skinOffset = matrixBase + pose;
+            item.skinCount = (uint32_t)skeleton.size();
+        }
+        else {
+            auto shared = std::find_if(mSkinnedPoses.begin(), mSkinnedPoses.end(),
+                [pose](const auto& entry) { return entry.first == pose; });
+            if (shared != mSkinnedPoses.end()) {
+                item.skinnedVertexOffset = shared->second;
+            }
+            else {
+                item.skinnedVertexOffset = (int32_t)packet.skinnedVertices.size();
+                packet.skinnedVertices.resize(packet.skinnedVertices.size() + mModel->vertexCount());
+
+                Vertex* out = &packet.skinnedVertices[item.skinnedVertexOffset];
+                for (const Mesh& mesh : mModel->meshes) {
+                    skinVertices(mesh.vertices, mesh.skin, &mPoseCache.matrices()[pose], out);
+                    out += mesh.vertices.size();
+                }
+                mSkinnedPoses.emplace_back(pose, item.skinnedVertexOffset);
+            }
+        }
+
+        packet.cameraDraws.push_back((uint32_t)packet.draws.size());
+        packet.draws.push_back(item);
+    }
+
+    if (gpuSkinning)
+        packet.skinMatrices.insert(packet.skinMatrices.end(), mPoseCache.matrices().begin(), mPoseCache.matrices().end());
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Animation.hpp"
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Model;
+struct RenderPacket;
+
+// Where a character stands and which way it faces, from gameplay
+struct CharacterState {
+    glm::vec3 feet = glm::vec3(0.0f);
+    float yawDegrees = -90.0f;  // Camera convention, -90 faces -Z
+};
+
+struct CharacterSettings {
+    std::string idleClip = "idle";
+    std::string runClip = "run";
+    float runSpeed = 1.0f;          // m/s over the ground above which the run clip plays
+    float crossfadeTime = 0.2f;     // seconds to blend from one clip into the next
+    float boundsPadding = 0.25f;    // bind pose bounds grow by this fraction to cover animation
+    bool cpuSkinning = false;       // skeletons over cMaxGpuJoints skin on the CPU regardless
+};
+
+// Poses and draws animated characters. Each tick every character advances its
+// clip time, characters on the same clip and sample frame share one pose from
+// the PoseCache, and draws go out either GPU-skinned (matrices in the packet)
+// or CPU-skinned (posed vertices in the packet, also shared per pose).
+class CharacterAnimator {
+public:
+    explicit CharacterAnimator(const CharacterSettings& inSettings = CharacterSettings());
+    ~CharacterAnimator();
+
+    // The model must be skinned; clips are looked up by name, falling back to the
+    // first clip in the file
+    bool load(const std::string& modelPath);
+    bool isLoaded() const { return mModel != nullptr; }
+
+    // Hot reload: decodes the model again on a thread of its own and swaps it in
+    // during a later update(). False if the file isn't part of the model.
+    bool reloadIfUses(const std::string& file);
+    void setCpuSkinning(bool enabled) { mSettings.cpuSkinning = enabled; }
+
+    // One state per character, in the same order every tick
+    void update(const std::vector<CharacterState>& states, float deltaTime);
+
+    // Appends every character to the packet's draws and camera pass
+    void collectDraws(RenderPacket& packet);
+
+    uint32_t poseSamples() const { return mPoseCache.samples(); }
+    uint32_t poseHits() const { return mPoseCache.hits(); }
+
+private:
+    struct Instance {
+        glm::vec3 feet = glm::vec3(0.0f);
+        float yawDegrees = -90.0f;
+        float speed = 0.0f;
+        const AnimationClip* clip = nullptr;
+        float time = 0.0f;
+        const AnimationClip* fromClip = nullptr;  // the clip being faded out
+        float fromTime = 0.0f;
+        float blend = 1.0f;                        // 1 once the fade into clip is done
+    };
+
+    bool adopt(std::shared_ptr<Model> model);
+    void startReload();
+    void finishReload();
+
+    CharacterSettings mSettings;
+    std::string mModelPath;
+    std::shared_ptr<Model> mModel;
+    std::vector<std::shared_ptr<Model>> mPendingReleases;  // replaced models, until the next packet
+    bool mUploadQueued = false;
+    const AnimationClip* mIdleClip = nullptr;
+    const AnimationClip* mRunClip = nullptr;
+
+    std::vector<Instance> mInstances;
+    PoseCache mPoseCache;
+    std::vector<std::pair<uint32_t, int32_t>> mSkinnedPoses;  // pose offset, skinned vertex offset
+
+    std::thread mReloadThread;
+    std::mutex mReloadMutex;
+    std::shared_ptr<Model> mReloaded;  // under mReloadMutex, set once the decode finishes
+    bool mReloadAgain = false;         // the file changed again while it was decoding
+};
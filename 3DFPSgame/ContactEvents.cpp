@@ -0,0 +1,105 @@
+#include "ContactEvents.hpp"
+
+#include <algorithm>
+#include <tuple>
+
+using namespace JPH;
+
+static uint64_t pairKey(const ContactEvent& event)
+{
+    return (uint64_t)event.body1.GetIndexAndSequenceNumber() << 32 | event.body2.GetIndexAndSequenceNumber();
+}
+
+static auto sortKey(const ContactEvent& event)
+{
+    return std::make_tuple(pairKey(event), event.type);
+}
+
+static bool isContact(const ContactEvent& event)
+{
+    return event.type == ContactEventType::Added || event.type == ContactEventType::Removed;
+}
+
+void ContactEventQueue::push(const ContactEvent& event)
+{
+    uint32_t slot = currentThreadSlot();
+    if (slot != cNoThreadSlot)
+    {
+        mBuffers[slot].events.push_back(event);
+        return;
+    }
+
+    std::lock_guard lock(mOverflowMutex);
+    mOverflow.push_back(event);
+}
+
+void ContactEventQueue::merge()
+{
+    mPushed.clear();
+    for (ThreadBuffer& buffer : mBuffers)
+    {
+        mPushed.insert(mPushed.end(), buffer.events.begin(), buffer.events.end());
+        buffer.events.clear();
+    }
+    mPushed.insert(mPushed.end(), mOverflow.begin(), mOverflow.end());
+    mOverflow.clear();
+
+    // Sorting by pair makes the order independent of which worker saw what.
+    // Within a pair, Added sorts before Removed and the hardest impact comes
+    // first, so that is the one a body pair's Added reports.
+    std::sort(mPushed.begin(), mPushed.end(), [](const ContactEvent& a, const ContactEvent& b)
+    {
+        auto keyA = sortKey(a), keyB = sortKey(b);
+        if (keyA != keyB)
+            return keyA < keyB;
+        if (a.impactSpeed != b.impactSpeed)
+            return a.impactSpeed > b.impactSpeed;
+        return std::make_pair(a.subShape1.GetValue(), a.subShape2.GetValue()) < std::make_pair(b.subShape1.GetValue(), b.subShape2.GetValue());
+    });
+
+    // Walk this step's pairs alongside the live counts, both sorted by pair, and
+    // build next step's counts. Pairs with no events carry over unchanged.
+    mEvents.clear();
+    mNextLive.clear();
+    size_t live = 0;
+    for (size_t i = 0; i < mPushed.size();)
+    {
+        const ContactEvent& first = mPushed[i];
+        uint64_t pair = pairKey(first);
+        size_t end = i;
+        uint32_t added = 0, removed = 0;
+        for (; end < mPushed.size() && pairKey(mPushed[end]) == pair; end++)
+        {
+            added += mPushed[end].type == ContactEventType::Added;
+            removed += mPushed[end].type == ContactEventType::Removed;
+        }
+
+        if (!isContact(first))
+        {
+            // Activation events carry no pair to count, one per type is enough
+            for (size_t j = i; j < end; j++)
+                if (j == i || mPushed[j].type != mPushed[j - 1].type)
+                    mEvents.push_back(mPushed[j]);
+            i = end;
+            continue;
+        }
+
+        while (live < mLive.size() && mLive[live].pair < pair)
+            mNextLive.push_back(mLive[live++]);
+        uint32_t before = 0;
+        if (live < mLive.size() && mLive[live].pair == pair)
+            before = mLive[live++].contacts;
+        uint32_t after = before + added > removed ? before + added - removed : 0;
+
+        if (before == 0 && added > 0)
+            mEvents.push_back(first);
+        // Also covers a pair that touched and separated within the one step
+        if (after == 0 && removed > 0 && (before > 0 || added > 0))
+            mEvents.push_back(mPushed[i + added]);
+        if (after > 0)
+            mNextLive.push_back({ pair, after });
+        i = end;
+    }
+    mNextLive.insert(mNextLive.end(), mLive.begin() + live, mLive.end());
+    mLive.swap(mNextLive);
+}
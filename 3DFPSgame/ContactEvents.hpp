@@ -0,0 +1,80 @@
+#pragma once
+
+#include <Jolt/Jolt.h>
+#include <Jolt/Physics/Body/BodyID.h>
+#include <Jolt/Physics/Collision/Shape/SubShapeID.h>
+
+#include "ThreadSlots.hpp"
+
+#include <mutex>
+#include <vector>
+
+enum class ContactEventType : uint8_t
+{
+    Added,
+    Removed,
+    Activated,
+    Deactivated
+};
+
+struct ContactEvent
+{
+    ContactEventType type;
+    JPH::BodyID body1;              // the lower BodyID of the pair
+    JPH::BodyID body2;              // invalid for activation events
+    JPH::SubShapeID subShape1;
+    JPH::SubShapeID subShape2;
+    JPH::RVec3 position = JPH::RVec3::sZero();  // Added only: first contact point
+    JPH::Vec3 normal = JPH::Vec3::sZero();      // Added only: from body1 towards body2
+    float impactSpeed = 0.0f;       // Added only: closing speed along the normal
+
+    bool involves(const JPH::BodyID& body) const { return body1 == body || body2 == body; }
+};
+
+// Collects contact and activation callbacks from whichever Jolt worker thread
+// reports them. Each thread appends to its own buffer, so nothing is locked
+// during the step. merge() runs on the stepping thread after
+// PhysicsSystem::Update returns. It turns the buffers into one array sorted by
+// body pair, so gameplay code can walk it in one pass with no locks.
+//
+// Jolt reports contacts per sub-shape pair, but gameplay asks about bodies. The
+// queue counts the touching sub-shape pairs of every body pair and reports Added
+// only when the first one starts and Removed only when the last one ends. A
+// capsule sliding from one floor triangle to the next produces no events.
+class ContactEventQueue
+{
+public:
+    // Called from physics callbacks on any thread
+    void push(const ContactEvent& event);
+
+    // Replaces events() with everything pushed since the last merge
+    void merge();
+
+    const std::vector<ContactEvent>& events() const { return mEvents; }
+
+private:
+    // Cache-line aligned so workers never share a line. Buffers keep their
+    // capacity across merges, so the steady state does not allocate.
+    struct alignas(64) ThreadBuffer
+    {
+        std::vector<ContactEvent> events;
+    };
+
+    // Touching sub-shape pairs per body pair, sorted by pair and without zeros
+    struct LivePair
+    {
+        uint64_t pair;
+        uint32_t contacts;
+    };
+
+    ThreadBuffer mBuffers[cMaxThreadSlots];
+
+    // Threads without a slot share this one
+    std::mutex mOverflowMutex;
+    std::vector<ContactEvent> mOverflow;
+
+    std::vector<ContactEvent> mPushed;  // this step's raw events, sorted
+    std::vector<ContactEvent> mEvents;
+    std::vector<LivePair> mLive;
+    std::vector<LivePair> mNextLive;
+};
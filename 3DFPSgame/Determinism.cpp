@@ -0,0 +1,84 @@
+#include "Determinism.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+
+static constexpr char cInputMagic[4] = { 'F', 'P', 'S', 'I' };
+static constexpr uint32_t cInputVersion = 3;
+
+void StateHasher::addBytes(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        mHash ^= bytes[i];
+        mHash *= 1099511628211ull;
+    }
+}
+
+bool StateHashLog::open(const std::string& path) {
+    mFile.open(path, std::ios::out | std::ios::trunc);
+    if (!mFile) {
+        std::cout << "Failed to open state hash log: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void StateHashLog::record(uint64_t tick, uint64_t hash) {
+    if (!mFile.is_open())
+        return;
+
+    mFile << tick << ' ' << std::hex << std::setw(16) << std::setfill('0') << hash << std::dec << '\n';
+}
+
+bool InputRecorder::open(const std::string& path) {
+    mFile.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!mFile) {
+        std::cout << "Failed to open input recording: " << path << std::endl;
+        return false;
+    }
+    mFile.write(cInputMagic, sizeof(cInputMagic));
+    mFile.write(reinterpret_cast<const char*>(&cInputVersion), sizeof(cInputVersion));
+    return true;
+}
+
+void InputRecorder::write(const PlayerInput& input) {
+    if (!mFile.is_open())
+        return;
+
+    // Field by field so the file never contains struct padding.
+    mFile.write(reinterpret_cast<const char*>(&input.buttons), sizeof(input.buttons));
+    mFile.write(reinterpret_cast<const char*>(&input.yaw), sizeof(input.yaw));
+    mFile.write(reinterpret_cast<const char*>(&input.pitch), sizeof(input.pitch));
+    mFile.write(reinterpret_cast<const char*>(&input.weaponSlot), sizeof(input.weaponSlot));
+}
+
+bool InputReplayer::open(const std::string& path) {
+    mFile.open(path, std::ios::in | std::ios::binary);
+    if (!mFile) {
+        std::cout << "Failed to open input replay: " << path << std::endl;
+        return false;
+    }
+
+    char magic[4] = {};
+    uint32_t version = 0;
+    mFile.read(magic, sizeof(magic));
+    mFile.read(reinterpret_cast<char*>(&version), sizeof(version));
+    if (!mFile || std::memcmp(magic, cInputMagic, sizeof(magic)) != 0 || version != cInputVersion) {
+        std::cout << "Input replay has an unknown format: " << path << std::endl;
+        mFile.close();
+        return false;
+    }
+    return true;
+}
+
+bool InputReplayer::read(PlayerInput& outInput) {
+    if (!mFile.is_open())
+        return false;
+
+    mFile.read(reinterpret_cast<char*>(&outInput.buttons), sizeof(outInput.buttons));
+    mFile.read(reinterpret_cast<char*>(&outInput.yaw), sizeof(outInput.yaw));
+    mFile.read(reinterpret_cast<char*>(&outInput.pitch), sizeof(outInput.pitch));
+    mFile.read(reinterpret_cast<char*>(&outInput.weaponSlot), sizeof(outInput.weaponSlot));
+    return static_cast<bool>(mFile);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "PlayerInput.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <type_traits>
+
+// FNV-1a over the raw bits of the simulation state. Two runs that produce the
+// same digest every tick have bit-identical worlds.
+class StateHasher {
+public:
+    void addBytes(const void* data, size_t size);
+
+    template <typename T>
+    void add(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "StateHasher::add needs a trivially copyable type");
+        addBytes(&value, sizeof(T));
+    }
+
+    uint64_t digest() const { return mHash; }
+
+private:
+    uint64_t mHash = 14695981039346656037ull;
+};
+
+// Writes "<tick> <hash>" lines so two runs can be compared with a plain diff.
+class StateHashLog {
+public:
+    bool open(const std::string& path);
+    bool isOpen() const { return mFile.is_open(); }
+
+    void record(uint64_t tick, uint64_t hash);
+
+private:
+    std::ofstream mFile;
+};
+
+// Per-tick PlayerInput stream, used to drive replays as regression runs.
+class InputRecorder {
+public:
+    bool open(const std::string& path);
+    bool isOpen() const { return mFile.is_open(); }
+
+    void write(const PlayerInput& input);
+
+private:
+    std::ofstream mFile;
+};
+
+class InputReplayer {
+public:
+    bool open(const std::string& path);
+    bool isOpen() const { return mFile.is_open(); }
+
+    // Returns false once the recording is exhausted.
+    bool read(PlayerInput& outInput);
+
+private:
+    std::ifstream mFile;
+};
@@ -0,0 +1,142 @@
+#include "FileWatcher.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr double cSettleSeconds = 0.15;  // quiet time before a change is reported
+#ifndef __linux__
+constexpr double cScanInterval = 0.5;
+#endif
+
+double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+    if (mNotify >= 0)
+        close(mNotify);
+#endif
+}
+
+bool FileWatcher::watch(const std::string& directory) {
+    std::error_code error;
+    if (!std::filesystem::is_directory(directory, error))
+        return false;
+    mDirectories.push_back(directory);
+
+#ifdef __linux__
+    if (mNotify < 0) {
+        mNotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (mNotify < 0) {
+            std::cout << "inotify unavailable, hot reload is off" << std::endl;
+            return false;
+        }
+    }
+    addWatch(directory);
+    for (auto it = std::filesystem::recursive_directory_iterator(directory, error);
+        !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+        if (it->is_directory(error))
+            addWatch(it->path().generic_string());
+    }
+#else
+    scan(false, now());
+#endif
+    return true;
+}
+
+void FileWatcher::noteChange(const std::string& path, double time) {
+    mPending[path] = time;
+}
+
+void FileWatcher::poll(std::vector<std::string>& outChanged) {
+    double time = now();
+    readChanges(time);
+    for (auto it = mPending.begin(); it != mPending.end();) {
+        if (time - it->second >= cSettleSeconds) {
+            outChanged.push_back(it->first);
+            it = mPending.erase(it);
+        }
+        else
+            ++it;
+    }
+}
+
+#ifdef __linux__
+
+void FileWatcher::addWatch(const std::string& directory) {
+    // Editors either rewrite a file in place or write a temporary and rename it over
+    int watch = inotify_add_watch(mNotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (watch >= 0)
+        mWatches[watch] = directory;
+}
+
+void FileWatcher::readChanges(double time) {
+    if (mNotify < 0)
+        return;
+
+    alignas(inotify_event) char buffer[4096];
+    for (;;) {
+        ssize_t length = read(mNotify, buffer, sizeof(buffer));
+        if (length <= 0)
+            break;
+        for (ssize_t offset = 0; offset < length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            auto watch = mWatches.find(event->wd);
+            if (watch == mWatches.end() || event->len == 0)
+                continue;
+            std::string path = watch->second + "/" + event->name;
+            if (event->mask & IN_ISDIR) {
+                // New subdirectories are watched too; files already in them are picked up as they are written
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                    addWatch(path);
+                continue;
+            }
+            if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+                noteChange(path, time);
+        }
+    }
+}
+
+#else
+
+void FileWatcher::scan(bool report, double time) {
+    for (const std::string& directory : mDirectories) {
+        std::error_code error;
+        for (auto it = std::filesystem::recursive_directory_iterator(directory, error);
+            !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+            if (!it->is_regular_file(error))
+                continue;
+            long long stamp = (long long)it->last_write_time(error).time_since_epoch().count();
+            std::string path = it->path().generic_string();
+            auto known = mStamps.find(path);
+            if (known == mStamps.end() || known->second != stamp) {
+                mStamps[path] = stamp;
+                if (report)
+                    noteChange(path, time);
+            }
+        }
+    }
+}
+
+void FileWatcher::readChanges(double time) {
+    if (time >= mNextScan) {
+        scan(true, time);
+        mNextScan = time + cScanInterval;
+    }
+}
+
+#endif
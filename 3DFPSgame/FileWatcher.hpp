@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Reports files written under a set of directories, for hot reloading. Uses
+// inotify on Linux and polls modification times elsewhere. A file is reported
+// once it has been quiet for a moment, so an editor that saves in several
+// steps triggers one reload of the finished file rather than one per step.
+class FileWatcher {
+public:
+    FileWatcher() = default;
+    ~FileWatcher();
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // Watches the directory and everything below it; false if it doesn't exist
+    bool watch(const std::string& directory);
+
+    // Never blocks. Appends each settled path as directory/relative/name.
+    void poll(std::vector<std::string>& outChanged);
+
+private:
+    void readChanges(double time);
+    void noteChange(const std::string& path, double time);
+
+    std::unordered_map<std::string, double> mPending;  // path -> time of its latest change
+    std::vector<std::string> mDirectories;
+
+#ifdef __linux__
+    void addWatch(const std::string& directory);
+
+    int mNotify = -1;
+    std::unordered_map<int, std::string> mWatches;  // watch descriptor -> directory
+#else
+    void scan(bool report, double time);
+
+    std::unordered_map<std::string, long long> mStamps;  // path -> last write time
+    double mNextScan = 0.0;
+#endif
+};
@@ -1,81 +1,246 @@
 #include "Gun.hpp"
+#include "Determinism.hpp"
+#include "Hitboxes.hpp"
+#include "Metrics.hpp"
+#include "Projectiles.hpp"
 
-Gun::Gun(Physics& inPhysics, JPH::BodyID& inIgnoreBody, float inFireRate, float inReloadTime) :
-    physics(inPhysics),
-    ignoreBody(inIgnoreBody),
-	fireRate(inFireRate),
-    reloadTime(inReloadTime){
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+
+namespace {
 
+Counter& shotsFired(bool alt) {
+    static Counter& primary = Metrics::registry().counter("fps_shots_fired_total", "Shots fired by every gun", "fire=\"primary\"");
+    static Counter& secondary = Metrics::registry().counter("fps_shots_fired_total", "Shots fired by every gun", "fire=\"alt\"");
+    return alt ? secondary : primary;
 }
 
+}
 
+struct Gun::ShotTrace {
+    float distance = 0.0f;
+    JPH::BodyID worldBodyID;
+    bool hitPlayer = false;
+    HitboxHit hitbox;
+};
+
+Gun::Gun(Physics& inPhysics, JPH::BodyID& inIgnoreBody) :
+    physics(inPhysics),
+    ignoreBody(inIgnoreBody){
 
-void Gun::fire(glm::vec3 rayOrigin, glm::vec3 rayDirection, JPH::BodyID targetBody) {
+    equip(WeaponDef());
+}
 
-    glm::vec3 normDirection = glm::normalize(rayDirection);
+void Gun::equip(const WeaponDef& inWeapon) {
+    weapon = inWeapon;
+    firePipeline = selectPipeline(weapon);
+    currentAmmo = weapon.magazineSize;
+    isReloading = false;
+    reloadTimer = 0.0f;
+    timeSinceLastShot = weapon.fireInterval; // ready to fire straight away
+}
 
+template <FireMode Mode>
+Gun::FirePipeline Gun::selectPipeline(const WeaponDef& def) {
+    // Projectiles carry their own damage, so range falloff only applies to rays
+    bool falloff = Mode != FireMode::Projectile && def.hasFalloff();
+    if (def.hasSpread())
+        return falloff ? &Gun::fireAs<Mode, true, true> : &Gun::fireAs<Mode, true, false>;
+    return falloff ? &Gun::fireAs<Mode, false, true> : &Gun::fireAs<Mode, false, false>;
+}
 
+Gun::FirePipeline Gun::selectPipeline(const WeaponDef& def) {
+    switch (def.mode) {
+    case FireMode::Pellets:    return selectPipeline<FireMode::Pellets>(def);
+    case FireMode::Projectile: return selectPipeline<FireMode::Projectile>(def);
+    case FireMode::Hitscan:
+    default:                   return selectPipeline<FireMode::Hitscan>(def);
+    }
+}
+
+void Gun::traceShot(const glm::vec3& rayOrigin, const glm::vec3& direction, ShotTrace& outTrace) const {
     JPH::RRayCast rayCast(
         JPH::RVec3(rayOrigin.x, rayOrigin.y, rayOrigin.z),
-        JPH::RVec3(normDirection.x, normDirection.y, normDirection.z) * maxShootDistance
+        JPH::Vec3(direction.x, direction.y, direction.z) * weapon.range
     );
 
     JPH::IgnoreSingleBodyFilter bodyFilter(ignoreBody);
     JPH::RayCastResult rayResult;
 
     if (physics.getPhysicsSystem().GetNarrowPhaseQuery().CastRay(
-        rayCast, rayResult, broadPhaseLayerFilter, objectLayerFilter, bodyFilter
-    )) {
-        if (rayResult.mBodyID == targetBody) {
-            std::cout << "Hit the body: " << rayResult.mBodyID.GetIndexAndSequenceNumber() << "\n";
-        }
-        else {
-            std::cout << "Hit something else: " << rayResult.mBodyID.GetIndexAndSequenceNumber() << "\n";
+        rayCast, rayResult, hitscanFilter.broadPhase, hitscanFilter.object, bodyFilter)) {
+        outTrace.worldBodyID = rayResult.mBodyID;
+    }
+
+    // Players only count if they are in front of whatever world geometry the ray hit
+    outTrace.hitPlayer = physics.getHitboxes().castRay(rayCast, rayResult.mFraction, ignoreBody, outTrace.hitbox);
+    if (outTrace.hitPlayer) {
+        rayResult.mFraction = outTrace.hitbox.fraction;
+        outTrace.worldBodyID = JPH::BodyID();
+    }
+
+    outTrace.distance = rayResult.mFraction * weapon.range;
+}
+
+float Gun::nextRandom() {
+    spreadState ^= spreadState << 13;
+    spreadState ^= spreadState >> 17;
+    spreadState ^= spreadState << 5;
+    return (spreadState >> 8) * (1.0f / 16777216.0f);
+}
+
+glm::vec3 Gun::spreadDirection(const glm::vec3& aim) {
+    // Uniform over the cone's cross-section: sqrt keeps pellets from bunching in the middle
+    float angle = glm::radians(weapon.spreadDegrees) * std::sqrt(nextRandom());
+    float roll = glm::two_pi<float>() * nextRandom();
+
+    glm::vec3 helper = std::abs(aim.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 right = glm::normalize(glm::cross(aim, helper));
+    glm::vec3 up = glm::cross(right, aim);
+
+    glm::vec3 offset = right * std::cos(roll) + up * std::sin(roll);
+    return glm::normalize(aim * std::cos(angle) + offset * std::sin(angle));
+}
+
+float Gun::falloffScale(float distance) const {
+    float t = glm::clamp((distance - weapon.falloffStart) / (weapon.falloffEnd - weapon.falloffStart), 0.0f, 1.0f);
+    return glm::mix(1.0f, weapon.falloffMinScale, t);
+}
+
+template <FireMode Mode, bool Spread, bool Falloff>
+void Gun::fireAs(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, JPH::BodyID targetBody) {
+    glm::vec3 aim = glm::normalize(rayDirection);
+
+    if constexpr (Mode == FireMode::Projectile) {
+        if (!projectiles)
+            return;
+
+        ProjectileParams params = weapon.projectile;
+        params.damage = weapon.damage;
+        for (unsigned int i = 0; i < weapon.pellets; i++) {
+            glm::vec3 direction = aim;
+            if constexpr (Spread)
+                direction = spreadDirection(aim);
+            projectiles->spawn(rayOrigin, direction, params, ignoreBody);
         }
     }
     else {
-        std::cout << "Raycast hit nothing.\n";
+        constexpr bool cSingleRay = Mode == FireMode::Hitscan;
+        unsigned int rays = cSingleRay ? 1 : weapon.pellets;
+        unsigned int playerHits = 0;
+        float totalDamage = 0.0f;
+
+        for (unsigned int i = 0; i < rays; i++) {
+            glm::vec3 direction = aim;
+            if constexpr (Spread)
+                direction = spreadDirection(aim);
+
+            ShotTrace trace;
+            traceShot(rayOrigin, direction, trace);
+
+            float damage = 0.0f;
+            if (trace.hitPlayer) {
+                damage = weapon.damage * trace.hitbox.damageMultiplier;
+                if constexpr (Falloff)
+                    damage *= falloffScale(trace.distance);
+                totalDamage += damage;
+                playerHits++;
+            }
+
+            if (cSingleRay && verbose) {
+                if (trace.hitPlayer) {
+                    std::cout << "Hit player " << trace.hitbox.ownerBodyID.GetIndexAndSequenceNumber()
+                        << " in the " << HitboxSystem::zoneName(trace.hitbox.zone)
+                        << " for " << damage << " damage\n";
+                }
+                else if (!trace.worldBodyID.IsInvalid()) {
+                    if (trace.worldBodyID == targetBody) {
+                        std::cout << "Hit the body: " << trace.worldBodyID.GetIndexAndSequenceNumber() << "\n";
+                    }
+                    else {
+                        std::cout << "Hit something else: " << trace.worldBodyID.GetIndexAndSequenceNumber() << "\n";
+                    }
+                }
+                else {
+                    std::cout << "Raycast hit nothing.\n";
+                }
+            }
+
+            hitPoint = rayOrigin + direction * trace.distance;
+        }
+
+        if (!cSingleRay && verbose) {
+            std::cout << weapon.name << ": " << playerHits << "/" << rays
+                << " pellets hit players for " << totalDamage << " damage\n";
+        }
     }
-    
-    hitPoint = rayOrigin + normDirection * (rayResult.mFraction * maxShootDistance);
 }
 
 void Gun::update(glm::vec3 rayOrigin, glm::vec3 rayDirection, JPH::BodyID targetBody, double deltaTime) {
+    bool triggerPulled = wantsToFire && (weapon.automatic || triggerReleased);
+    triggerReleased = !wantsToFire;
+
     if (isReloading) {
         reloadTimer += deltaTime;
-        if (reloadTimer >= reloadTime) {
-            currentAmmo = maxAmmo;
+        if (reloadTimer >= weapon.reloadTime) {
+            currentAmmo = weapon.magazineSize;
             isReloading = false;
             reloadTimer = 0.0f;
-            std::cout << "Reload complete.\n";
+            if (verbose)
+                std::cout << "Reload complete.\n";
         }
+        wantsToFire = false;
+        wantsToAltFire = false;
         return; // can't shoot while reloading
     }
 
     timeSinceLastShot += deltaTime;
 
-    if (wantsToFire && timeSinceLastShot >= fireRate && currentAmmo > 0) {
+    if (triggerPulled && timeSinceLastShot >= weapon.fireInterval && currentAmmo > 0) {
         fire(rayOrigin, rayDirection, targetBody);
+        shotsFired(false).add();
         timeSinceLastShot = 0.0f;
         currentAmmo--;
+        if (verbose)
+            std::cout << "Current ammo: " << currentAmmo << "\n";
 
         if (currentAmmo == 0) {
             reload();
         }
     }
+    else if (wantsToAltFire && weapon.hasAltFire && projectiles && timeSinceLastShot >= weapon.fireInterval) {
+        projectiles->spawn(rayOrigin, rayDirection, weapon.altProjectile, ignoreBody);
+        shotsFired(true).add();
+        timeSinceLastShot = 0.0f;
+    }
 
     wantsToFire = false;
-    std::cout << "Current ammo: " << currentAmmo << "\n";
+    wantsToAltFire = false;
 }
 
 void Gun::requestFire() {
     wantsToFire = true;
 }
 
+void Gun::requestAltFire() {
+    wantsToAltFire = true;
+}
+
 void Gun::reload() {
-    if (!isReloading && currentAmmo < maxAmmo) {
-        std::cout << "Reloading...\n";
+    if (!isReloading && currentAmmo < weapon.magazineSize) {
+        if (verbose)
+            std::cout << "Reloading...\n";
         isReloading = true;
         reloadTimer = 0.0f;
     }
 }
+
+
+void Gun::hashState(StateHasher& hasher) const {
+    hasher.add(currentAmmo);
+    hasher.add(isReloading);
+    hasher.add(reloadTimer);
+    hasher.add(timeSinceLastShot);
+    hasher.add(triggerReleased);
+    hasher.add(spreadState);
+}
@@ -1,46 +1,76 @@
 #pragma once
 
 #include "Physics.hpp"
+#include "Weapons.hpp"
 #include <glm/glm.hpp>
 #include <chrono>
 
+class StateHasher;
+class ProjectileSystem;
+
 class Gun {
 public:
-	Gun(Physics& inPhysics, JPH::BodyID& inIgnoreBody, float inFireRate, float inReloadTime);
+	Gun(Physics& inPhysics, JPH::BodyID& inIgnoreBody);
 	~Gun() = default;
 
+	// Swaps in a weapon definition with a full magazine
+	void equip(const WeaponDef& inWeapon);
+	const WeaponDef& getWeapon() const { return weapon; }
+
 	void requestFire();
+	void requestAltFire();
 	void update(glm::vec3 rayOrigin, glm::vec3 rayDirection, JPH::BodyID targetBody, double deltaTime);
-	void fire(glm::vec3 rayOrigin, glm::vec3 rayDirection, JPH::BodyID targetBody);
+	void fire(glm::vec3 rayOrigin, glm::vec3 rayDirection, JPH::BodyID targetBody) { (this->*firePipeline)(rayOrigin, rayDirection, targetBody); }
 
 	void reload();
 
+	// Projectile weapons and alt-fire launch through this, when set
+	void setProjectileSystem(ProjectileSystem* inProjectiles) { projectiles = inProjectiles; }
+
+	// Per-shot console output; headless runs with many shooters turn it off
+	void setVerbose(bool inVerbose) { verbose = inVerbose; }
+
+	void hashState(StateHasher& hasher) const;
 
 	glm::vec3 gunCamOffset = glm::vec3(10.0f, 0.0f, 0.0f);
 	glm::vec3 hitPoint = glm::vec3(0.0f, 0.0f, 0.0f);
 private:
-	JPH::BodyID& ignoreBody;
-	Physics& physics;
+	struct ShotTrace;
+	using FirePipeline = void (Gun::*)(const glm::vec3&, const glm::vec3&, JPH::BodyID);
 
+	// One instantiation per fire mode and feature set, picked once in equip(), so a
+	// plain hitscan rifle never tests for pellets, spread or falloff per shot
+	template <FireMode Mode, bool Spread, bool Falloff>
+	void fireAs(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, JPH::BodyID targetBody);
 
+	template <FireMode Mode>
+	static FirePipeline selectPipeline(const WeaponDef& def);
+	static FirePipeline selectPipeline(const WeaponDef& def);
 
-	JPH::RayCastSettings raySettings;
+	void traceShot(const glm::vec3& rayOrigin, const glm::vec3& direction, ShotTrace& outTrace) const;
+	glm::vec3 spreadDirection(const glm::vec3& aim);
+	float falloffScale(float distance) const;
+	float nextRandom();
 
-	JPH::BroadPhaseLayerFilter broadPhaseLayerFilter;
-	JPH::ObjectLayerFilter objectLayerFilter;
+	JPH::BodyID& ignoreBody;
+	Physics& physics;
+	ProjectileSystem* projectiles = nullptr;
 
-	static constexpr float maxShootDistance = 100000.0f;
+	WeaponDef weapon;
+	FirePipeline firePipeline;
 
+	QueryFilter hitscanFilter{ QueryLayers::HITSCAN };
 
-	float reloadTime = 3.0f;// seconds
-	float fireRate = 0.2f;// seconds per shot
 	float timeSinceLastShot = 0.0f;
-	bool canShoot = true;
 	bool wantsToFire = false;
+	bool wantsToAltFire = false;
+	bool triggerReleased = true;
+	bool verbose = true;
 
+	// xorshift32, so spread patterns replay exactly
+	uint32_t spreadState = 0x9E3779B9u;
 
 	bool isReloading = false;
 	float reloadTimer = 0.0f;
-	unsigned int maxAmmo = 30;
-	unsigned int currentAmmo = maxAmmo;
+	unsigned int currentAmmo = 0;
 };
@@ -0,0 +1,200 @@
+#include "Hitboxes.hpp"
+
+#include <Jolt/Geometry/RayCapsule.h>
+#include <Jolt/Physics/Collision/Shape/StaticCompoundShape.h>
+#include <Jolt/Physics/Collision/BroadPhase/BroadPhaseQuery.h>
+#include <Jolt/Physics/Collision/TransformedShape.h>
+
+#include <cfloat>
+#include <cmath>
+
+using namespace JPH;
+
+HitboxSystem::HitboxSystem(Physics& inPhysics)
+    : mPhysics(inPhysics) {
+}
+
+ShapeRefC HitboxSystem::buildCompound(float height, float radius) const {
+    // Proportions of a standing figure over the movement capsule's full height,
+    // centred on the capsule centre like the owner body
+    float h = height + 2.0f * radius;
+    float limbRadius = 0.045f * h;
+
+    StaticCompoundShapeSettings compound;
+    compound.AddShape(Vec3(0.0f, 0.40f * h, 0.0f), Quat::sIdentity(), new SphereShape(0.07f * h));                                    // Head
+    compound.AddShape(Vec3(0.0f, 0.18f * h, 0.0f), Quat::sIdentity(), new BoxShape(Vec3(radius, 0.14f * h, 0.6f * radius)));          // Torso
+    compound.AddShape(Vec3(0.0f, -0.02f * h, 0.0f), Quat::sIdentity(), new BoxShape(Vec3(radius, 0.06f * h, 0.6f * radius)));         // Pelvis
+    compound.AddShape(Vec3(radius + limbRadius, 0.16f * h, 0.0f), Quat::sIdentity(), new CapsuleShape(0.12f * h, limbRadius));         // LeftArm
+    compound.AddShape(Vec3(-(radius + limbRadius), 0.16f * h, 0.0f), Quat::sIdentity(), new CapsuleShape(0.12f * h, limbRadius));      // RightArm
+    compound.AddShape(Vec3(0.5f * radius, -0.29f * h, 0.0f), Quat::sIdentity(), new CapsuleShape(0.16f * h, 1.3f * limbRadius));      // LeftLeg
+    compound.AddShape(Vec3(-0.5f * radius, -0.29f * h, 0.0f), Quat::sIdentity(), new CapsuleShape(0.16f * h, 1.3f * limbRadius));     // RightLeg
+
+    ShapeSettings::ShapeResult result = compound.Create();
+    if (result.HasError()) {
+        std::cout << "Failed to build hitbox compound: " << result.GetError().c_str() << std::endl;
+        return nullptr;
+    }
+    return result.Get();
+}
+
+BodyID HitboxSystem::registerPlayer(BodyID ownerBodyID, float height, float radius) {
+    ShapeRefC shape = buildCompound(height, radius);
+    if (shape == nullptr)
+        return BodyID();
+
+    BodyInterface& bodyInterface = mPhysics.getPhysicsSystem().GetBodyInterface();
+    BodyCreationSettings settings(
+        shape,
+        bodyInterface.GetPosition(ownerBodyID),
+        Quat::sIdentity(),
+        EMotionType::Kinematic,
+        Layers::HITBOX);
+    settings.mAllowSleeping = true;
+
+    BodyID hitboxBodyID = mPhysics.spawnBody(settings, EActivation::DontActivate);
+    if (hitboxBodyID.IsInvalid())
+        return hitboxBodyID;
+
+    // The arms stick out sideways, so the bound has to cover them too. Local bounds
+    // are relative to the centre of mass, which is where castRay centres the bound.
+    // The capsule's cylinder alone spans the whole box; the caps only add slack, so
+    // the corners at the top and bottom can never fall outside it.
+    AABox bounds = shape->GetLocalBounds();
+    Vec3 extent = Vec3::sMax(bounds.mMax.Abs(), bounds.mMin.Abs());
+    Entry entry;
+    entry.ownerBodyID = ownerBodyID;
+    entry.hitboxBodyID = hitboxBodyID;
+    entry.boundRadius = std::sqrt(extent.GetX() * extent.GetX() + extent.GetZ() * extent.GetZ());
+    entry.boundHalfHeight = extent.GetY();
+
+    mEntryByHitbox[hitboxBodyID.GetIndexAndSequenceNumber()] = mEntries.size();
+    mEntries.push_back(entry);
+    return hitboxBodyID;
+}
+
+void HitboxSystem::unregisterPlayer(BodyID ownerBodyID) {
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        if (mEntries[i].ownerBodyID != ownerBodyID)
+            continue;
+
+        mPhysics.despawnBodies({ mEntries[i].hitboxBodyID });
+        mEntryByHitbox.erase(mEntries[i].hitboxBodyID.GetIndexAndSequenceNumber());
+
+        // Swap-remove, then fix up the index of whatever moved into the hole
+        if (i != mEntries.size() - 1) {
+            mEntries[i] = mEntries.back();
+            mEntryByHitbox[mEntries[i].hitboxBodyID.GetIndexAndSequenceNumber()] = i;
+        }
+        mEntries.pop_back();
+        return;
+    }
+}
+
+void HitboxSystem::setYaw(BodyID ownerBodyID, float yawDegrees) {
+    for (Entry& entry : mEntries) {
+        if (entry.ownerBodyID == ownerBodyID) {
+            entry.yawDegrees = yawDegrees;
+            return;
+        }
+    }
+}
+
+void HitboxSystem::sync() {
+    BodyInterface& bodyInterface = mPhysics.getPhysicsSystem().GetBodyInterface();
+    for (const Entry& entry : mEntries) {
+        // The compound is laid out facing +Z; Camera's yaw points along (cos, 0, sin)
+        Quat rotation = Quat::sRotation(Vec3::sAxisY(), DegreesToRadians(90.0f - entry.yawDegrees));
+        bodyInterface.SetPositionAndRotation(entry.hitboxBodyID, bodyInterface.GetPosition(entry.ownerBodyID), rotation, EActivation::DontActivate);
+    }
+}
+
+bool HitboxSystem::castRay(const RRayCast& ray, float maxFraction, BodyID ignoreOwner, HitboxHit& outHit) const {
+    if (mEntries.empty())
+        return false;
+
+    // Stage 1: broadphase, restricted to the query tree and the hitbox layer
+    QueryFilter filter(Layers::bit(Layers::HITBOX));
+    RayCast broadRay(Vec3(ray.mOrigin), ray.mDirection * maxFraction);
+    AllHitCollisionCollector<RayCastBodyCollector> candidates;
+    mPhysics.getPhysicsSystem().GetBroadPhaseQuery().CastRay(broadRay, candidates, filter.broadPhase, filter.object);
+    if (!candidates.HadHit())
+        return false;
+
+    candidates.Sort();
+
+    const BodyLockInterface& lockInterface = mPhysics.getPhysicsSystem().GetBodyLockInterface();
+    float best = maxFraction;
+    bool hit = false;
+
+    for (const BroadPhaseCastResult& candidate : candidates.mHits) {
+        // Candidates are sorted, nothing further along can beat what we have
+        float entryFraction = candidate.mFraction * maxFraction;
+        if (entryFraction >= best)
+            break;
+
+        auto it = mEntryByHitbox.find(candidate.mBodyID.GetIndexAndSequenceNumber());
+        if (it == mEntryByHitbox.end())
+            continue;
+        const Entry& entry = mEntries[it->second];
+        if (entry.ownerBodyID == ignoreOwner)
+            continue;
+
+        BodyLockRead lock(lockInterface, candidate.mBodyID);
+        if (!lock.Succeeded())
+            continue;
+        const Body& body = lock.GetBody();
+
+        // Stage 2: bounding capsule. Rotation is about Y only, so the capsule axis
+        // stays vertical and only the origin needs moving into its frame
+        Vec3 localOrigin = Vec3(ray.mOrigin - body.GetCenterOfMassPosition());
+        if (RayCapsule(localOrigin, ray.mDirection, entry.boundHalfHeight, entry.boundRadius) >= best)
+            continue;
+
+        // Stage 3: the actual sub-shapes
+        TransformedShape shape = body.GetTransformedShape();
+        RayCastResult result;
+        result.mFraction = best;
+        if (!shape.CastRay(ray, result))
+            continue;
+
+        const StaticCompoundShape* compound = static_cast<const StaticCompoundShape*>(shape.mShape.GetPtr());
+        SubShapeID remainder;
+        uint32 index = compound->GetSubShapeIndexFromID(result.mSubShapeID2, remainder);
+
+        best = result.mFraction;
+        hit = true;
+        outHit.ownerBodyID = entry.ownerBodyID;
+        outHit.zone = index < (uint32)HitZone::Count ? (HitZone)index : HitZone::Torso;
+        outHit.damageMultiplier = damageMultiplier(outHit.zone);
+        outHit.fraction = result.mFraction;
+        outHit.subShapeID = result.mSubShapeID2;
+    }
+
+    return hit;
+}
+
+float HitboxSystem::damageMultiplier(HitZone zone) {
+    switch (zone) {
+    case HitZone::Head:     return 2.5f;
+    case HitZone::Torso:    return 1.0f;
+    case HitZone::Pelvis:   return 1.0f;
+    case HitZone::LeftArm:
+    case HitZone::RightArm: return 0.75f;
+    case HitZone::LeftLeg:
+    case HitZone::RightLeg: return 0.75f;
+    default:                return 1.0f;
+    }
+}
+
+const char* HitboxSystem::zoneName(HitZone zone) {
+    switch (zone) {
+    case HitZone::Head:     return "head";
+    case HitZone::Torso:    return "torso";
+    case HitZone::Pelvis:   return "pelvis";
+    case HitZone::LeftArm:  return "left arm";
+    case HitZone::RightArm: return "right arm";
+    case HitZone::LeftLeg:  return "left leg";
+    case HitZone::RightLeg: return "right leg";
+    default:                return "unknown";
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Physics.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+// Sub-shape order inside every hitbox compound, so the compound's sub-shape
+// index is the zone
+enum class HitZone : uint8_t {
+    Head,
+    Torso,
+    Pelvis,
+    LeftArm,
+    RightArm,
+    LeftLeg,
+    RightLeg,
+    Count
+};
+
+struct HitboxHit {
+    JPH::BodyID ownerBodyID;    // the player's movement body
+    HitZone zone = HitZone::Torso;
+    float damageMultiplier = 1.0f;
+    float fraction = 1.0f;      // along the queried ray
+    JPH::SubShapeID subShapeID;
+};
+
+// Damage shapes for players. Each player gets a kinematic compound (head, torso,
+// limbs) on the HITBOX layer. That layer collides with nothing, so the bodies
+// cost nothing in the simulation step and live only in the query broadphase tree.
+//
+// Ray tests run in stages. The broadphase finds candidate AABBs, an analytic
+// ray-vs-capsule test rejects rays that clip only an AABB corner, and only the
+// remaining candidates pay for a sub-shape narrowphase test, nearest first.
+class HitboxSystem {
+public:
+    explicit HitboxSystem(Physics& inPhysics);
+
+    JPH::BodyID registerPlayer(JPH::BodyID ownerBodyID, float height, float radius);
+    void unregisterPlayer(JPH::BodyID ownerBodyID);
+
+    // Facing in the same degrees convention as Camera::updateRotation
+    void setYaw(JPH::BodyID ownerBodyID, float yawDegrees);
+
+    // Moves every compound onto its owner; call after each physics step
+    void sync();
+
+    // Closest hitbox along the ray before maxFraction, skipping ignoreOwner's own
+    bool castRay(const JPH::RRayCast& ray, float maxFraction, JPH::BodyID ignoreOwner, HitboxHit& outHit) const;
+
+    static float damageMultiplier(HitZone zone);
+    static const char* zoneName(HitZone zone);
+
+private:
+    struct Entry {
+        JPH::BodyID ownerBodyID;
+        JPH::BodyID hitboxBodyID;
+        float yawDegrees = -90.0f;
+        float boundHalfHeight = 0.0f;  // bounding capsule around the whole compound
+        float boundRadius = 0.0f;
+    };
+
+    JPH::ShapeRefC buildCompound(float height, float radius) const;
+
+    Physics& mPhysics;
+    std::vector<Entry> mEntries;
+    std::unordered_map<JPH::uint32, size_t> mEntryByHitbox;  // hitbox BodyID -> mEntries index
+};
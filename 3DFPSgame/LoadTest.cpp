@@ -0,0 +1,592 @@
+#include "LoadTest.hpp"
+#include "Memory.hpp"
+#include "Metrics.hpp"
+#include "Physics.hpp"
+#include "PlayerController.hpp"
+#include "Projectiles.hpp"
+#include "SpatialHash.hpp"
+#include "Weapons.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+using namespace JPH;
+
+namespace {
+
+enum PacketType : uint8_t {
+    Connect = 1,   // client -> server: nonce
+    Accept = 2,    // server -> client: nonce, client id
+    Input = 3,     // client -> server: id, newest sequence, count, inputs newest first
+    Snapshot = 4,  // server -> client: tick, last applied sequence, own position, nearby actors
+};
+
+constexpr size_t cMaxPacket = 1200;        // stays under any loopback or internet MTU
+constexpr size_t cSnapshotHeader = 1 + 4 + 4 + 12 + 2;
+constexpr size_t cSnapshotActor = 2 + 6 + 2;
+constexpr size_t cMaxSnapshotActors = (cMaxPacket - cSnapshotHeader) / cSnapshotActor;
+constexpr uint32_t cInputWindow = 64;      // inputs a connection buffers, and a client remembers
+constexpr uint32_t cMaxBufferedInputs = 4; // beyond this the server skips ahead to keep latency down
+constexpr size_t cPacketOverhead = 28;     // IPv4 + UDP headers
+
+double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Little-endian field packing, bounds-checked on the reading side
+struct PacketWriter {
+    uint8_t bytes[cMaxPacket];
+    size_t size = 0;
+
+    template <typename T>
+    void put(const T& value) {
+        std::memcpy(bytes + size, &value, sizeof(T));
+        size += sizeof(T);
+    }
+};
+
+struct PacketReader {
+    const uint8_t* bytes;
+    size_t size;
+    size_t cursor = 0;
+
+    template <typename T>
+    bool get(T& outValue) {
+        if (cursor + sizeof(T) > size)
+            return false;
+        std::memcpy(&outValue, bytes + cursor, sizeof(T));
+        cursor += sizeof(T);
+        return true;
+    }
+};
+
+void putInput(PacketWriter& writer, const PlayerInput& input) {
+    writer.put(input.buttons);
+    writer.put(input.yaw);
+    writer.put(input.pitch);
+    writer.put(input.weaponSlot);
+}
+
+bool getInput(PacketReader& reader, PlayerInput& outInput) {
+    return reader.get(outInput.buttons) && reader.get(outInput.yaw) && reader.get(outInput.pitch)
+        && reader.get(outInput.weaponSlot);
+}
+
+// The authoritative side: one PlayerController per connection, stepped at the fixed rate
+class LoadTestServer {
+public:
+    LoadTestServer(Physics& inPhysics, ProjectileSystem* inProjectiles, const WeaponTable* inWeapons,
+        const LoadTestSettings& inSettings)
+        : mPhysics(inPhysics), mProjectiles(inProjectiles), mWeapons(inWeapons), mSettings(inSettings) {
+    }
+
+    bool open() { return mSocket.open(mSettings.port); }
+
+    void tick(double time, LoadTestReport& report);
+
+    size_t connectionCount() const { return mConnections.size(); }
+    uint64_t bytesIn() const { return mBytesIn; }
+    uint64_t bytesOut() const { return mBytesOut; }
+    uint64_t packetsDropped() const;
+    uint64_t packetsReordered() const;
+
+private:
+    struct Connection {
+        NetAddress address;
+        uint32_t nonce = 0;
+        std::unique_ptr<PlayerController> controller;
+        LinkConditioner link;
+
+        PlayerInput inputs[cInputWindow];
+        uint32_t inputSequences[cInputWindow] = {};
+        uint32_t newestReceived = 0;
+        uint32_t lastApplied = 0;
+        PlayerInput current;
+    };
+
+    void receive(double time);
+    void accept(const NetAddress& from, uint32_t nonce, double time);
+    void applyNextInput(Connection& connection, LoadTestReport& report);
+    void sendSnapshot(size_t index, double time);
+    void send(Connection& connection, const PacketWriter& writer, double time);
+
+    Physics& mPhysics;
+    ProjectileSystem* mProjectiles;
+    const WeaponTable* mWeapons;
+    LoadTestSettings mSettings;
+    UdpSocket mSocket;
+
+    std::vector<std::unique_ptr<Connection>> mConnections;
+    uint32_t mTick = 0;
+    uint64_t mBytesIn = 0, mBytesOut = 0;
+    bool mReportedFull = false;
+
+    SpatialHash mRelevance{ 8.0f };
+    std::vector<glm::vec3> mPositions;
+    std::vector<uint32_t> mNearby;
+};
+
+void LoadTestServer::tick(double time, LoadTestReport& report) {
+    receive(time);
+
+    for (auto& connection : mConnections) {
+        applyNextInput(*connection, report);
+        connection->controller->update(connection->current, Physics::cFixedTimeStep);
+    }
+    mPhysics.update(Physics::cFixedTimeStep);
+    if (mProjectiles)
+        mProjectiles->update(Physics::cFixedTimeStep);
+
+    // Snapshots carry where the step left everyone, not where update() read them before it
+    BodyInterface& bodies = mPhysics.getPhysicsSystem().GetBodyInterface();
+    mPositions.resize(mConnections.size());
+    for (size_t i = 0; i < mConnections.size(); i++) {
+        RVec3 position = bodies.GetPosition(mConnections[i]->controller->getBodyID());
+        mPositions[i] = glm::vec3(position.GetX(), position.GetY(), position.GetZ());
+    }
+    mRelevance.build(mPositions);
+
+    for (size_t i = 0; i < mConnections.size(); i++)
+        sendSnapshot(i, time);
+    for (auto& connection : mConnections)
+        connection->link.flush(time);
+    mTick++;
+}
+
+void LoadTestServer::receive(double time) {
+    uint8_t buffer[cMaxPacket];
+    NetAddress from;
+    int size;
+    while ((size = mSocket.receive(from, buffer, sizeof(buffer))) > 0) {
+        mBytesIn += size + cPacketOverhead;
+        PacketReader reader{ buffer, (size_t)size };
+        uint8_t type = 0;
+        reader.get(type);
+
+        if (type == Connect) {
+            uint32_t nonce;
+            if (reader.get(nonce))
+                accept(from, nonce, time);
+        }
+        else if (type == Input) {
+            uint16_t id;
+            uint32_t newest;
+            uint8_t count;
+            if (!reader.get(id) || !reader.get(newest) || !reader.get(count) || id >= mConnections.size())
+                continue;
+            Connection& connection = *mConnections[id];
+            if (!(connection.address == from))
+                continue;
+
+            for (uint32_t i = 0; i < count && i < newest; i++) {
+                PlayerInput input;
+                uint32_t sequence = newest - i;
+                if (!getInput(reader, input))
+                    break;
+                if (sequence <= connection.lastApplied)
+                    break;
+                connection.inputs[sequence % cInputWindow] = input;
+                connection.inputSequences[sequence % cInputWindow] = sequence;
+            }
+            connection.newestReceived = std::max(connection.newestReceived, newest);
+        }
+    }
+}
+
+void LoadTestServer::accept(const NetAddress& from, uint32_t nonce, double time) {
+    // Accepts get lost too, so a repeated connect just gets its answer again
+    Connection* connection = nullptr;
+    uint16_t id = 0;
+    for (size_t i = 0; i < mConnections.size(); i++) {
+        if (mConnections[i]->address == from) {
+            connection = mConnections[i].get();
+            id = (uint16_t)i;
+        }
+    }
+
+    if (!connection) {
+        // Physics is sized for every client up front (PhysicsCapacity::withPlayers);
+        // this only catches a capacity that was set up for fewer
+        PhysicsSystem& system = mPhysics.getPhysicsSystem();
+        if (mConnections.size() >= mSettings.clients || system.GetNumBodies() + 8 > system.GetMaxBodies()) {
+            if (!mReportedFull)
+                std::cout << "Server full at " << mConnections.size() << " clients" << std::endl;
+            mReportedFull = true;
+            return;
+        }
+
+        id = (uint16_t)mConnections.size();
+        int side = (int)std::ceil(std::sqrt((float)mSettings.clients));
+        glm::vec3 start((id % side - side / 2) * 3.0f, 1.5f, (id / side - side / 2) * 3.0f);
+
+        auto created = std::make_unique<Connection>();
+        created->address = from;
+        created->nonce = nonce;
+        created->link = LinkConditioner(mSettings.link, 0x5EED0000u + id);
+        created->controller = std::make_unique<PlayerController>(start, mPhysics);
+        created->controller->setProjectileSystem(mProjectiles);
+        created->controller->setVerbose(false);  // hundreds of clients firing would drown the report
+        if (mWeapons)
+            created->controller->setWeaponTable(mWeapons);
+        connection = created.get();
+        mConnections.push_back(std::move(created));
+    }
+
+    PacketWriter writer;
+    writer.put((uint8_t)Accept);
+    writer.put(nonce);
+    writer.put(id);
+    send(*connection, writer, time);
+}
+
+void LoadTestServer::applyNextInput(Connection& connection, LoadTestReport& report) {
+    // A client that got ahead, e.g. after a stall, is skipped forward rather than left lagging
+    if (connection.newestReceived > connection.lastApplied + cMaxBufferedInputs)
+        connection.lastApplied = connection.newestReceived - cMaxBufferedInputs;
+
+    // The oldest input we haven't applied; gaps are inputs lost beyond the redundancy
+    for (uint32_t sequence = connection.lastApplied + 1; sequence <= connection.newestReceived; sequence++) {
+        if (connection.inputSequences[sequence % cInputWindow] == sequence) {
+            connection.current = connection.inputs[sequence % cInputWindow];
+            connection.lastApplied = sequence;
+            return;
+        }
+    }
+
+    // Nothing new: keep doing what the client last asked for
+    report.inputStarvedTicks++;
+}
+
+void LoadTestServer::sendSnapshot(size_t index, double time) {
+    Connection& connection = *mConnections[index];
+    const glm::vec3& own = mPositions[index];
+
+    PacketWriter writer;
+    writer.put((uint8_t)Snapshot);
+    writer.put(mTick);
+    writer.put(connection.lastApplied);
+    writer.put(own.x);
+    writer.put(own.y);
+    writer.put(own.z);
+
+    // Nearest first, so the cap drops the actors that matter least
+    mNearby.clear();
+    mRelevance.queryNearest(own, cMaxSnapshotActors + 1, mSettings.relevanceRadius, mNearby);
+    uint16_t count = 0;
+    size_t countOffset = writer.size;
+    writer.put(count);
+    for (uint32_t id : mNearby) {
+        if (id == index || count == cMaxSnapshotActors)
+            continue;
+        glm::vec3 offset = (mPositions[id] - own) * 100.0f;  // centimeters relative to the receiver
+        float yaw = std::fmod(mConnections[id]->current.yaw + 360.0f, 360.0f);
+        writer.put((uint16_t)id);
+        writer.put((int16_t)std::clamp(offset.x, -32767.0f, 32767.0f));
+        writer.put((int16_t)std::clamp(offset.y, -32767.0f, 32767.0f));
+        writer.put((int16_t)std::clamp(offset.z, -32767.0f, 32767.0f));
+        writer.put((uint16_t)(yaw * 65535.0f / 360.0f));
+        count++;
+    }
+    std::memcpy(writer.bytes + countOffset, &count, sizeof(count));
+    send(connection, writer, time);
+}
+
+void LoadTestServer::send(Connection& connection, const PacketWriter& writer, double time) {
+    mBytesOut += writer.size + cPacketOverhead;
+    connection.link.send(mSocket, connection.address, writer.bytes, writer.size, time);
+}
+
+uint64_t LoadTestServer::packetsDropped() const {
+    uint64_t total = 0;
+    for (const auto& connection : mConnections)
+        total += connection->link.dropped();
+    return total;
+}
+
+uint64_t LoadTestServer::packetsReordered() const {
+    uint64_t total = 0;
+    for (const auto& connection : mConnections)
+        total += connection->link.reordered();
+    return total;
+}
+
+// Every simulated client, driven together from one thread
+class LoadTestClients {
+public:
+    explicit LoadTestClients(const LoadTestSettings& inSettings) : mSettings(inSettings) {}
+
+    bool open();
+    void run(const std::atomic<bool>& stop);
+
+    uint64_t bytesOut = 0;
+    uint64_t snapshots = 0;
+    uint64_t corrections = 0;
+    uint64_t packetsDropped = 0;
+    uint64_t packetsReordered = 0;
+
+private:
+    struct Client {
+        UdpSocket socket;
+        LinkConditioner link;
+        uint32_t nonce = 0;
+        int32_t id = -1;
+        double nextConnect = 0.0;
+
+        uint32_t sequence = 0;
+        PlayerInput history[cInputWindow];
+        glm::vec3 predicted[cInputWindow];
+        glm::vec3 position = glm::vec3(0.0f);
+        bool hasBase = false;
+
+        float yaw = 0.0f;
+        bool running = false;
+        int wanderTicks = 0;
+    };
+
+    void tick(Client& client, double time);
+    void receive(Client& client);
+    void reconcile(Client& client, uint32_t ack, const glm::vec3& serverPosition);
+    void send(Client& client, const PacketWriter& writer, double time);
+    float nextUnit();
+
+    LoadTestSettings mSettings;
+    std::vector<Client> mClients;
+    NetAddress mServer;
+    uint32_t mRandomState = 0xC0FFEEu;
+};
+
+float LoadTestClients::nextUnit() {
+    mRandomState ^= mRandomState << 13;
+    mRandomState ^= mRandomState >> 17;
+    mRandomState ^= mRandomState << 5;
+    return (mRandomState >> 8) * (1.0f / 16777216.0f);
+}
+
+bool LoadTestClients::open() {
+    mServer = NetAddress::loopback(mSettings.port);
+    mClients.resize(mSettings.clients);
+    for (size_t i = 0; i < mClients.size(); i++) {
+        Client& client = mClients[i];
+        if (!client.socket.open()) {
+            std::cout << "Could only open " << i << " client sockets, check the open file limit" << std::endl;
+            mClients.resize(i);
+            break;
+        }
+        client.link = LinkConditioner(mSettings.link, 0xC1E70000u + (uint32_t)i);
+        client.nonce = 0x10000u + (uint32_t)i;
+        client.nextConnect = i * 0.002;  // don't hit the server with every connect in the same tick
+    }
+    return !mClients.empty();
+}
+
+void LoadTestClients::run(const std::atomic<bool>& stop) {
+    double nextTick = now();
+    while (!stop.load(std::memory_order_relaxed)) {
+        double time = now();
+        if (time < nextTick) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(nextTick - time));
+            continue;
+        }
+        for (Client& client : mClients)
+            tick(client, time);
+        nextTick = std::max(nextTick + Physics::cFixedTimeStep, time - 5.0 * Physics::cFixedTimeStep);
+    }
+
+    for (Client& client : mClients) {
+        packetsDropped += client.link.dropped();
+        packetsReordered += client.link.reordered();
+    }
+}
+
+void LoadTestClients::tick(Client& client, double time) {
+    receive(client);
+
+    if (client.id < 0) {
+        if (time >= client.nextConnect) {
+            PacketWriter writer;
+            writer.put((uint8_t)Connect);
+            writer.put(client.nonce);
+            send(client, writer, time);
+            client.nextConnect = time + 0.25;
+        }
+        client.link.flush(time);
+        return;
+    }
+
+    // Wander: run or walk in a straight line for a while, then turn, firing now and then
+    if (--client.wanderTicks <= 0) {
+        client.yaw = nextUnit() * 360.0f - 180.0f;
+        client.running = nextUnit() < 0.5f;
+        client.wanderTicks = 60 + (int)(nextUnit() * 120.0f);
+    }
+    PlayerInput input;
+    input.yaw = client.yaw;
+    input.press(PlayerInput::Forward);
+    if (client.running)
+        input.press(PlayerInput::Run);
+    if (nextUnit() < 0.05f)
+        input.press(PlayerInput::Fire);
+
+    // Same horizontal movement PlayerController applies, so any difference is the network's doing
+    float speed = client.running ? 5.0f : 2.5f;
+    float yaw = glm::radians(client.yaw);
+    client.position += glm::vec3(std::cos(yaw), 0.0f, std::sin(yaw)) * speed * Physics::cFixedTimeStep;
+
+    client.sequence++;
+    client.history[client.sequence % cInputWindow] = input;
+    client.predicted[client.sequence % cInputWindow] = client.position;
+
+    PacketWriter writer;
+    uint8_t count = (uint8_t)std::min(mSettings.inputRedundancy, client.sequence);
+    writer.put((uint8_t)Input);
+    writer.put((uint16_t)client.id);
+    writer.put(client.sequence);
+    writer.put(count);
+    for (uint32_t i = 0; i < count; i++)
+        putInput(writer, client.history[(client.sequence - i) % cInputWindow]);
+    send(client, writer, time);
+    client.link.flush(time);
+}
+
+void LoadTestClients::receive(Client& client) {
+    uint8_t buffer[cMaxPacket];
+    NetAddress from;
+    int size;
+    while ((size = client.socket.receive(from, buffer, sizeof(buffer))) > 0) {
+        PacketReader reader{ buffer, (size_t)size };
+        uint8_t type = 0;
+        reader.get(type);
+
+        if (type == Accept) {
+            uint32_t nonce;
+            uint16_t id;
+            if (reader.get(nonce) && reader.get(id) && nonce == client.nonce)
+                client.id = id;
+        }
+        else if (type == Snapshot) {
+            uint32_t tick, ack;
+            glm::vec3 position;
+            if (!reader.get(tick) || !reader.get(ack) || !reader.get(position.x) || !reader.get(position.y)
+                || !reader.get(position.z))
+                continue;
+            snapshots++;
+            reconcile(client, ack, position);
+        }
+    }
+}
+
+void LoadTestClients::reconcile(Client& client, uint32_t ack, const glm::vec3& serverPosition) {
+    client.position.y = serverPosition.y;
+    if (ack == 0 || client.sequence - ack >= cInputWindow) {
+        if (!client.hasBase)
+            client.position = serverPosition;
+        client.hasBase = true;
+        return;
+    }
+
+    // Compare against what we predicted for the same input and replay the rest on top of the server's answer
+    glm::vec3 error = serverPosition - client.predicted[ack % cInputWindow];
+    error.y = 0.0f;
+    if (client.hasBase && glm::length(error) <= mSettings.correctionThreshold)
+        return;
+    if (client.hasBase)
+        corrections++;
+    client.hasBase = true;
+
+    for (uint32_t sequence = ack; sequence <= client.sequence; sequence++)
+        client.predicted[sequence % cInputWindow] += error;
+    client.position += error;
+}
+
+void LoadTestClients::send(Client& client, const PacketWriter& writer, double time) {
+    bytesOut += writer.size + cPacketOverhead;
+    client.link.send(client.socket, mServer, writer.bytes, writer.size, time);
+}
+
+}
+
+void LoadTestReport::print() const {
+    std::cout << "Load test: " << clientsConnected << " of " << clientsRequested << " clients connected, "
+        << ticks << " server ticks" << std::endl;
+    std::cout << "  Server tick: mean " << tickMeanMs << " ms, p99 " << tickP99Ms << " ms, max " << tickMaxMs
+        << " ms, " << tickOverruns << " over budget" << std::endl;
+    std::cout << "  Bandwidth per client: " << upKbitPerClient << " kbit/s up, " << downKbitPerClient
+        << " kbit/s down" << std::endl;
+    double correctionRate = snapshotsReceived ? 100.0 * corrections / snapshotsReceived : 0.0;
+    std::cout << "  Corrections: " << corrections << " in " << snapshotsReceived << " snapshots ("
+        << correctionRate << "%), " << inputStarvedTicks << " input-starved ticks" << std::endl;
+    std::cout << "  Link: " << packetsDropped << " packets dropped, " << packetsReordered << " reordered" << std::endl;
+}
+
+LoadTestReport runLoadTest(Physics& physics, ProjectileSystem* projectiles, const WeaponTable* weapons,
+    const LoadTestSettings& settings) {
+    LoadTestReport report;
+    report.clientsRequested = settings.clients;
+
+    LoadTestServer server(physics, projectiles, weapons, settings);
+    LoadTestClients clients(settings);
+    if (!server.open() || !clients.open())
+        return report;
+
+    std::atomic<bool> stop{ false };
+    std::thread clientThread([&clients, &stop]() { clients.run(stop); });
+
+    std::vector<float> tickTimes;
+    tickTimes.reserve((size_t)(settings.durationSeconds / Physics::cFixedTimeStep) + 1);
+    double start = now();
+    double end = start + settings.durationSeconds;
+    double nextTick = start;
+    for (double time = start; time < end; time = now()) {
+        if (time < nextTick) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(nextTick - time));
+            continue;
+        }
+
+        // Each tick is a frame as far as the arena and allocation counters go
+        Memory::beginFrame();
+        server.tick(time, report);
+        double tickSeconds = now() - time;
+        Metrics::recordTick(tickSeconds, Physics::cFixedTimeStep);
+        float tickMs = (float)(tickSeconds * 1000.0);
+        tickTimes.push_back(tickMs);
+        if (tickMs > Physics::cFixedTimeStep * 1000.0f)
+            report.tickOverruns++;
+
+        // Fall behind by more than a few ticks and the lost time is dropped, like runFixedTicks does
+        nextTick = std::max(nextTick + Physics::cFixedTimeStep, time - 5.0 * Physics::cFixedTimeStep);
+    }
+
+    stop = true;
+    clientThread.join();
+    double elapsed = now() - start;
+
+    report.clientsConnected = server.connectionCount();
+    report.ticks = tickTimes.size();
+    if (!tickTimes.empty()) {
+        double sum = 0.0;
+        for (float ms : tickTimes)
+            sum += ms;
+        report.tickMeanMs = sum / tickTimes.size();
+        report.tickMaxMs = *std::max_element(tickTimes.begin(), tickTimes.end());
+        auto p99 = tickTimes.begin() + (tickTimes.size() * 99) / 100;
+        std::nth_element(tickTimes.begin(), p99, tickTimes.end());
+        report.tickP99Ms = *p99;
+    }
+
+    if (report.clientsConnected > 0 && elapsed > 0.0) {
+        double perClientSeconds = report.clientsConnected * elapsed;
+        report.upKbitPerClient = clients.bytesOut * 8.0 / 1000.0 / perClientSeconds;
+        report.downKbitPerClient = server.bytesOut() * 8.0 / 1000.0 / perClientSeconds;
+    }
+    report.snapshotsReceived = clients.snapshots;
+    report.corrections = clients.corrections;
+    report.packetsDropped = server.packetsDropped() + clients.packetsDropped;
+    report.packetsReordered = server.packetsReordered() + clients.packetsReordered;
+    return report;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "NetSocket.hpp"
+
+#include <cstdint>
+
+class Physics;
+class ProjectileSystem;
+class WeaponTable;
+
+struct LoadTestSettings {
+    size_t clients = 200;
+    float durationSeconds = 30.0f;
+    uint16_t port = 27015;
+    LinkSettings link;                  // applied both ways on every client's link
+
+    float relevanceRadius = 60.0f;      // actors further than this from a client are left out of its snapshots
+    float correctionThreshold = 0.25f;  // meters of prediction error that force the client to snap
+    uint32_t inputRedundancy = 3;       // inputs per packet, newest first, so one lost packet costs nothing
+};
+
+struct LoadTestReport {
+    size_t clientsRequested = 0;
+    size_t clientsConnected = 0;
+    uint64_t ticks = 0;
+
+    double tickMeanMs = 0.0;
+    double tickP99Ms = 0.0;
+    double tickMaxMs = 0.0;
+    uint64_t tickOverruns = 0;  // ticks that took longer than the tick itself
+
+    // Per connected client, UDP payload plus 28 bytes of IPv4/UDP header per packet
+    double upKbitPerClient = 0.0;
+    double downKbitPerClient = 0.0;
+
+    uint64_t snapshotsReceived = 0;
+    uint64_t corrections = 0;
+    uint64_t inputStarvedTicks = 0;  // server ticks where a client's next input hadn't arrived
+    uint64_t packetsDropped = 0;
+    uint64_t packetsReordered = 0;
+
+    void print() const;
+};
+
+// Headless load test in one process. A server instance runs the real
+// simulation at the fixed tick rate, with one PlayerController per connection,
+// and answers every client with a snapshot of the actors around it. On a
+// second thread, the simulated clients each own a UDP socket on loopback.
+// They wander and shoot, predict their own movement, and reconcile it against
+// the server. Both directions of every link go through a LinkConditioner.
+//
+// The physics world must be empty apart from static geometry; the test adds and
+// leaves the players in it and is meant to be the only thing the process does.
+LoadTestReport runLoadTest(Physics& physics, ProjectileSystem* projectiles, const WeaponTable* weapons,
+    const LoadTestSettings& settings);
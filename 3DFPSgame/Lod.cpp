@@ -0,0 +1,141 @@
+#include "Lod.hpp"
+#include "Model.hpp"
+#include "Renderer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <unordered_map>
+
+namespace {
+
+struct Triangle {
+    std::array<unsigned int, 3> v;
+    bool operator<(const Triangle& other) const { return v < other.v; }
+    bool operator==(const Triangle& other) const { return v == other.v; }
+};
+
+struct Clustering {
+    std::vector<unsigned int> clusterOf;  // per input vertex
+    size_t clusterCount = 0;
+    std::vector<Triangle> triangles;
+};
+
+// Assigns every vertex to a grid cell and collapses the triangles onto the cells
+void cluster(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+    const glm::vec3& origin, float cellSize, Clustering& out) {
+    std::unordered_map<uint64_t, unsigned int> cells;
+    cells.reserve(vertices.size());
+    out.clusterOf.resize(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        glm::uvec3 cell = glm::uvec3((vertices[i].position - origin) / cellSize);
+        uint64_t key = (uint64_t)(cell.x & 0x1FFFFF) | (uint64_t)(cell.y & 0x1FFFFF) << 21 | (uint64_t)(cell.z & 0x1FFFFF) << 42;
+        auto [it, inserted] = cells.emplace(key, (unsigned int)cells.size());
+        out.clusterOf[i] = it->second;
+    }
+    out.clusterCount = cells.size();
+
+    out.triangles.clear();
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        unsigned int a = out.clusterOf[indices[i]];
+        unsigned int b = out.clusterOf[indices[i + 1]];
+        unsigned int c = out.clusterOf[indices[i + 2]];
+        if (a == b || b == c || a == c)
+            continue;
+
+        // Rotate the smallest index to the front so duplicates compare equal
+        // without flipping the winding
+        if (b < a && b < c)
+            out.triangles.push_back({ { b, c, a } });
+        else if (c < a && c < b)
+            out.triangles.push_back({ { c, a, b } });
+        else
+            out.triangles.push_back({ { a, b, c } });
+    }
+    std::sort(out.triangles.begin(), out.triangles.end());
+    out.triangles.erase(std::unique(out.triangles.begin(), out.triangles.end()), out.triangles.end());
+}
+
+}
+
+bool simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, size_t targetTriangles,
+    std::vector<Vertex>& outVertices, std::vector<unsigned int>& outIndices) {
+    size_t sourceTriangles = indices.size() / 3;
+    if (vertices.empty() || targetTriangles == 0 || targetTriangles >= sourceTriangles)
+        return false;
+
+    glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+    for (const Vertex& vertex : vertices) {
+        boundsMin = glm::min(boundsMin, vertex.position);
+        boundsMax = glm::max(boundsMax, vertex.position);
+    }
+    float extent = std::max(std::max(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y), boundsMax.z - boundsMin.z);
+    if (extent <= 0.0f)
+        return false;
+
+    // Triangle count falls roughly monotonically as cells grow, so binary search
+    // the cell count along the longest axis. A surface at n cells per axis keeps
+    // on the order of n^2 triangles, which bounds the search.
+    Clustering best, attempt;
+    int low = 1, high = std::max(2, (int)(4.0f * std::sqrt((float)sourceTriangles)));
+    bool found = false;
+    while (low <= high) {
+        int resolution = low + (high - low) / 2;
+        cluster(vertices, indices, boundsMin, extent / (float)resolution * 1.0001f, attempt);
+        if (attempt.triangles.size() <= targetTriangles) {
+            std::swap(best, attempt);
+            found = true;
+            low = resolution + 1;
+        }
+        else {
+            high = resolution - 1;
+        }
+    }
+
+    // Anything above 80% of the source isn't worth a level of its own
+    if (!found || best.triangles.empty() || best.triangles.size() * 5 > sourceTriangles * 4)
+        return false;
+
+    // Each cluster becomes the average of its vertices
+    std::vector<unsigned int> counts(best.clusterCount, 0);
+    outVertices.assign(best.clusterCount, Vertex{ glm::vec3(0.0f), glm::vec3(0.0f), glm::vec2(0.0f) });
+    for (size_t i = 0; i < vertices.size(); i++) {
+        Vertex& merged = outVertices[best.clusterOf[i]];
+        merged.position += vertices[i].position;
+        merged.normal += vertices[i].normal;
+        merged.texCoords += vertices[i].texCoords;
+        counts[best.clusterOf[i]]++;
+    }
+    for (size_t i = 0; i < outVertices.size(); i++) {
+        float scale = 1.0f / (float)counts[i];
+        outVertices[i].position *= scale;
+        outVertices[i].texCoords *= scale;
+        float length = glm::length(outVertices[i].normal);
+        outVertices[i].normal = length > 0.0f ? outVertices[i].normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    outIndices.clear();
+    outIndices.reserve(best.triangles.size() * 3);
+    for (const Triangle& triangle : best.triangles)
+        outIndices.insert(outIndices.end(), triangle.v.begin(), triangle.v.end());
+    return true;
+}
+
+float screenSize(const Bounds& bounds, const glm::vec3& cameraPosition, float projectionScale) {
+    glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+    float radius = glm::length(bounds.max - bounds.min) * 0.5f;
+    float distance = glm::length(center - cameraPosition);
+    if (distance <= radius)
+        return FLT_MAX;  // camera inside the sphere
+    return radius * projectionScale / distance;
+}
+
+int selectLod(int currentLod, float size, int lodCount, const LodSettings& settings) {
+    int lod = std::clamp(currentLod, 0, lodCount - 1);
+    while (lod + 1 < lodCount && size < settings.screenSizes[lod] * (1.0f - settings.hysteresis))
+        lod++;
+    while (lod > 0 && size > settings.screenSizes[lod - 1] * (1.0f + settings.hysteresis))
+        lod--;
+    return lod;
+}
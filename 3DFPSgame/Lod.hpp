@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Vertex;
+struct Bounds;
+
+// Simplified levels generated per mesh at import, on top of the full-detail mesh
+constexpr int cMaxLods = 4;
+
+struct LodSettings {
+    // Triangle budget of each generated level as a fraction of the full mesh
+    float triangleRatios[cMaxLods - 1] = { 0.5f, 0.25f, 0.1f };
+
+    // Meshes this small are drawn at full detail at any distance
+    size_t minTriangles = 256;
+
+    // Screen size (bounding sphere radius over half the viewport height) below
+    // which level i + 1 takes over from level i
+    float screenSizes[cMaxLods - 1] = { 0.25f, 0.1f, 0.04f };
+
+    // A level only changes once the screen size is this far past a threshold, so
+    // an instance sitting on a boundary doesn't pop back and forth
+    float hysteresis = 0.15f;
+};
+
+// Vertex clustering: snaps vertices to a grid and merges each cell into one
+// averaged vertex, dropping triangles that collapse. The grid resolution is
+// searched for the finest one that fits targetTriangles. Much cheaper than edge
+// collapse and good enough for geometry that covers a handful of pixels. Returns
+// false if the mesh could not be brought meaningfully under its current size.
+bool simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, size_t targetTriangles,
+    std::vector<Vertex>& outVertices, std::vector<unsigned int>& outIndices);
+
+// Bounding sphere radius over half the viewport height; projectionScale is
+// projection[1][1]
+float screenSize(const Bounds& bounds, const glm::vec3& cameraPosition, float projectionScale);
+
+int selectLod(int currentLod, float size, int lodCount, const LodSettings& settings);
@@ -0,0 +1,459 @@
+#include "Memory.hpp"
+#include "Metrics.hpp"
+#include "ThreadSlots.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+static void* alignedAlloc(size_t size, size_t alignment)
+{
+#ifdef _MSC_VER
+    return _aligned_malloc(size, alignment);
+#else
+    void* block = nullptr;
+    if (posix_memalign(&block, std::max(alignment, sizeof(void*)), size) != 0)
+        return nullptr;
+    return block;
+#endif
+}
+
+static void alignedFree(void* block)
+{
+#ifdef _MSC_VER
+    _aligned_free(block);
+#else
+    std::free(block);
+#endif
+}
+
+// -----------------
+// Counters
+// -----------------
+
+namespace
+{
+    constexpr size_t cTagCount = static_cast<size_t>(MemTag::Count);
+
+    // One shard per thread slot, each on its own cache line, so counting an
+    // allocation is an uncontended relaxed add
+    struct alignas(64) CounterShard
+    {
+        std::atomic<uint64_t> allocations[cTagCount];
+        std::atomic<uint64_t> frees[cTagCount];
+        std::atomic<uint64_t> bytes[cTagCount];
+    };
+
+    CounterShard sShards[cMaxThreadSlots];
+
+    AllocationStats sPreviousTotals[cTagCount];
+    AllocationStats sLastFrame[cTagCount];
+
+    thread_local MemTag tCurrentTag = MemTag::Other;
+
+    CounterShard& currentShard()
+    {
+        uint32_t slot = currentThreadSlot();
+        return sShards[slot == cNoThreadSlot ? 0 : slot];
+    }
+}
+
+MemTagScope::MemTagScope(MemTag inTag)
+    : mPrevious(tCurrentTag)
+{
+    tCurrentTag = inTag;
+}
+
+MemTagScope::~MemTagScope()
+{
+    tCurrentTag = mPrevious;
+}
+
+MemTag Memory::currentTag()
+{
+    return tCurrentTag;
+}
+
+void Memory::recordAllocation(MemTag tag, size_t bytes)
+{
+    CounterShard& shard = currentShard();
+    shard.allocations[static_cast<size_t>(tag)].fetch_add(1, std::memory_order_relaxed);
+    shard.bytes[static_cast<size_t>(tag)].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void Memory::recordFree(MemTag tag)
+{
+    currentShard().frees[static_cast<size_t>(tag)].fetch_add(1, std::memory_order_relaxed);
+}
+
+// Running totals for the metrics endpoint, fed from the frame that just ended
+static void publishMetrics()
+{
+    struct MemoryMetrics
+    {
+        Counter* allocations[cTagCount];
+        Counter* bytes[cTagCount];
+        Gauge* arenaHighWater;
+        Gauge* arenaCapacity;
+        Counter* arenaOverflowFrames;
+        Counter* arenaOverflowBytes;
+        uint64_t publishedOverflowFrames = 0;
+        uint64_t publishedOverflowBytes = 0;
+
+        MemoryMetrics()
+        {
+            MetricsRegistry& registry = Metrics::registry();
+            for (size_t tag = 0; tag < cTagCount; tag++)
+            {
+                std::string label = std::string("tag=\"") + Memory::tagName(static_cast<MemTag>(tag)) + "\"";
+                allocations[tag] = &registry.counter("fps_allocations_total", "Tracked heap allocations", label);
+                bytes[tag] = &registry.counter("fps_allocated_bytes_total", "Bytes of tracked heap allocations", label);
+            }
+            arenaHighWater = &registry.gauge("fps_frame_arena_high_water_bytes", "Most of the frame arena any frame has used");
+            arenaCapacity = &registry.gauge("fps_frame_arena_capacity_bytes", "Size of the frame arena");
+            arenaOverflowFrames = &registry.counter("fps_frame_arena_overflow_frames_total", "Frames that ran out of frame arena");
+            arenaOverflowBytes = &registry.counter("fps_frame_arena_overflow_bytes_total", "Bytes that spilled from the frame arena to the heap");
+        }
+    };
+    static MemoryMetrics sMetrics;
+
+    for (size_t tag = 0; tag < cTagCount; tag++)
+    {
+        sMetrics.allocations[tag]->add(sLastFrame[tag].allocations);
+        sMetrics.bytes[tag]->add(sLastFrame[tag].bytes);
+    }
+    const FrameArena& arena = Memory::frameArena();
+    sMetrics.arenaHighWater->set((double)arena.highWater());
+    sMetrics.arenaCapacity->set((double)arena.capacity());
+    sMetrics.arenaOverflowFrames->add(arena.overflowFrames() - sMetrics.publishedOverflowFrames);
+    sMetrics.arenaOverflowBytes->add(arena.overflowBytesTotal() - sMetrics.publishedOverflowBytes);
+    sMetrics.publishedOverflowFrames = arena.overflowFrames();
+    sMetrics.publishedOverflowBytes = arena.overflowBytesTotal();
+}
+
+void Memory::beginFrame()
+{
+    for (size_t tag = 0; tag < cTagCount; tag++)
+    {
+        AllocationStats totals;
+        for (const CounterShard& shard : sShards)
+        {
+            totals.allocations += shard.allocations[tag].load(std::memory_order_relaxed);
+            totals.frees += shard.frees[tag].load(std::memory_order_relaxed);
+            totals.bytes += shard.bytes[tag].load(std::memory_order_relaxed);
+        }
+        sLastFrame[tag].allocations = totals.allocations - sPreviousTotals[tag].allocations;
+        sLastFrame[tag].frees = totals.frees - sPreviousTotals[tag].frees;
+        sLastFrame[tag].bytes = totals.bytes - sPreviousTotals[tag].bytes;
+        sPreviousTotals[tag] = totals;
+    }
+
+    frameArena().reset();
+    publishMetrics();
+}
+
+AllocationStats Memory::frameStats(MemTag tag)
+{
+    return sLastFrame[static_cast<size_t>(tag)];
+}
+
+uint64_t Memory::frameAllocations()
+{
+    uint64_t total = 0;
+    for (const AllocationStats& stats : sLastFrame)
+        total += stats.allocations;
+    return total;
+}
+
+const char* Memory::tagName(MemTag tag)
+{
+    switch (tag)
+    {
+    case MemTag::Physics:   return "physics";
+    case MemTag::Gameplay:  return "gameplay";
+    case MemTag::Streaming: return "streaming";
+    case MemTag::Render:    return "render";
+    case MemTag::Assets:    return "assets";
+    default:                return "other";
+    }
+}
+
+// -----------------
+// Frame arena
+// -----------------
+
+FrameArena::FrameArena(size_t inCapacity)
+    : mBase(static_cast<uint8_t*>(alignedAlloc(inCapacity, 64))),
+    mCapacity(inCapacity)
+{
+}
+
+FrameArena::~FrameArena()
+{
+    reset();
+    alignedFree(mBase);
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment)
+{
+    size_t offset = mOffset.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+        size_t end = aligned + size;
+        if (end > mCapacity)
+            break;
+        if (mOffset.compare_exchange_weak(offset, end, std::memory_order_relaxed))
+            return mBase + aligned;
+    }
+
+    // Out of room: keep going on the heap and let the high-water mark tell us to grow
+    void* block = alignedAlloc(size, alignment);
+    std::lock_guard lock(mOverflowMutex);
+    mOverflowBlocks.push_back(block);
+    mOverflowBytes += size;
+    return block;
+}
+
+void FrameArena::reset()
+{
+    size_t used = mOffset.exchange(0, std::memory_order_relaxed);
+
+    std::lock_guard lock(mOverflowMutex);
+    size_t frameTotal = std::min(used, mCapacity) + mOverflowBytes;
+    if (!mOverflowBlocks.empty())
+    {
+        // An arena that is too small overflows every frame; say so only when it gets worse
+        if (frameTotal > mHighWater)
+            std::cout << "Frame arena overflowed by " << mOverflowBytes << " bytes (capacity " << mCapacity << ")" << std::endl;
+        mOverflowFrames++;
+        mOverflowBytesTotal += mOverflowBytes;
+        for (void* block : mOverflowBlocks)
+            alignedFree(block);
+        mOverflowBlocks.clear();
+    }
+    mHighWater = std::max(mHighWater, frameTotal);
+    mOverflowBytes = 0;
+}
+
+FrameArena& Memory::frameArena()
+{
+    static FrameArena sArena(16 * 1024 * 1024);
+    return sArena;
+}
+
+// -----------------
+// Size-class pools for Jolt's long-lived objects (shapes, constraints, ...)
+// -----------------
+
+namespace
+{
+    // Every block carries a header recording its class, since JPH::Free gets no size
+    struct alignas(16) BlockHeader
+    {
+        uint32_t sizeClass;
+        uint32_t pad[3];
+    };
+
+    constexpr size_t cSizeClasses[] = { 16, 32, 64, 128, 256, 512 };
+    constexpr size_t cNumSizeClasses = sizeof(cSizeClasses) / sizeof(cSizeClasses[0]);
+    constexpr uint32_t cLargeBlock = cNumSizeClasses;
+    constexpr size_t cPageSize = 64 * 1024;
+
+    struct SizeClassPool
+    {
+        std::mutex mutex;
+        void* freeList = nullptr;
+    };
+
+    SizeClassPool sPools[cNumSizeClasses];
+
+    size_t sizeClassFor(size_t size)
+    {
+        for (size_t i = 0; i < cNumSizeClasses; i++)
+            if (size <= cSizeClasses[i])
+                return i;
+        return cLargeBlock;
+    }
+
+    void* poolAllocate(size_t size)
+    {
+        size_t sizeClass = sizeClassFor(size);
+        BlockHeader* header;
+        if (sizeClass == cLargeBlock)
+        {
+            header = static_cast<BlockHeader*>(std::malloc(sizeof(BlockHeader) + size));
+            if (header == nullptr)
+                return nullptr;
+        }
+        else
+        {
+            SizeClassPool& pool = sPools[sizeClass];
+            size_t blockSize = sizeof(BlockHeader) + cSizeClasses[sizeClass];
+
+            std::lock_guard lock(pool.mutex);
+            if (pool.freeList == nullptr)
+            {
+                // Pages are never returned; these pools only hold long-lived objects
+                uint8_t* page = static_cast<uint8_t*>(std::malloc(cPageSize));
+                if (page == nullptr)
+                    return nullptr;
+                for (size_t offset = 0; offset + blockSize <= cPageSize; offset += blockSize)
+                {
+                    void* block = page + offset;
+                    *static_cast<void**>(block) = pool.freeList;
+                    pool.freeList = block;
+                }
+            }
+            header = static_cast<BlockHeader*>(pool.freeList);
+            pool.freeList = *static_cast<void**>(pool.freeList);
+        }
+
+        header->sizeClass = static_cast<uint32_t>(sizeClass);
+        return header + 1;
+    }
+
+    void poolFree(void* block)
+    {
+        BlockHeader* header = static_cast<BlockHeader*>(block) - 1;
+        if (header->sizeClass == cLargeBlock)
+        {
+            std::free(header);
+            return;
+        }
+
+        SizeClassPool& pool = sPools[header->sizeClass];
+        std::lock_guard lock(pool.mutex);
+        *reinterpret_cast<void**>(header) = pool.freeList;
+        pool.freeList = header;
+    }
+
+    size_t poolCapacity(void* block)
+    {
+        const BlockHeader* header = static_cast<const BlockHeader*>(block) - 1;
+        return header->sizeClass == cLargeBlock ? 0 : cSizeClasses[header->sizeClass];
+    }
+
+#ifndef JPH_DISABLE_CUSTOM_ALLOCATOR
+    void* joltAllocate(size_t inSize)
+    {
+        Memory::recordAllocation(MemTag::Physics, inSize);
+        return poolAllocate(inSize);
+    }
+
+    void joltFree(void* inBlock)
+    {
+        if (inBlock == nullptr)
+            return;
+        Memory::recordFree(MemTag::Physics);
+        poolFree(inBlock);
+    }
+
+    void* joltReallocate(void* inBlock, size_t inOldSize, size_t inNewSize)
+    {
+        if (inBlock != nullptr && inNewSize <= poolCapacity(inBlock))
+            return inBlock;
+
+        void* block = joltAllocate(inNewSize);
+        if (inBlock != nullptr)
+        {
+            std::memcpy(block, inBlock, std::min(inOldSize, inNewSize));
+            joltFree(inBlock);
+        }
+        return block;
+    }
+
+    void* joltAlignedAllocate(size_t inSize, size_t inAlignment)
+    {
+        Memory::recordAllocation(MemTag::Physics, inSize);
+        return alignedAlloc(inSize, inAlignment);
+    }
+
+    void joltAlignedFree(void* inBlock)
+    {
+        if (inBlock == nullptr)
+            return;
+        Memory::recordFree(MemTag::Physics);
+        alignedFree(inBlock);
+    }
+#endif
+}
+
+void Memory::installJoltAllocator()
+{
+#ifndef JPH_DISABLE_CUSTOM_ALLOCATOR
+    JPH::Allocate = joltAllocate;
+    JPH::Reallocate = joltReallocate;
+    JPH::Free = joltFree;
+    JPH::AlignedAllocate = joltAlignedAllocate;
+    JPH::AlignedFree = joltAlignedFree;
+#endif
+}
+
+// -----------------
+// Global heap tracking
+// -----------------
+
+#ifdef FPS_TRACK_ALLOCATIONS
+
+// Frees are charged to whatever tag is current, not the allocating one; the
+// counts are for spotting allocations in steady-state frames, not leak hunting.
+
+static void* trackedNew(size_t size)
+{
+    Memory::recordAllocation(Memory::currentTag(), size);
+    void* block = std::malloc(size ? size : 1);
+    if (block == nullptr)
+        std::abort();  // built without exceptions, so no std::bad_alloc
+    return block;
+}
+
+static void* trackedAlignedNew(size_t size, std::align_val_t alignment)
+{
+    Memory::recordAllocation(Memory::currentTag(), size);
+    void* block = alignedAlloc(size ? size : 1, static_cast<size_t>(alignment));
+    if (block == nullptr)
+        std::abort();
+    return block;
+}
+
+static void trackedDelete(void* block)
+{
+    if (block == nullptr)
+        return;
+    Memory::recordFree(Memory::currentTag());
+    std::free(block);
+}
+
+static void trackedAlignedDelete(void* block)
+{
+    if (block == nullptr)
+        return;
+    Memory::recordFree(Memory::currentTag());
+    alignedFree(block);
+}
+
+void* operator new(size_t size) { return trackedNew(size); }
+void* operator new[](size_t size) { return trackedNew(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return trackedNew(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return trackedNew(size); }
+void* operator new(size_t size, std::align_val_t alignment) { return trackedAlignedNew(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return trackedAlignedNew(size, alignment); }
+
+void operator delete(void* block) noexcept { trackedDelete(block); }
+void operator delete[](void* block) noexcept { trackedDelete(block); }
+void operator delete(void* block, size_t) noexcept { trackedDelete(block); }
+void operator delete[](void* block, size_t) noexcept { trackedDelete(block); }
+void operator delete(void* block, const std::nothrow_t&) noexcept { trackedDelete(block); }
+void operator delete[](void* block, const std::nothrow_t&) noexcept { trackedDelete(block); }
+void operator delete(void* block, std::align_val_t) noexcept { trackedAlignedDelete(block); }
+void operator delete[](void* block, std::align_val_t) noexcept { trackedAlignedDelete(block); }
+void operator delete(void* block, size_t, std::align_val_t) noexcept { trackedAlignedDelete(block); }
+void operator delete[](void* block, size_t, std::align_val_t) noexcept { trackedAlignedDelete(block); }
+
+#endif
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <Jolt/Jolt.h>
+#include <Jolt/Core/TempAllocator.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Who an allocation is charged to. Jolt's heap traffic is always Physics; game
+// code is charged to whatever MemTagScope is active on the allocating thread.
+enum class MemTag : uint8_t
+{
+    Other,
+    Physics,
+    Gameplay,
+    Streaming,
+    Render,
+    Assets,
+    Count
+};
+
+struct AllocationStats
+{
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t bytes = 0;
+};
+
+// Charges heap allocations on this thread to a tag until it goes out of scope
+class MemTagScope
+{
+public:
+    explicit MemTagScope(MemTag inTag);
+    ~MemTagScope();
+
+    MemTagScope(const MemTagScope&) = delete;
+    MemTagScope& operator=(const MemTagScope&) = delete;
+
+private:
+    MemTag mPrevious;
+};
+
+// Linear allocator that is reset once per frame. Bumping an atomic offset makes
+// it safe from any thread, and freeing is a no-op. It doubles as Jolt's temp
+// allocator, so a physics step's scratch memory never reaches the heap. If it runs
+// out, it falls back to malloc until the next reset. Each new high-water mark
+// reached that way is logged once; every overflowing frame is counted.
+class FrameArena final : public JPH::TempAllocator
+{
+public:
+    explicit FrameArena(size_t inCapacity);
+    ~FrameArena() override;
+
+    void* allocate(size_t size, size_t alignment = 16);
+
+    template <class T>
+    T* allocateArray(size_t count) { return static_cast<T*>(allocate(sizeof(T) * count, alignof(T))); }
+
+    // Invalidates everything handed out since the last reset
+    void reset();
+
+    size_t capacity() const { return mCapacity; }
+    size_t used() const { return std::min(mOffset.load(std::memory_order_relaxed), mCapacity); }
+    size_t highWater() const { return mHighWater; }
+    size_t overflowBytes() const { return mOverflowBytes; }
+    uint64_t overflowFrames() const { return mOverflowFrames; }
+    uint64_t overflowBytesTotal() const { return mOverflowBytesTotal; }
+
+    // JPH::TempAllocator
+    void* Allocate(JPH::uint inSize) override { return inSize == 0 ? nullptr : allocate(inSize, JPH_RVECTOR_ALIGNMENT); }
+    void Free(void*, JPH::uint) override {}
+
+private:
+    uint8_t* mBase;
+    size_t mCapacity;
+    std::atomic<size_t> mOffset{ 0 };
+    size_t mHighWater = 0;
+
+    std::mutex mOverflowMutex;
+    std::vector<void*> mOverflowBlocks;
+    size_t mOverflowBytes = 0;
+    uint64_t mOverflowFrames = 0;
+    uint64_t mOverflowBytesTotal = 0;
+};
+
+namespace Memory
+{
+    // Routes Jolt's Allocate/Reallocate/Free/AlignedAllocate/AlignedFree hooks through
+    // the tracked size-class pools. Replaces JPH::RegisterDefaultAllocator().
+    void installJoltAllocator();
+
+    // Per-frame scratch; today only the physics step allocates from it
+    FrameArena& frameArena();
+
+    // Call once at the top of every frame: resets the arena and rolls the
+    // counters over, so frameStats() describes the frame that just ended
+    void beginFrame();
+
+    AllocationStats frameStats(MemTag tag);
+    uint64_t frameAllocations();  // all tags together
+    const char* tagName(MemTag tag);
+
+    // Called by the tracking hooks
+    void recordAllocation(MemTag tag, size_t bytes);
+    void recordFree(MemTag tag);
+    MemTag currentTag();
+
+    // True when the global operator new is being counted (FPS_TRACK_ALLOCATIONS)
+    constexpr bool isTrackingGlobalHeap()
+    {
+#ifdef FPS_TRACK_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+}
@@ -0,0 +1,368 @@
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// -----------------
+// Metrics
+// -----------------
+
+namespace
+{
+    void appendNumber(std::string& out, double v)
+    {
+        if (std::isinf(v))
+        {
+            out += v > 0.0 ? "+Inf" : "-Inf";
+            return;
+        }
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.9g", v);
+        out += buffer;
+    }
+
+    void appendNumber(std::string& out, uint64_t v)
+    {
+        out += std::to_string(v);
+    }
+
+    // name{labels,extra} with either side optional
+    void appendSeries(std::string& out, const std::string& name, const char* suffix, const std::string& labels,
+        const std::string& extra = "")
+    {
+        out += name;
+        out += suffix;
+        if (labels.empty() && extra.empty())
+            return;
+        out += '{';
+        out += labels;
+        if (!labels.empty() && !extra.empty())
+            out += ',';
+        out += extra;
+        out += '}';
+    }
+}
+
+uint64_t Counter::value() const
+{
+    uint64_t total = 0;
+    for (const Shard& shard : mShards)
+        total += shard.value.load(std::memory_order_relaxed);
+    return total;
+}
+
+Histogram::Histogram(const std::vector<double>& inBounds)
+    : mBoundCount(std::min(inBounds.size(), cMaxBuckets))
+{
+    std::copy(inBounds.begin(), inBounds.begin() + mBoundCount, mBounds);
+}
+
+void Histogram::observe(double v)
+{
+    uint32_t slot = currentThreadSlot();
+    Shard& shard = mShards[slot == cNoThreadSlot ? 0 : slot];
+
+    size_t bucket = std::lower_bound(mBounds, mBounds + mBoundCount, v) - mBounds;
+    shard.counts[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    // Only the shared first shard ever sees two writers, so this rarely loops
+    double sum = shard.sum.load(std::memory_order_relaxed);
+    while (!shard.sum.compare_exchange_weak(sum, sum + v, std::memory_order_relaxed))
+        ;
+}
+
+Histogram::Snapshot Histogram::snapshot() const
+{
+    Snapshot out;
+    out.bounds.assign(mBounds, mBounds + mBoundCount);
+    out.counts.assign(mBoundCount + 1, 0);
+    for (const Shard& shard : mShards)
+    {
+        for (size_t i = 0; i <= mBoundCount; i++)
+            out.counts[i] += shard.counts[i].load(std::memory_order_relaxed);
+        out.sum += shard.sum.load(std::memory_order_relaxed);
+    }
+    for (uint64_t count : out.counts)
+        out.count += count;
+    return out;
+}
+
+double Histogram::Snapshot::quantile(double q) const
+{
+    if (count == 0 || bounds.empty())
+        return 0.0;
+    uint64_t rank = (uint64_t)std::ceil(q * (double)count);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bounds.size(); i++)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+            return bounds[i];
+    }
+    return bounds.back();
+}
+
+MetricsRegistry::Entry* MetricsRegistry::find(const char* name, const std::string& labels)
+{
+    for (const std::unique_ptr<Entry>& entry : mEntries)
+        if (entry->name == name && entry->labels == labels)
+            return entry.get();
+    return nullptr;
+}
+
+MetricsRegistry::Entry& MetricsRegistry::add(Type type, const char* name, const char* help, const std::string& labels)
+{
+    mEntries.push_back(std::make_unique<Entry>());
+    Entry& entry = *mEntries.back();
+    entry.type = type;
+    entry.name = name;
+    entry.help = help;
+    entry.labels = labels;
+    return entry;
+}
+
+Counter& MetricsRegistry::counter(const char* name, const char* help, const std::string& labels)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    Entry* entry = find(name, labels);
+    if (entry == nullptr)
+    {
+        entry = &add(Type::Counter, name, help, labels);
+        entry->counter = std::make_unique<Counter>();
+    }
+    return *entry->counter;
+}
+
+Gauge& MetricsRegistry::gauge(const char* name, const char* help, const std::string& labels)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    Entry* entry = find(name, labels);
+    if (entry == nullptr)
+    {
+        entry = &add(Type::Gauge, name, help, labels);
+        entry->gauge = std::make_unique<Gauge>();
+    }
+    return *entry->gauge;
+}
+
+Histogram& MetricsRegistry::histogram(const char* name, const char* help, const std::vector<double>& bounds,
+    const std::string& labels)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    Entry* entry = find(name, labels);
+    if (entry == nullptr)
+    {
+        entry = &add(Type::Histogram, name, help, labels);
+        entry->histogram = std::make_unique<Histogram>(bounds);
+    }
+    return *entry->histogram;
+}
+
+void MetricsRegistry::writePrometheus(std::string& out) const
+{
+    static const char* const cTypeNames[] = { "counter", "gauge", "histogram" };
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (size_t i = 0; i < mEntries.size(); i++)
+    {
+        const Entry& entry = *mEntries[i];
+
+        // All series of a family have to follow a single HELP/TYPE header
+        bool firstOfFamily = true;
+        for (size_t j = 0; j < i && firstOfFamily; j++)
+            firstOfFamily = mEntries[j]->name != entry.name;
+        if (!firstOfFamily)
+            continue;
+
+        out += "# HELP " + entry.name + " " + entry.help + "\n";
+        out += "# TYPE " + entry.name + " " + cTypeNames[(int)entry.type] + "\n";
+
+        for (size_t j = i; j < mEntries.size(); j++)
+        {
+            const Entry& series = *mEntries[j];
+            if (series.name != entry.name)
+                continue;
+
+            switch (series.type)
+            {
+            case Type::Counter:
+                appendSeries(out, series.name, "", series.labels);
+                out += ' ';
+                appendNumber(out, series.counter->value());
+                out += '\n';
+                break;
+            case Type::Gauge:
+                appendSeries(out, series.name, "", series.labels);
+                out += ' ';
+                appendNumber(out, series.gauge->value());
+                out += '\n';
+                break;
+            case Type::Histogram:
+            {
+                Histogram::Snapshot snapshot = series.histogram->snapshot();
+                uint64_t cumulative = 0;
+                for (size_t b = 0; b <= snapshot.bounds.size(); b++)
+                {
+                    cumulative += snapshot.counts[b];
+                    std::string le = "le=\"";
+                    appendNumber(le, b < snapshot.bounds.size() ? snapshot.bounds[b] : INFINITY);
+                    le += '"';
+                    appendSeries(out, series.name, "_bucket", series.labels, le);
+                    out += ' ';
+                    appendNumber(out, cumulative);
+                    out += '\n';
+                }
+                appendSeries(out, series.name, "_sum", series.labels);
+                out += ' ';
+                appendNumber(out, snapshot.sum);
+                out += '\n';
+                appendSeries(out, series.name, "_count", series.labels);
+                out += ' ';
+                appendNumber(out, snapshot.count);
+                out += '\n';
+                break;
+            }
+            }
+        }
+    }
+}
+
+void MetricsRegistry::writeSummary(std::string& out) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    char line[160];
+    for (const std::unique_ptr<Entry>& entry : mEntries)
+    {
+        const char* name = entry->name.c_str();
+        if (std::strncmp(name, "fps_", 4) == 0)
+            name += 4;
+        std::string label = entry->labels.empty() ? "" : "{" + entry->labels + "}";
+
+        switch (entry->type)
+        {
+        case Type::Counter:
+            std::snprintf(line, sizeof(line), "%s%s %llu\n", name, label.c_str(),
+                (unsigned long long)entry->counter->value());
+            break;
+        case Type::Gauge:
+            std::snprintf(line, sizeof(line), "%s%s %.6g\n", name, label.c_str(), entry->gauge->value());
+            break;
+        case Type::Histogram:
+        {
+            Histogram::Snapshot snapshot = entry->histogram->snapshot();
+            double mean = snapshot.count > 0 ? snapshot.sum / (double)snapshot.count : 0.0;
+            std::snprintf(line, sizeof(line), "%s%s n=%llu mean=%.4g p99<=%.4g\n", name, label.c_str(),
+                (unsigned long long)snapshot.count, mean, snapshot.quantile(0.99));
+            break;
+        }
+        }
+        out += line;
+    }
+}
+
+MetricsRegistry& Metrics::registry()
+{
+    static MetricsRegistry sRegistry;
+    return sRegistry;
+}
+
+const std::vector<double>& Metrics::tickBuckets()
+{
+    // Dense around the 16.7ms budget so an overrun shows up as its own bucket
+    static const std::vector<double> sBuckets = {
+        0.0005, 0.001, 0.002, 0.004, 0.008, 0.012, 0.0167, 0.025, 0.0333, 0.05, 0.1, 0.25
+    };
+    return sBuckets;
+}
+
+void Metrics::recordTick(double seconds, double budget)
+{
+    static Histogram& sTickTime = registry().histogram("fps_tick_seconds", "Wall time of one simulation tick", tickBuckets());
+    static Counter& sOverruns = registry().counter("fps_tick_overruns_total", "Ticks that took longer than their budget");
+    static Gauge& sBudget = registry().gauge("fps_tick_budget_seconds", "Time one tick is allowed at the fixed tick rate");
+
+    sTickTime.observe(seconds);
+    sBudget.set(budget);
+    if (seconds > budget)
+        sOverruns.add();
+}
+
+// -----------------
+// HTTP endpoint
+// -----------------
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+bool MetricsServer::start(uint16_t port)
+{
+    stop();
+    if (!mListener.open(port))
+        return false;
+
+    std::cout << "Serving metrics on http://127.0.0.1:" << mListener.localPort() << "/metrics" << std::endl;
+    mRunning = true;
+    mThread = std::thread(&MetricsServer::serve, this);
+    return true;
+}
+
+void MetricsServer::stop()
+{
+    mRunning = false;
+    if (mThread.joinable())
+        mThread.join();
+    mListener.close();
+}
+
+void MetricsServer::serve()
+{
+    // Short accept timeout so stop() never waits long on the join
+    while (mRunning)
+    {
+        TcpStream stream;
+        if (mListener.accept(stream, 100))
+            respond(stream);
+    }
+}
+
+void MetricsServer::respond(TcpStream& stream)
+{
+    // Scrapers send a small GET; read until the end of its headers
+    std::string request;
+    char buffer[1024];
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+            return;
+        int received = stream.receive(buffer, sizeof(buffer), 100);
+        if (received == 0)
+            return;
+        if (received > 0)
+            request.append(buffer, received);
+    }
+
+    std::string body;
+    const char* status = "200 OK";
+    if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0)
+        Metrics::registry().writePrometheus(body);
+    else
+    {
+        status = "404 Not Found";
+        body = "Not found\n";
+    }
+
+    std::string response = "HTTP/1.1 ";
+    response += status;
+    response += "\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: ";
+    response += std::to_string(body.size());
+    response += "\r\nConnection: close\r\n\r\n";
+    response += body;
+    stream.sendAll(response.data(), response.size());
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "NetSocket.hpp"
+#include "ThreadSlots.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Monotonic count. Each thread slot adds into its own cache line, so hot paths
+// on the physics workers never contend; readers sum the shards.
+class Counter
+{
+public:
+    void add(uint64_t n = 1)
+    {
+        uint32_t slot = currentThreadSlot();
+        mShards[slot == cNoThreadSlot ? 0 : slot].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const;
+
+private:
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> value{ 0 };
+    };
+
+    Shard mShards[cMaxThreadSlots];  // threads without a slot share the first one
+};
+
+// Last written value wins
+class Gauge
+{
+public:
+    void set(double v) { mValue.store(v, std::memory_order_relaxed); }
+    double value() const { return mValue.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> mValue{ 0.0 };
+};
+
+// Cumulative distribution over fixed upper bounds, sharded like Counter
+class Histogram
+{
+public:
+    static constexpr size_t cMaxBuckets = 16;
+
+    explicit Histogram(const std::vector<double>& inBounds);
+
+    void observe(double v);
+
+    struct Snapshot
+    {
+        std::vector<double> bounds;
+        std::vector<uint64_t> counts;  // per bucket, not cumulative; one more than bounds for +Inf
+        uint64_t count = 0;
+        double sum = 0.0;
+
+        // Upper bound of the bucket holding quantile q, or the last bound if it is in +Inf
+        double quantile(double q) const;
+    };
+
+    Snapshot snapshot() const;
+
+private:
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> counts[cMaxBuckets + 1] = {};
+        std::atomic<double> sum{ 0.0 };
+    };
+
+    double mBounds[cMaxBuckets];
+    size_t mBoundCount;
+    Shard mShards[cMaxThreadSlots];
+};
+
+// Named metrics for the whole process. Registering is locked and meant to happen
+// once, with the returned reference kept by the caller; updates through it are
+// lock-free. Asking again for the same name and labels returns the same metric.
+class MetricsRegistry
+{
+public:
+    // labels are Prometheus label pairs without braces, e.g. tag="physics"
+    Counter& counter(const char* name, const char* help, const std::string& labels = "");
+    Gauge& gauge(const char* name, const char* help, const std::string& labels = "");
+    Histogram& histogram(const char* name, const char* help, const std::vector<double>& bounds,
+        const std::string& labels = "");
+
+    // Prometheus text exposition format 0.0.4
+    void writePrometheus(std::string& out) const;
+
+    // One short line per metric for the overlay
+    void writeSummary(std::string& out) const;
+
+private:
+    enum class Type : uint8_t
+    {
+        Counter,
+        Gauge,
+        Histogram
+    };
+
+    struct Entry
+    {
+        Type type;
+        std::string name;
+        std::string help;
+        std::string labels;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+    };
+
+    Entry* find(const char* name, const std::string& labels);
+    Entry& add(Type type, const char* name, const char* help, const std::string& labels);
+
+    mutable std::mutex mMutex;
+    std::vector<std::unique_ptr<Entry>> mEntries;  // registration order, kept stable for the exposition
+};
+
+namespace Metrics
+{
+    MetricsRegistry& registry();
+
+    // Bucket bounds in seconds for anything measured against a 60Hz tick
+    const std::vector<double>& tickBuckets();
+
+    // Wall time of one simulation tick against the time it is allowed. The game
+    // loop and the load test server both report here, so an alert on overruns
+    // works whichever of them the process is running.
+    void recordTick(double seconds, double budget);
+}
+
+// Serves the registry at http://127.0.0.1:<port>/metrics from its own thread
+class MetricsServer
+{
+public:
+    ~MetricsServer();
+
+    bool start(uint16_t port);
+    void stop();
+    bool isRunning() const { return mThread.joinable(); }
+
+private:
+    void serve();
+    void respond(TcpStream& stream);
+
+    TcpListener mListener;
+    std::thread mThread;
+    std::atomic<bool> mRunning{ false };
+};
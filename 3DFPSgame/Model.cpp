@@ -1,21 +1,40 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 #include "Model.hpp"
+#include <algorithm>
 #include <iostream>
 
 Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures)
-    : vertices(vertices), indices(indices), textures(textures) {
+    : vertices(vertices), indices(indices), textures(textures), VAO(0), VBO(0), EBO(0) {
+}
+
+void Mesh::upload() {
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
     glBindVertexArray(VAO);
 
+    // Every level goes into the same two buffers after the full-detail mesh
+    size_t vertexCount = vertices.size(), indexCount = indices.size();
+    for (MeshLod& lod : lods) {
+        lod.baseVertex = (int)vertexCount;
+        lod.firstIndex = indexCount;
+        vertexCount += lod.vertices.size();
+        indexCount += lod.indices.size();
+    }
+
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), nullptr, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(Vertex), vertices.data());
+    for (const MeshLod& lod : lods)
+        glBufferSubData(GL_ARRAY_BUFFER, lod.baseVertex * sizeof(Vertex), lod.vertices.size() * sizeof(Vertex), lod.vertices.data());
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indices.size() * sizeof(unsigned int), indices.data());
+    for (const MeshLod& lod : lods)
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, lod.firstIndex * sizeof(unsigned int), lod.indices.size() * sizeof(unsigned int), lod.indices.data());
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
     glEnableVertexAttribArray(0);
@@ -26,29 +45,127 @@ Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std:
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
     glEnableVertexAttribArray(2);
 
+    if (!skin.empty()) {
+        glGenBuffers(1, &skinVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, skinVBO);
+        glBufferData(GL_ARRAY_BUFFER, skin.size() * sizeof(VertexSkin), skin.data(), GL_STATIC_DRAW);
+
+        glVertexAttribIPointer(3, cMaxJointInfluences, GL_UNSIGNED_BYTE, sizeof(VertexSkin), (void*)offsetof(VertexSkin, joints));
+        glEnableVertexAttribArray(3);
+
+        glVertexAttribPointer(4, cMaxJointInfluences, GL_FLOAT, GL_FALSE, sizeof(VertexSkin), (void*)offsetof(VertexSkin, weights));
+        glEnableVertexAttribArray(4);
+    }
+
     glBindVertexArray(0);
 }
 
-void Mesh::draw() {
+void Mesh::release() {
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    if (skinVBO != 0)
+        glDeleteBuffers(1, &skinVBO);
+    VAO = VBO = EBO = skinVBO = 0;
+}
+
+void Mesh::draw(int lod) {
     for (unsigned int i = 0; i < textures.size(); i++) {
         glActiveTexture(GL_TEXTURE0 + i);
         glBindTexture(GL_TEXTURE_2D, textures[i].id);
     }
 
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+    drawElements(lod);
+
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::drawDepth(int lod) {
+    drawElements(lod);
+}
+
+void Mesh::drawStreamed(unsigned int streamVAO, int baseVertex, bool depthOnly) {
+    if (!depthOnly) {
+        for (unsigned int i = 0; i < textures.size(); i++) {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        }
+    }
+
+    // The element buffer binding is VAO state, so this points the stream VAO at our indices
+    glBindVertexArray(streamVAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glDrawElementsBaseVertex(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, baseVertex);
     glBindVertexArray(0);
 
     glActiveTexture(GL_TEXTURE0);
 }
 
-Model::Model(const std::string& path) {
+void Mesh::drawElements(int lod) {
+    glBindVertexArray(VAO);
+    if (lod <= 0 || lods.empty()) {
+        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+    }
+    else {
+        // Meshes that stopped simplifying early draw their coarsest level
+        const MeshLod& level = lods[std::min((size_t)lod, lods.size()) - 1];
+        glDrawElementsBaseVertex(GL_TRIANGLES, level.indices.size(), GL_UNSIGNED_INT,
+            (void*)(level.firstIndex * sizeof(unsigned int)), level.baseVertex);
+    }
+    glBindVertexArray(0);
+}
+
+Model::Model(const std::string& path, bool inDeferUpload, const LodSettings* inLodSettings)
+    : deferUpload(inDeferUpload), lodSettings(inLodSettings) {
     loadModel(path);
+    if (!deferUpload)
+        uploadToGPU();
+}
+
+void Model::uploadToGPU() {
+    if (uploaded)
+        return;
+
+    for (PendingTexture& pending : pendingTextures) {
+        textures_loaded[pending.loadedIndex].id = uploadTexture(pending.image);
+        stbi_image_free(pending.image.pixels);
+    }
+    pendingTextures.clear();
+
+    for (Mesh& mesh : meshes) {
+        // Meshes hold copies of their textures, patch in the ids that exist now
+        for (Texture& texture : mesh.textures) {
+            for (const Texture& loadedTexture : textures_loaded) {
+                if (loadedTexture.path == texture.path) {
+                    texture.id = loadedTexture.id;
+                    break;
+                }
+            }
+        }
+        mesh.upload();
+    }
+
+    uploaded = true;
+}
+
+void Model::releaseGPU() {
+    if (!uploaded)
+        return;
+
+    for (Mesh& mesh : meshes)
+        mesh.release();
+    for (Texture& texture : textures_loaded) {
+        glDeleteTextures(1, &texture.id);
+        texture.id = 0;
+    }
+
+    uploaded = false;
 }
 
 void Model::loadModel(const std::string& path) {
+    filePath = path;
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_LimitBoneWeights);
 
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
         std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
@@ -57,7 +174,10 @@ void Model::loadModel(const std::string& path) {
 
     directory = path.substr(0, path.find_last_of('/'));
 
+    // The skeleton comes first so meshes can map their bones to joint indices
+    loadSkeleton(scene);
     processNode(scene->mRootNode, scene);
+    loadClips(scene);
 }
 
 void Model::processNode(aiNode* node, const aiScene* scene) {
@@ -75,11 +195,15 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
+    vertices.reserve(mesh->mNumVertices);
+    indices.reserve(mesh->mNumFaces * 3);
 
     for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
         Vertex vertex;
         vertex.position = { mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z };
         vertex.normal = { mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z };
+        boundsMin = glm::min(boundsMin, vertex.position);
+        boundsMax = glm::max(boundsMax, vertex.position);
 
         if (mesh->mTextureCoords[0]) {
             vertex.texCoords = { mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y };
@@ -104,7 +228,194 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
         textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
     }
 
-    return Mesh(vertices, indices, textures);
+    Mesh result(vertices, indices, textures);
+    // Rigid parts of a skinned model get a skin too, bound to the root, so every
+    // mesh in it can share one shader path
+    if (isSkinned())
+        loadSkin(mesh, result);
+
+    // Clustering would have to merge bone weights too, so skinned meshes keep full detail
+    if (lodSettings && result.skin.empty())
+        generateLods(result);
+    return result;
+}
+
+static glm::mat4 toGlm(const aiMatrix4x4& m) {
+    // assimp is row major
+    return glm::mat4(m.a1, m.b1, m.c1, m.d1,
+        m.a2, m.b2, m.c2, m.d2,
+        m.a3, m.b3, m.c3, m.d3,
+        m.a4, m.b4, m.c4, m.d4);
+}
+
+static bool hasBoneBelow(const aiNode* node, const std::unordered_map<std::string, aiMatrix4x4>& offsets) {
+    if (offsets.count(node->mName.C_Str()))
+        return true;
+    for (unsigned int i = 0; i < node->mNumChildren; i++) {
+        if (hasBoneBelow(node->mChildren[i], offsets))
+            return true;
+    }
+    return false;
+}
+
+void Model::loadSkeleton(const aiScene* scene) {
+    std::unordered_map<std::string, aiMatrix4x4> offsets;
+    for (unsigned int m = 0; m < scene->mNumMeshes; m++) {
+        const aiMesh* mesh = scene->mMeshes[m];
+        for (unsigned int b = 0; b < mesh->mNumBones; b++)
+            offsets.emplace(mesh->mBones[b]->mName.C_Str(), mesh->mBones[b]->mOffsetMatrix);
+    }
+    if (offsets.empty())
+        return;
+
+    addJoints(scene->mRootNode, -1, offsets);
+    if (skeleton.size() > 256) {
+        std::cout << "Skeleton in " << directory << " has " << skeleton.size() << " joints, more than a vertex can index; drawing it unskinned." << std::endl;
+        skeleton = Skeleton();
+        return;
+    }
+
+    skeleton.globalInverse = glm::inverse(toGlm(scene->mRootNode->mTransformation));
+    skeleton.restPose.resize(skeleton.size());
+    for (size_t j = 0; j < skeleton.size(); j++) {
+        const aiNode* node = scene->mRootNode->FindNode(skeleton.names[j].c_str());
+        aiVector3D scale, position;
+        aiQuaternion rotation;
+        node->mTransformation.Decompose(scale, rotation, position);
+        skeleton.restPose.set(j, glm::vec3(position.x, position.y, position.z),
+            glm::quat(rotation.w, rotation.x, rotation.y, rotation.z), glm::vec3(scale.x, scale.y, scale.z));
+    }
+}
+
+// Every bone plus the nodes above it, depth first, so parents precede children
+void Model::addJoints(const aiNode* node, int parent, const std::unordered_map<std::string, aiMatrix4x4>& offsets) {
+    if (!hasBoneBelow(node, offsets))
+        return;
+
+    auto offset = offsets.find(node->mName.C_Str());
+    int index = skeleton.addJoint(node->mName.C_Str(), parent, offset != offsets.end() ? toGlm(offset->second) : glm::mat4(1.0f));
+    for (unsigned int i = 0; i < node->mNumChildren; i++)
+        addJoints(node->mChildren[i], index, offsets);
+}
+
+void Model::loadClips(const aiScene* scene) {
+    if (!isSkinned())
+        return;
+
+    for (unsigned int a = 0; a < scene->mNumAnimations; a++) {
+        const aiAnimation* animation = scene->mAnimations[a];
+        float ticksPerSecond = animation->mTicksPerSecond != 0.0 ? (float)animation->mTicksPerSecond : 25.0f;
+
+        AnimationClip clip;
+        clip.name = animation->mName.C_Str();
+        clip.duration = (float)animation->mDuration / ticksPerSecond;
+        clip.tracks.resize(skeleton.size());
+
+        for (unsigned int c = 0; c < animation->mNumChannels; c++) {
+            const aiNodeAnim* channel = animation->mChannels[c];
+            int joint = skeleton.find(channel->mNodeName.C_Str());
+            if (joint < 0)
+                continue;
+
+            JointTrack& track = clip.tracks[joint];
+            for (unsigned int k = 0; k < channel->mNumPositionKeys; k++) {
+                const aiVectorKey& key = channel->mPositionKeys[k];
+                track.positionTimes.push_back((float)key.mTime / ticksPerSecond);
+                track.positions.emplace_back(key.mValue.x, key.mValue.y, key.mValue.z);
+            }
+            for (unsigned int k = 0; k < channel->mNumRotationKeys; k++) {
+                const aiQuatKey& key = channel->mRotationKeys[k];
+                track.rotationTimes.push_back((float)key.mTime / ticksPerSecond);
+                track.rotations.emplace_back(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z);
+            }
+            for (unsigned int k = 0; k < channel->mNumScalingKeys; k++) {
+                const aiVectorKey& key = channel->mScalingKeys[k];
+                track.scaleTimes.push_back((float)key.mTime / ticksPerSecond);
+                track.scales.emplace_back(key.mValue.x, key.mValue.y, key.mValue.z);
+            }
+        }
+        clips.push_back(std::move(clip));
+    }
+}
+
+void Model::loadSkin(const aiMesh* mesh, Mesh& target) {
+    target.skin.assign(target.vertices.size(), VertexSkin());
+
+    // Keep the heaviest four influences per vertex, then renormalize
+    for (unsigned int b = 0; b < mesh->mNumBones; b++) {
+        const aiBone* bone = mesh->mBones[b];
+        int joint = skeleton.find(bone->mName.C_Str());
+        if (joint < 0)
+            continue;
+
+        for (unsigned int w = 0; w < bone->mNumWeights; w++) {
+            VertexSkin& skin = target.skin[bone->mWeights[w].mVertexId];
+            int lightest = 0;
+            for (int k = 1; k < cMaxJointInfluences; k++) {
+                if (skin.weights[k] < skin.weights[lightest])
+                    lightest = k;
+            }
+            if (bone->mWeights[w].mWeight > skin.weights[lightest]) {
+                skin.weights[lightest] = bone->mWeights[w].mWeight;
+                skin.joints[lightest] = (uint8_t)joint;
+            }
+        }
+    }
+
+    for (VertexSkin& skin : target.skin) {
+        float total = skin.weights[0] + skin.weights[1] + skin.weights[2] + skin.weights[3];
+        if (total > 0.0f) {
+            for (float& weight : skin.weights)
+                weight /= total;
+        }
+        else {
+            skin.weights[0] = 1.0f;  // unweighted vertices follow the root
+        }
+    }
+}
+
+const AnimationClip* Model::findClip(const std::string& name) const {
+    for (const AnimationClip& clip : clips) {
+        if (clip.name == name)
+            return &clip;
+    }
+    return nullptr;
+}
+
+bool Model::usesFile(const std::filesystem::path& file) const {
+    std::filesystem::path target = file.lexically_normal();
+    if (std::filesystem::path(filePath).lexically_normal() == target)
+        return true;
+
+    // Embedded textures are named "*<index>" and have no file behind them
+    for (const Texture& texture : textures_loaded) {
+        if (!texture.path.empty() && texture.path[0] != '*'
+            && (std::filesystem::path(directory) / texture.path).lexically_normal() == target)
+            return true;
+    }
+    return false;
+}
+
+size_t Model::vertexCount() const {
+    size_t count = 0;
+    for (const Mesh& mesh : meshes)
+        count += mesh.vertices.size();
+    return count;
+}
+
+void Model::generateLods(Mesh& mesh) {
+    size_t triangles = mesh.indices.size() / 3;
+    if (triangles < lodSettings->minTriangles)
+        return;
+
+    // Every level is simplified from the full mesh so errors don't compound
+    for (float ratio : lodSettings->triangleRatios) {
+        MeshLod lod;
+        if (!simplifyMesh(mesh.vertices, mesh.indices, (size_t)(triangles * ratio), lod.vertices, lod.indices))
+            break;
+        mesh.lods.push_back(std::move(lod));
+    }
+    lodLevels = std::max(lodLevels, 1 + (int)mesh.lods.size());
 }
 
 std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, const aiScene* scene) {
@@ -116,11 +427,9 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType
         const aiTexture* aiTex = scene->GetEmbeddedTexture(str.C_Str());
         if (aiTex) {
             Texture texture;
-            texture.id = TextureFromAssimp(aiTex);
             texture.type = type;
             texture.path = str.C_Str();
-            textures.push_back(texture);
-            textures_loaded.push_back(texture);
+            addTexture(texture, decodeEmbeddedTexture(aiTex), textures);
         }
         else {
             bool skip = false;
@@ -134,78 +443,107 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType
 
             if (!skip) {
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), directory);
                 texture.type = type;
                 texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);
+                addTexture(texture, decodeTextureFile(str.C_Str(), directory), textures);
             }
         }
     }
     return textures;
 }
 
+void Model::addTexture(Texture texture, DecodedImage image, std::vector<Texture>& textures) {
+    if (deferUpload) {
+        pendingTextures.push_back({ textures_loaded.size(), image });
+    }
+    else {
+        texture.id = uploadTexture(image);
+        stbi_image_free(image.pixels);
+    }
+    textures.push_back(texture);
+    textures_loaded.push_back(texture);
+}
+
 unsigned int Model::TextureFromFile(const char* path, const std::string& directory) {
+    DecodedImage image = decodeTextureFile(path, directory);
+    unsigned int textureID = uploadTexture(image);
+    stbi_image_free(image.pixels);
+    return textureID;
+}
+
+unsigned int Model::TextureFromAssimp(const aiTexture* aiTex) {
+    DecodedImage image = decodeEmbeddedTexture(aiTex);
+    unsigned int textureID = uploadTexture(image);
+    stbi_image_free(image.pixels);
+    return textureID;
+}
+
+DecodedImage Model::decodeTextureFile(const char* path, const std::string& directory) {
     std::filesystem::path filename = std::filesystem::path(directory) / path;
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.string().c_str(), &width, &height, &nrComponents, 0);
-    if (data) {
+    DecodedImage image;
+    if (loadCookedTexture(filename, image.cooked)) {
+        image.sourcePath = filename.string();
+        return image;
+    }
+
+    image.pixels = stbi_load(filename.string().c_str(), &image.width, &image.height, &image.channels, 0);
+    if (!image.pixels) {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+    }
+    return image;
+}
+
+DecodedImage Model::decodeEmbeddedTexture(const aiTexture* aiTex) {
+    DecodedImage image;
+    if (aiTex->mHeight == 0) {    // compressed texture
+        image.pixels = stbi_load_from_memory(
+            reinterpret_cast<unsigned char*>(aiTex->pcData),
+            aiTex->mWidth, &image.width, &image.height, &image.channels, 0
+        );
+
+        if (!image.pixels) {
+            std::cout << "Failed to load embedded texture from memory." << std::endl;
+        }
+    }
+    else {
+        std::cout << "Embedded texture format not supported." << std::endl;
+    }
+    return image;
+}
+
+// Uploads decoded pixels into the bound texture and builds their mips
+static void uploadPixels(const DecodedImage& image) {
+    if (image.pixels) {
         GLenum format;
-        if (nrComponents == 1)
+        if (image.channels == 1)
             format = GL_RED;
-        else if (nrComponents == 3)
+        else if (image.channels == 3)
             format = GL_RGB;
-        else if (nrComponents == 4)
+        else if (image.channels == 4)
             format = GL_RGBA;
         else
             format = GL_RGB;
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
         glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
     }
-    else {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
 }
 
-unsigned int Model::TextureFromAssimp(const aiTexture* aiTex) {
+unsigned int Model::uploadTexture(const DecodedImage& image) {
     unsigned int textureID;
     glGenTextures(1, &textureID);
     glBindTexture(GL_TEXTURE_2D, textureID);
 
-    if (aiTex->mHeight == 0) {    // compressed texture
-        int width, height, nrChannels;
-        unsigned char* data = stbi_load_from_memory(
-            reinterpret_cast<unsigned char*>(aiTex->pcData),
-            aiTex->mWidth, &width, &height, &nrChannels, 0
-        );
-
-        if (data) {
-            GLenum format = (nrChannels == 4) ? GL_RGBA : GL_RGB;
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
-            stbi_image_free(data);
-        }
-        else {
-            std::cout << "Failed to load embedded texture from memory." << std::endl;
-        }
+    if (image.cooked.empty()) {
+        uploadPixels(image);
     }
-    else {
-        std::cout << "Embedded texture format not supported." << std::endl;
+    else if (!uploadCookedTexture(image.cooked)) {
+        std::cout << "Driver can't sample cooked texture, decoding " << image.sourcePath << std::endl;
+        DecodedImage source;
+        source.pixels = stbi_load(image.sourcePath.c_str(), &source.width, &source.height, &source.channels, 0);
+        uploadPixels(source);
+        stbi_image_free(source.pixels);
     }
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -216,8 +554,21 @@ unsigned int Model::TextureFromAssimp(const aiTexture* aiTex) {
     return textureID;
 }
 
-void Model::draw() {
+void Model::draw(int lod) {
+    for (Mesh& mesh : meshes) {
+        mesh.draw(lod);
+    }
+}
+
+void Model::drawDepth(int lod) {
     for (Mesh& mesh : meshes) {
-        mesh.draw();
+        mesh.drawDepth(lod);
     }
-}
\ No newline at end of file
+}
+
+void Model::drawStreamed(unsigned int streamVAO, int baseVertex, bool depthOnly) {
+    for (Mesh& mesh : meshes) {
+        mesh.drawStreamed(streamVAO, baseVertex, depthOnly);
+        baseVertex += (int)mesh.vertices.size();
+    }
+}
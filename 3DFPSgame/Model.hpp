@@ -1,6 +1,7 @@
 #ifndef MODEL_HPP
 #define MODEL_HPP
 
+#include <cfloat>
 #include <vector>
 #include <string>
 #include <filesystem>
@@ -9,6 +10,10 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <glad/glad.h>
+#include "Lod.hpp"
+#include "Animation.hpp"
+#include "TextureCook.hpp"
+#include <unordered_map>
 
 struct Vertex {
     glm::vec3 position;
@@ -17,38 +22,111 @@ struct Vertex {
 };
 
 struct Texture {
-    unsigned int id;
+    unsigned int id = 0;
     aiTextureType type;
     std::string path;
 };
 
+// Pixels decoded by stb, or a cooked mip chain, waiting for a GL context to upload them
+struct DecodedImage {
+    int width = 0, height = 0, channels = 0;
+    unsigned char* pixels = nullptr;
+    CookedTexture cooked;
+    std::string sourcePath;  // decoded at upload instead if the driver can't take the cooked format
+};
+
+// A simplified copy of a mesh. Shares the mesh's VAO and buffers once uploaded.
+struct MeshLod {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    int baseVertex = 0;
+    size_t firstIndex = 0;
+};
+
 class Mesh {
 public:
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
+    std::vector<MeshLod> lods;  // coarser levels, level 1 first; vertices/indices stay full detail
+    std::vector<VertexSkin> skin;  // parallel to vertices for skinned meshes, which get no LODs
     unsigned int VAO, VBO, EBO;
+    unsigned int skinVBO = 0;
 
     Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
-    void draw();
+    void upload();
+    void release();
+    void draw(int lod = 0);
+    void drawDepth(int lod = 0);  // geometry only, for depth passes
+
+    // Draws with vertices from another VAO, e.g. CPU-skinned ones, and this mesh's indices
+    void drawStreamed(unsigned int streamVAO, int baseVertex, bool depthOnly);
+
+private:
+    void drawElements(int lod);
 };
 
 class Model {
 public:
     std::vector<Texture> textures_loaded;
     std::vector<Mesh> meshes;
+    std::string filePath;
     std::string directory;
 
-    Model(const std::string& path);
-    void draw();
+    // Local-space bounds over every mesh, empty (min > max) if nothing loaded
+    glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+    glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+
+    // Empty unless the file has bones
+    Skeleton skeleton;
+    std::vector<AnimationClip> clips;
+
+    // With deferUpload the constructor only touches the CPU (assimp + stb) and is
+    // safe to run on a loader thread; uploadToGPU must then be called on the GL thread.
+    // With lodSettings, simplified levels are generated per mesh after import.
+    Model(const std::string& path, bool deferUpload = false, const LodSettings* lodSettings = nullptr);
+    void uploadToGPU();
+    void releaseGPU();
+    bool isUploaded() const { return uploaded; }
+    bool hasBounds() const { return boundsMin.x <= boundsMax.x; }
+    int lodCount() const { return lodLevels; }
+    bool isSkinned() const { return skeleton.size() > 0; }
+    const AnimationClip* findClip(const std::string& name) const;
+
+    // True for the model file itself and for any texture it loaded from disk
+    bool usesFile(const std::filesystem::path& file) const;
+    size_t vertexCount() const;
+    void draw(int lod = 0);
+    void drawDepth(int lod = 0);
+    void drawStreamed(unsigned int streamVAO, int baseVertex, bool depthOnly);
 
 private:
+    struct PendingTexture {
+        size_t loadedIndex;
+        DecodedImage image;
+    };
+
+    std::vector<PendingTexture> pendingTextures;
+    bool deferUpload = false;
+    bool uploaded = false;
+    const LodSettings* lodSettings = nullptr;
+    int lodLevels = 1;
+
     void loadModel(const std::string& path);
     void processNode(aiNode* node, const aiScene* scene);
     Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+    void generateLods(Mesh& mesh);
+    void loadSkeleton(const aiScene* scene);
+    void addJoints(const aiNode* node, int parent, const std::unordered_map<std::string, aiMatrix4x4>& offsets);
+    void loadClips(const aiScene* scene);
+    void loadSkin(const aiMesh* mesh, Mesh& target);
     std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, const aiScene* scene);
     unsigned int TextureFromFile(const char* path, const std::string& directory);
     unsigned int TextureFromAssimp(const aiTexture* aiTex);
+    DecodedImage decodeTextureFile(const char* path, const std::string& directory);
+    DecodedImage decodeEmbeddedTexture(const aiTexture* aiTex);
+    unsigned int uploadTexture(const DecodedImage& image);
+    void addTexture(Texture texture, DecodedImage image, std::vector<Texture>& textures);
 };
 
 #endif // MODEL_HPP
@@ -0,0 +1,343 @@
+#include "Navigation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+using namespace JPH;
+
+static constexpr int cDirX[NavGrid::cNumDirections] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+static constexpr int cDirZ[NavGrid::cNumDirections] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+
+// The two straight moves a diagonal squeezes between; both must be open so
+// agents never cut a wall's corner
+static constexpr int cDiagonalSides[4][2] = { { 0, 2 }, { 0, 3 }, { 1, 2 }, { 1, 3 } };
+
+bool NavGrid::build(Physics& physics, const glm::vec3& center, float halfExtent, const NavGridSettings& settings) {
+    mSettings = settings;
+    mWidth = mDepth = static_cast<uint32_t>(std::ceil(2.0f * halfExtent / settings.cellSize));
+    mOrigin = glm::vec2(center.x - halfExtent, center.z - halfExtent);
+    mProbeY = center.y + settings.probeHeight;
+
+    mHeight.assign(cellCount(), 0.0f);
+    mWalkable.assign(cellCount(), 0);
+    mLinks.assign(cellCount(), 0);
+
+    // Rows write disjoint slices, so they can be sampled in parallel
+    JobSystem& jobSystem = physics.getJobSystem();
+    JobSystem::Barrier* barrier = jobSystem.CreateBarrier();
+    for (uint32_t z = 0; z < mDepth; z++) {
+        JobHandle job = jobSystem.CreateJob("SampleNavRow", Color::sGreen, [this, &physics, z]() {
+            sampleRow(physics, z);
+        });
+        barrier->AddJob(job);
+    }
+    jobSystem.WaitForJobs(barrier);
+    jobSystem.DestroyBarrier(barrier);
+
+    linkCells();
+
+    mWalkableCount = std::count(mWalkable.begin(), mWalkable.end(), uint8_t(1));
+    std::cout << "Built nav grid " << mWidth << "x" << mDepth << " with " << mWalkableCount << " walkable cells" << std::endl;
+    return mWalkableCount > 0;
+}
+
+void NavGrid::sampleRow(Physics& physics, uint32_t z) {
+    PhysicsSystem& system = physics.getPhysicsSystem();
+    const NarrowPhaseQuery& query = system.GetNarrowPhaseQuery();
+    QueryFilter filter(QueryLayers::NAVIGATION);
+    float minNormalY = std::cos(glm::radians(mSettings.maxSlopeDegrees));
+    float probeLength = 2.0f * mSettings.probeHeight;
+
+    for (uint32_t x = 0; x < mWidth; x++) {
+        uint32_t cell = z * mWidth + x;
+        glm::vec3 center = cellCenter(cell);
+
+        RRayCast down(RVec3(center.x, mProbeY, center.z), Vec3(0.0f, -probeLength, 0.0f));
+        RayCastResult floorHit;
+        if (!query.CastRay(down, floorHit, filter.broadPhase, filter.object))
+            continue;
+
+        RVec3 floorPoint = down.GetPointOnRay(floorHit.mFraction);
+        mHeight[cell] = static_cast<float>(floorPoint.GetY());
+
+        BodyLockRead lock(system.GetBodyLockInterface(), floorHit.mBodyID);
+        if (!lock.Succeeded())
+            continue;
+        Vec3 normal = lock.GetBody().GetWorldSpaceSurfaceNormal(floorHit.mSubShapeID2, floorPoint);
+        if (normal.GetY() < minNormalY)
+            continue;
+
+        // Top surface only: something hanging lower than a player over the floor blocks the cell
+        RRayCast up(floorPoint + Vec3(0.0f, 0.05f, 0.0f), Vec3(0.0f, mSettings.agentHeight, 0.0f));
+        RayCastResult ceilingHit;
+        if (query.CastRay(up, ceilingHit, filter.broadPhase, filter.object))
+            continue;
+
+        mWalkable[cell] = 1;
+    }
+}
+
+void NavGrid::linkCells() {
+    for (uint32_t cell = 0; cell < cellCount(); cell++) {
+        if (!mWalkable[cell])
+            continue;
+
+        uint8_t links = 0;
+        for (int d = 0; d < cNumDirections; d++) {
+            uint32_t other = neighbour(cell, d);
+            if (other == cInvalidCell || !mWalkable[other])
+                continue;
+            if (std::abs(mHeight[other] - mHeight[cell]) > mSettings.maxStepHeight)
+                continue;
+            if (d >= 4) {
+                const int* sides = cDiagonalSides[d - 4];
+                if (!(links & (1 << sides[0])) || !(links & (1 << sides[1])))
+                    continue;
+            }
+            links |= 1 << d;
+        }
+        mLinks[cell] = links;
+    }
+}
+
+uint32_t NavGrid::neighbour(uint32_t cell, int direction) const {
+    int x = static_cast<int>(cell % mWidth) + cDirX[direction];
+    int z = static_cast<int>(cell / mWidth) + cDirZ[direction];
+    if (x < 0 || z < 0 || x >= static_cast<int>(mWidth) || z >= static_cast<int>(mDepth))
+        return cInvalidCell;
+    return static_cast<uint32_t>(z) * mWidth + static_cast<uint32_t>(x);
+}
+
+uint32_t NavGrid::findCell(const glm::vec3& position) const {
+    if (!isBuilt())
+        return cInvalidCell;
+
+    int cx = static_cast<int>(std::floor((position.x - mOrigin.x) / mSettings.cellSize));
+    int cz = static_cast<int>(std::floor((position.z - mOrigin.y) / mSettings.cellSize));
+
+    // Players get pushed against walls, so look a little around the exact cell
+    uint32_t best = cInvalidCell;
+    int bestDistance = INT32_MAX;
+    for (int dz = -2; dz <= 2; dz++) {
+        for (int dx = -2; dx <= 2; dx++) {
+            int x = cx + dx, z = cz + dz;
+            if (x < 0 || z < 0 || x >= static_cast<int>(mWidth) || z >= static_cast<int>(mDepth))
+                continue;
+            uint32_t cell = static_cast<uint32_t>(z) * mWidth + static_cast<uint32_t>(x);
+            int distance = dx * dx + dz * dz;
+            if (mWalkable[cell] && distance < bestDistance) {
+                best = cell;
+                bestDistance = distance;
+            }
+        }
+    }
+    return best;
+}
+
+glm::vec3 NavGrid::cellCenter(uint32_t cell) const {
+    float x = mOrigin.x + (static_cast<float>(cell % mWidth) + 0.5f) * mSettings.cellSize;
+    float z = mOrigin.y + (static_cast<float>(cell / mWidth) + 0.5f) * mSettings.cellSize;
+    return glm::vec3(x, mHeight[cell], z);
+}
+
+float NavGrid::heuristic(uint32_t from, uint32_t to) const {
+    // Octile distance, exact on an empty 8-connected grid
+    float dx = std::abs(static_cast<float>(from % mWidth) - static_cast<float>(to % mWidth));
+    float dz = std::abs(static_cast<float>(from / mWidth) - static_cast<float>(to / mWidth));
+    return mSettings.cellSize * (std::max(dx, dz) + 0.41421356f * std::min(dx, dz));
+}
+
+NavPathfinder::NavPathfinder(const NavGrid& inGrid, JobSystem& inJobSystem)
+    : mGrid(inGrid), mJobSystem(inJobSystem) {
+}
+
+NavPathfinder::~NavPathfinder() {
+    waitForRunning();
+}
+
+bool NavPathfinder::nextHop(uint32_t from, uint32_t goal, uint32_t& outNext) {
+    if (from == NavGrid::cInvalidCell || goal == NavGrid::cInvalidCell)
+        return false;
+    if (from == goal) {
+        outNext = goal;
+        return true;
+    }
+
+    uint64_t key = (uint64_t(goal) << 32) | from;
+    bool hasTree = false;
+    {
+        std::shared_lock lock(mTreeMutex);
+        auto tree = mTrees.find(goal);
+        hasTree = tree != mTrees.end();
+        if (hasTree) {
+            tree->second.lastUsed = mUpdate;  // only ever touched on this thread
+            auto hop = tree->second.hops.find(from);
+            if (hop != tree->second.hops.end()) {
+                outNext = hop->second.next;
+                return true;
+            }
+            if (tree->second.unreachableFrom.count(from) != 0)
+                return false;
+        }
+        if (mPending.count(key) != 0)
+            return false;
+    }
+
+    if (!hasTree) {
+        // Trees are created here rather than by the searches so lastUsed stays main-thread only
+        std::unique_lock lock(mTreeMutex);
+        mTrees[goal].lastUsed = mUpdate;
+    }
+    mPending.insert(key);
+    mQueued.emplace_back(from, goal);
+    return false;
+}
+
+void NavPathfinder::update(bool synchronous) {
+    mUpdate++;
+
+    // Retire finished searches
+    for (size_t i = mRunning.size(); i-- > 0;) {
+        if (mRunning[i].job.IsDone()) {
+            mPending.erase((uint64_t(mRunning[i].goal) << 32) | mRunning[i].start);
+            mRunning[i] = mRunning.back();
+            mRunning.pop_back();
+        }
+    }
+
+    if (synchronous) {
+        // Inline and in request order, so the trees come out identical every run
+        for (const auto& [start, goal] : mQueued) {
+            runSearch(start, goal);
+            mPending.erase((uint64_t(goal) << 32) | start);
+        }
+        mQueued.clear();
+    }
+    else {
+        size_t launch = std::min(mQueued.size(), cMaxSearchesInFlight - std::min(mRunning.size(), cMaxSearchesInFlight));
+        for (size_t i = 0; i < launch; i++) {
+            auto [start, goal] = mQueued[i];
+            JobHandle job = mJobSystem.CreateJob("FindPath", Color::sYellow, [this, start, goal]() {
+                runSearch(start, goal);
+            });
+            mRunning.push_back({ start, goal, job });
+        }
+        mQueued.erase(mQueued.begin(), mQueued.begin() + launch);
+    }
+
+    // Evict goals nobody has asked about in a while
+    {
+        std::unique_lock lock(mTreeMutex);
+        for (auto it = mTrees.begin(); it != mTrees.end();) {
+            if (mUpdate - it->second.lastUsed > mMaxIdleUpdates)
+                it = mTrees.erase(it);
+            else
+                ++it;
+        }
+    }
+}
+
+void NavPathfinder::waitForRunning() {
+    for (Search& search : mRunning) {
+        while (!search.job.IsDone())
+            std::this_thread::yield();
+    }
+    mRunning.clear();
+}
+
+size_t NavPathfinder::cachedGoalCount() const {
+    std::shared_lock lock(mTreeMutex);
+    return mTrees.size();
+}
+
+void NavPathfinder::runSearch(uint32_t start, uint32_t goal) {
+    // Per-thread scratch, reset by bumping a generation instead of clearing
+    struct Scratch {
+        std::vector<float> cost;
+        std::vector<uint32_t> parent;
+        std::vector<uint32_t> generation;
+        uint32_t current = 0;
+    };
+    thread_local Scratch scratch;
+    if (scratch.cost.size() != mGrid.cellCount()) {
+        scratch.cost.assign(mGrid.cellCount(), 0.0f);
+        scratch.parent.assign(mGrid.cellCount(), NavGrid::cInvalidCell);
+        scratch.generation.assign(mGrid.cellCount(), 0);
+        scratch.current = 0;
+    }
+    uint32_t generation = ++scratch.current;
+
+    using OpenEntry = std::pair<float, uint32_t>;
+    std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry>> open;
+
+    scratch.cost[start] = 0.0f;
+    scratch.parent[start] = NavGrid::cInvalidCell;
+    scratch.generation[start] = generation;
+    open.emplace(mGrid.heuristic(start, goal), start);
+
+    // The tree lock is only taken for each lookup, never across the search, so
+    // the main thread's evictions and new goals don't wait for searches in flight
+    auto knownHop = [this, goal](uint32_t cell, float& outCostToGoal) {
+        std::shared_lock lock(mTreeMutex);
+        auto tree = mTrees.find(goal);
+        if (tree == mTrees.end())
+            return false;
+        auto hop = tree->second.hops.find(cell);
+        if (hop == tree->second.hops.end())
+            return false;
+        outCostToGoal = hop->second.costToGoal;
+        return true;
+    };
+
+    uint32_t reached = NavGrid::cInvalidCell;
+    float tailCost = 0.0f;
+    while (!open.empty()) {
+        auto [priority, cell] = open.top();
+        open.pop();
+        float cost = scratch.cost[cell];
+        if (priority > cost + mGrid.heuristic(cell, goal) + 1e-4f)
+            continue;  // stale entry, a cheaper one was already expanded
+
+        if (cell == goal) {
+            reached = cell;
+            break;
+        }
+        if (knownHop(cell, tailCost)) {
+            // Joined a route another bot already paid for
+            reached = cell;
+            break;
+        }
+
+        uint8_t links = mGrid.links(cell);
+        for (int d = 0; d < NavGrid::cNumDirections; d++) {
+            if (!(links & (1 << d)))
+                continue;
+            uint32_t next = mGrid.neighbour(cell, d);
+            float nextCost = cost + mGrid.stepCost(d);
+            if (scratch.generation[next] == generation && scratch.cost[next] <= nextCost)
+                continue;
+            scratch.generation[next] = generation;
+            scratch.cost[next] = nextCost;
+            scratch.parent[next] = cell;
+            open.emplace(nextCost + mGrid.heuristic(next, goal), next);
+        }
+    }
+
+    std::unique_lock lock(mTreeMutex);
+    auto treeIt = mTrees.find(goal);
+    if (treeIt == mTrees.end())
+        return;  // evicted while searching; nobody wants this goal any more
+    GoalTree& tree = treeIt->second;
+    if (reached == NavGrid::cInvalidCell) {
+        tree.unreachableFrom.insert(start);
+        return;
+    }
+
+    // Walk back from where the search ended, pointing each cell at its successor.
+    // An existing hop wins, so concurrent searches never rewire a route in use.
+    float reachedCost = scratch.cost[reached];
+    for (uint32_t child = reached, cell = scratch.parent[reached]; cell != NavGrid::cInvalidCell; child = cell, cell = scratch.parent[cell]) {
+        tree.hops.emplace(cell, Hop{ child, tailCost + reachedCost - scratch.cost[cell] });
+    }
+}
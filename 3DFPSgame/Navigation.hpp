@@ -0,0 +1,126 @@
+#pragma once
+
+#include "Physics.hpp"
+
+#include <glm/glm.hpp>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct NavGridSettings {
+    float cellSize = 0.5f;        // meters per cell edge
+    float agentHeight = 1.8f;     // free space needed above the floor
+    float maxStepHeight = 0.4f;   // largest height change between neighbouring cells
+    float maxSlopeDegrees = 45.0f;
+    float probeHeight = 100.0f;   // rays start this far above the region's center
+};
+
+// Walkable surface of the level as a 2.5D height grid. Built once by raycasting
+// down onto static collision, one job per row, so it always matches what bots
+// will actually stand on. Cells are indexed z * width + x.
+class NavGrid {
+public:
+    static constexpr uint32_t cInvalidCell = ~0u;
+
+    // Samples the square region of the given half extent around center
+    bool build(Physics& physics, const glm::vec3& center, float halfExtent, const NavGridSettings& settings = NavGridSettings());
+
+    bool isBuilt() const { return mWidth > 0; }
+    uint32_t width() const { return mWidth; }
+    uint32_t depth() const { return mDepth; }
+    uint32_t cellCount() const { return mWidth * mDepth; }
+    size_t walkableCount() const { return mWalkableCount; }
+
+    // Nearest walkable cell to the position within a couple of cells, or cInvalidCell
+    uint32_t findCell(const glm::vec3& position) const;
+    glm::vec3 cellCenter(uint32_t cell) const;
+
+    bool isWalkable(uint32_t cell) const { return mWalkable[cell] != 0; }
+    // Bit d set when neighbour d (see neighbour()) can be walked to
+    uint8_t links(uint32_t cell) const { return mLinks[cell]; }
+    uint32_t neighbour(uint32_t cell, int direction) const;
+    float stepCost(int direction) const { return direction < 4 ? mSettings.cellSize : mSettings.cellSize * 1.41421356f; }
+    float heuristic(uint32_t from, uint32_t to) const;
+
+    static constexpr int cNumDirections = 8;
+
+private:
+    void sampleRow(Physics& physics, uint32_t z);
+    void linkCells();
+
+    NavGridSettings mSettings;
+    glm::vec2 mOrigin = glm::vec2(0.0f);  // world XZ of cell (0, 0)'s corner
+    float mProbeY = 0.0f;
+    uint32_t mWidth = 0;
+    uint32_t mDepth = 0;
+    size_t mWalkableCount = 0;
+
+    std::vector<float> mHeight;
+    std::vector<uint8_t> mWalkable;
+    std::vector<uint8_t> mLinks;
+};
+
+// Asynchronous A* over a NavGrid. Every finished search is folded into a per-goal
+// tree of "next hop towards this goal" entries, and later searches stop as soon
+// as they touch that tree, so bots heading to the same place share the work:
+// after the first one, most searches are a few steps long or skipped entirely.
+//
+// Searches run on the physics job system. Trees are read by bots on the main
+// thread and by searches on workers, so they sit behind a shared mutex that is
+// only held exclusively while a search merges its result.
+class NavPathfinder {
+public:
+    NavPathfinder(const NavGrid& inGrid, JPH::JobSystem& inJobSystem);
+    ~NavPathfinder();
+
+    // Next cell to walk to from 'from' towards 'goal'. Returns false when no route
+    // is known yet; a search is then queued (once per goal and start cell).
+    bool nextHop(uint32_t from, uint32_t goal, uint32_t& outNext);
+
+    // Starts queued searches and retires finished ones. With 'synchronous' it waits
+    // for them too, so results land on the same tick every run.
+    void update(bool synchronous);
+
+    // Goal trees not used for this many updates are dropped
+    void setMaxIdleUpdates(uint32_t updates) { mMaxIdleUpdates = updates; }
+
+    size_t cachedGoalCount() const;
+    size_t pendingSearchCount() const { return mQueued.size() + mRunning.size(); }
+
+    static constexpr size_t cMaxSearchesInFlight = 32;
+
+private:
+    struct Hop {
+        uint32_t next;
+        float costToGoal;
+    };
+
+    struct GoalTree {
+        std::unordered_map<uint32_t, Hop> hops;
+        uint32_t lastUsed = 0;
+        std::unordered_set<uint32_t> unreachableFrom;  // starts a full search gave up on
+    };
+
+    struct Search {
+        uint32_t start;
+        uint32_t goal;
+        JPH::JobHandle job;
+    };
+
+    void runSearch(uint32_t start, uint32_t goal);
+    void waitForRunning();
+
+    const NavGrid& mGrid;
+    JPH::JobSystem& mJobSystem;
+
+    mutable std::shared_mutex mTreeMutex;
+    std::unordered_map<uint32_t, GoalTree> mTrees;  // goal cell -> tree
+
+    std::vector<std::pair<uint32_t, uint32_t>> mQueued;  // (start, goal)
+    std::vector<Search> mRunning;
+    std::unordered_set<uint64_t> mPending;               // goal << 32 | start, queued or running
+    uint32_t mUpdate = 0;
+    uint32_t mMaxIdleUpdates = 600;
+};
@@ -0,0 +1,303 @@
+#include "NetSocket.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using SocketHandle = SOCKET;
+using SocketLength = int;
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using SocketHandle = int;
+using SocketLength = socklen_t;
+#endif
+
+namespace {
+
+#ifdef _WIN32
+struct WinsockStartup {
+    WinsockStartup() {
+        WSADATA data;
+        WSAStartup(MAKEWORD(2, 2), &data);
+    }
+    ~WinsockStartup() { WSACleanup(); }
+};
+#endif
+
+void closeHandle(intptr_t handle) {
+#ifdef _WIN32
+    closesocket((SocketHandle)handle);
+#else
+    ::close((SocketHandle)handle);
+#endif
+}
+
+// Winsock must be started once before the first socket
+void startSockets() {
+#ifdef _WIN32
+    static WinsockStartup startup;
+#endif
+}
+
+bool isValid(SocketHandle handle) {
+#ifdef _WIN32
+    return handle != INVALID_SOCKET;
+#else
+    return handle >= 0;
+#endif
+}
+
+// True once handle is readable, or for a listener has a connection waiting
+bool waitReadable(intptr_t handle, int timeoutMs) {
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET((SocketHandle)handle, &readable);
+    timeval timeout = { timeoutMs / 1000, (timeoutMs % 1000) * 1000 };
+    return select((int)handle + 1, &readable, nullptr, nullptr, &timeout) > 0;
+}
+
+sockaddr_in toSockaddr(const NetAddress& address) {
+    sockaddr_in out = {};
+    out.sin_family = AF_INET;
+    out.sin_addr.s_addr = htonl(address.ip);
+    out.sin_port = htons(address.port);
+    return out;
+}
+
+}
+
+UdpSocket::~UdpSocket() {
+    close();
+}
+
+UdpSocket::UdpSocket(UdpSocket&& other) noexcept
+    : mHandle(std::exchange(other.mHandle, cInvalidHandle)), mPort(std::exchange(other.mPort, 0)) {
+}
+
+UdpSocket& UdpSocket::operator=(UdpSocket&& other) noexcept {
+    if (this != &other) {
+        close();
+        mHandle = std::exchange(other.mHandle, cInvalidHandle);
+        mPort = std::exchange(other.mPort, 0);
+    }
+    return *this;
+}
+
+bool UdpSocket::open(uint16_t port, bool loopbackOnly) {
+    startSockets();
+    close();
+
+    SocketHandle handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (!isValid(handle)) {
+        std::cout << "Failed to create a UDP socket" << std::endl;
+        return false;
+    }
+
+    sockaddr_in address = toSockaddr({ loopbackOnly ? 0x7F000001u : 0u, port });
+    if (bind(handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cout << "Failed to bind UDP port " << port << std::endl;
+        closeHandle((intptr_t)handle);
+        return false;
+    }
+
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket(handle, FIONBIO, &nonBlocking);
+#else
+    fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+    SocketLength length = sizeof(address);
+    getsockname(handle, reinterpret_cast<sockaddr*>(&address), &length);
+    mHandle = (intptr_t)handle;
+    mPort = ntohs(address.sin_port);
+    return true;
+}
+
+void UdpSocket::close() {
+    if (mHandle == cInvalidHandle)
+        return;
+    closeHandle(mHandle);
+    mHandle = cInvalidHandle;
+    mPort = 0;
+}
+
+bool UdpSocket::send(const NetAddress& to, const void* data, size_t size) {
+    if (mHandle == cInvalidHandle)
+        return false;
+    sockaddr_in address = toSockaddr(to);
+    return sendto((SocketHandle)mHandle, static_cast<const char*>(data), (int)size, 0,
+        reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == (int)size;
+}
+
+int UdpSocket::receive(NetAddress& outFrom, void* buffer, size_t capacity) {
+    if (mHandle == cInvalidHandle)
+        return -1;
+    sockaddr_in address = {};
+    SocketLength length = sizeof(address);
+    int received = (int)recvfrom((SocketHandle)mHandle, static_cast<char*>(buffer), (int)capacity, 0,
+        reinterpret_cast<sockaddr*>(&address), &length);
+    if (received < 0)
+        return -1;
+    outFrom.ip = ntohl(address.sin_addr.s_addr);
+    outFrom.port = ntohs(address.sin_port);
+    return received;
+}
+
+TcpStream::~TcpStream() {
+    close();
+}
+
+TcpStream::TcpStream(TcpStream&& other) noexcept
+    : mHandle(std::exchange(other.mHandle, cInvalidHandle)) {
+}
+
+TcpStream& TcpStream::operator=(TcpStream&& other) noexcept {
+    if (this != &other) {
+        close();
+        mHandle = std::exchange(other.mHandle, cInvalidHandle);
+    }
+    return *this;
+}
+
+void TcpStream::close() {
+    if (mHandle == cInvalidHandle)
+        return;
+    closeHandle(mHandle);
+    mHandle = cInvalidHandle;
+}
+
+bool TcpStream::sendAll(const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (mHandle != cInvalidHandle && size > 0) {
+#ifdef MSG_NOSIGNAL
+        int sent = (int)::send((SocketHandle)mHandle, bytes, (int)size, MSG_NOSIGNAL);
+#else
+        int sent = (int)::send((SocketHandle)mHandle, bytes, (int)size, 0);
+#endif
+        if (sent <= 0)
+            return false;
+        bytes += sent;
+        size -= sent;
+    }
+    return size == 0;
+}
+
+int TcpStream::receive(void* buffer, size_t capacity, int timeoutMs) {
+    if (mHandle == cInvalidHandle || !waitReadable(mHandle, timeoutMs))
+        return -1;
+    int received = (int)recv((SocketHandle)mHandle, static_cast<char*>(buffer), (int)capacity, 0);
+    return received < 0 ? -1 : received;
+}
+
+TcpListener::~TcpListener() {
+    close();
+}
+
+bool TcpListener::open(uint16_t port, bool loopbackOnly) {
+    startSockets();
+    close();
+
+    SocketHandle handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (!isValid(handle)) {
+        std::cout << "Failed to create a TCP socket" << std::endl;
+        return false;
+    }
+
+    // Lets a restarted process take the port straight back from TIME_WAIT
+    int reuse = 1;
+    setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+    sockaddr_in address = toSockaddr({ loopbackOnly ? 0x7F000001u : 0u, port });
+    if (bind(handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(handle, 8) != 0) {
+        std::cout << "Failed to listen on TCP port " << port << std::endl;
+        closeHandle((intptr_t)handle);
+        return false;
+    }
+
+    SocketLength length = sizeof(address);
+    getsockname(handle, reinterpret_cast<sockaddr*>(&address), &length);
+    mHandle = (intptr_t)handle;
+    mPort = ntohs(address.sin_port);
+    return true;
+}
+
+void TcpListener::close() {
+    if (mHandle == cInvalidHandle)
+        return;
+    closeHandle(mHandle);
+    mHandle = cInvalidHandle;
+    mPort = 0;
+}
+
+bool TcpListener::accept(TcpStream& outStream, int timeoutMs) {
+    if (mHandle == cInvalidHandle || !waitReadable(mHandle, timeoutMs))
+        return false;
+    SocketHandle handle = ::accept((SocketHandle)mHandle, nullptr, nullptr);
+    if (!isValid(handle))
+        return false;
+    outStream.close();
+    outStream.mHandle = (intptr_t)handle;
+    return true;
+}
+
+LinkConditioner::LinkConditioner(const LinkSettings& inSettings, uint32_t seed)
+    : mSettings(inSettings), mRandomState(seed ? seed : 1) {
+}
+
+float LinkConditioner::nextUnit() {
+    mRandomState ^= mRandomState << 13;
+    mRandomState ^= mRandomState >> 17;
+    mRandomState ^= mRandomState << 5;
+    return (mRandomState >> 8) * (1.0f / 16777216.0f);
+}
+
+bool LinkConditioner::releasesLater(const DelayedPacket& a, const DelayedPacket& b) {
+    return a.releaseTime != b.releaseTime ? a.releaseTime > b.releaseTime : a.order > b.order;
+}
+
+void LinkConditioner::send(UdpSocket& socket, const NetAddress& to, const void* data, size_t size, double now) {
+    if (nextUnit() * 100.0f < mSettings.lossPercent) {
+        mDropped++;
+        return;
+    }
+
+    double delay = (mSettings.latencyMs + nextUnit() * mSettings.jitterMs) * 0.001;
+    double release = now + delay;
+    if (nextUnit() * 100.0f < mSettings.reorderPercent) {
+        // Late enough that whatever is sent in the next few milliseconds gets there first
+        release += (mSettings.jitterMs + 5.0f) * 0.001;
+        mReordered++;
+    }
+    else {
+        release = std::max(release, mLastRelease);
+        mLastRelease = release;
+    }
+
+    if (release <= now) {
+        socket.send(to, data, size);
+        return;
+    }
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    mQueue.push_back({ release, mSent++, &socket, to, std::vector<uint8_t>(bytes, bytes + size) });
+    std::push_heap(mQueue.begin(), mQueue.end(), releasesLater);
+}
+
+void LinkConditioner::flush(double now) {
+    while (!mQueue.empty() && mQueue.front().releaseTime <= now) {
+        std::pop_heap(mQueue.begin(), mQueue.end(), releasesLater);
+        DelayedPacket& packet = mQueue.back();
+        packet.socket->send(packet.to, packet.data.data(), packet.data.size());
+        mQueue.pop_back();
+    }
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// IPv4 address and port, both in host byte order
+struct NetAddress {
+    uint32_t ip = 0;
+    uint16_t port = 0;
+
+    static NetAddress loopback(uint16_t port) { return { 0x7F000001u, port }; }
+    bool operator==(const NetAddress& other) const { return ip == other.ip && port == other.port; }
+};
+
+// Non-blocking UDP socket over BSD sockets or Winsock
+class UdpSocket {
+public:
+    UdpSocket() = default;
+    ~UdpSocket();
+    UdpSocket(UdpSocket&& other) noexcept;
+    UdpSocket& operator=(UdpSocket&& other) noexcept;
+    UdpSocket(const UdpSocket&) = delete;
+    UdpSocket& operator=(const UdpSocket&) = delete;
+
+    // Port 0 picks any free port; see localPort()
+    bool open(uint16_t port = 0, bool loopbackOnly = true);
+    void close();
+    bool isOpen() const { return mHandle != cInvalidHandle; }
+    uint16_t localPort() const { return mPort; }
+
+    bool send(const NetAddress& to, const void* data, size_t size);
+
+    // Bytes received, or -1 if nothing is waiting
+    int receive(NetAddress& outFrom, void* buffer, size_t capacity);
+
+private:
+    static constexpr intptr_t cInvalidHandle = -1;
+    intptr_t mHandle = cInvalidHandle;
+    uint16_t mPort = 0;
+};
+
+// Connected TCP stream, blocking apart from the timeouts on receive
+class TcpStream {
+public:
+    TcpStream() = default;
+    ~TcpStream();
+    TcpStream(TcpStream&& other) noexcept;
+    TcpStream& operator=(TcpStream&& other) noexcept;
+    TcpStream(const TcpStream&) = delete;
+    TcpStream& operator=(const TcpStream&) = delete;
+
+    void close();
+    bool isOpen() const { return mHandle != cInvalidHandle; }
+
+    bool sendAll(const void* data, size_t size);
+
+    // Bytes received, 0 once the peer has closed, or -1 on timeout or error
+    int receive(void* buffer, size_t capacity, int timeoutMs);
+
+private:
+    friend class TcpListener;
+
+    static constexpr intptr_t cInvalidHandle = -1;
+    intptr_t mHandle = cInvalidHandle;
+};
+
+class TcpListener {
+public:
+    TcpListener() = default;
+    ~TcpListener();
+    TcpListener(const TcpListener&) = delete;
+    TcpListener& operator=(const TcpListener&) = delete;
+
+    bool open(uint16_t port, bool loopbackOnly = true);
+    void close();
+    bool isOpen() const { return mHandle != cInvalidHandle; }
+    uint16_t localPort() const { return mPort; }
+
+    // Waits up to timeoutMs for a connection; false if none arrived
+    bool accept(TcpStream& outStream, int timeoutMs);
+
+private:
+    static constexpr intptr_t cInvalidHandle = -1;
+    intptr_t mHandle = cInvalidHandle;
+    uint16_t mPort = 0;
+};
+
+// Network conditions applied on the sending side of one link
+struct LinkSettings {
+    float latencyMs = 0.0f;      // one way
+    float jitterMs = 0.0f;       // extra uniform delay on top of latency
+    float lossPercent = 0.0f;
+    float reorderPercent = 0.0f; // packets held back long enough for later ones to overtake
+};
+
+// Holds outgoing packets until their simulated arrival time. Apart from the
+// reordered ones a link stays first-in first-out, as real routes mostly do,
+// so jitter alone only bunches packets up.
+class LinkConditioner {
+public:
+    explicit LinkConditioner(const LinkSettings& inSettings = LinkSettings(), uint32_t seed = 1);
+
+    void send(UdpSocket& socket, const NetAddress& to, const void* data, size_t size, double now);
+
+    // Hands every packet that is due to its socket
+    void flush(double now);
+
+    uint64_t dropped() const { return mDropped; }
+    uint64_t reordered() const { return mReordered; }
+
+private:
+    struct DelayedPacket {
+        double releaseTime;
+        uint64_t order;  // keeps packets released together in the order they were sent
+        UdpSocket* socket;
+        NetAddress to;
+        std::vector<uint8_t> data;
+    };
+
+    float nextUnit();
+    static bool releasesLater(const DelayedPacket& a, const DelayedPacket& b);
+
+    LinkSettings mSettings;
+    uint32_t mRandomState;
+    double mLastRelease = 0.0;
+    std::vector<DelayedPacket> mQueue;  // min-heap on releaseTime, then order
+    uint64_t mSent = 0;
+    uint64_t mDropped = 0;
+    uint64_t mReordered = 0;
+};
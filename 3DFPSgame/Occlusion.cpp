@@ -0,0 +1,280 @@
+#include "Occlusion.hpp"
+#include "Renderer.hpp"
+#include "Model.hpp"
+#include "Lod.hpp"
+
+#include <Jolt/Math/Vec4.h>
+#include <Jolt/Math/UVec4.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace JPH;
+
+OcclusionCuller::OcclusionCuller(JobSystem& inJobSystem, const OcclusionSettings& inSettings)
+    : mJobSystem(inJobSystem), mSettings(inSettings), mStride((inSettings.width + 3) & ~3), mViewProjection(1.0f) {
+}
+
+OcclusionStats OcclusionCuller::cull(RenderPacket& packet) {
+    OcclusionStats stats;
+    mViewProjection = packet.projection * packet.view;
+    mDepth.assign((size_t)mStride * mSettings.height, 0.0f);
+    mTriangles.clear();
+
+    gatherOccluders(packet, stats);
+    stats.occluderTriangles = (uint32_t)mTriangles.size();
+
+    // Bands own disjoint rows of the buffer, so they rasterize without locking
+    if (!mTriangles.empty()) {
+        JobSystem::Barrier* barrier = mJobSystem.CreateBarrier();
+        for (int row = 0; row < mSettings.height; row += mSettings.bandHeight) {
+            int lastRow = std::min(row + mSettings.bandHeight, mSettings.height) - 1;
+            JobHandle job = mJobSystem.CreateJob("RasterizeOccluders", Color::sOrange, [this, row, lastRow]() {
+                rasterizeBand(row, lastRow);
+            });
+            barrier->AddJob(job);
+        }
+        mJobSystem.WaitForJobs(barrier);
+        mJobSystem.DestroyBarrier(barrier);
+    }
+
+    size_t kept = 0;
+    for (uint32_t index : packet.cameraDraws) {
+        int result = classify(packet.draws[index].bounds);
+        if (result == 0)
+            stats.frustumCulled++;
+        else if (result == 1)
+            stats.occluded++;
+        else
+            packet.cameraDraws[kept++] = index;
+    }
+    packet.cameraDraws.resize(kept);
+    return stats;
+}
+
+void OcclusionCuller::gatherOccluders(const RenderPacket& packet, OcclusionStats& stats) {
+    glm::vec3 cameraPosition = glm::vec3(glm::inverse(packet.view)[3]);
+    float projectionScale = packet.projection[1][1];
+
+    mCandidates.clear();
+    for (uint32_t index : packet.cameraDraws) {
+        // The bind pose says little about where an animated mesh's triangles are
+        if (packet.draws[index].isSkinned())
+            continue;
+        float size = screenSize(packet.draws[index].bounds, cameraPosition, projectionScale);
+        if (size >= mSettings.minOccluderScreenSize)
+            mCandidates.emplace_back(size, index);
+    }
+
+    if ((int)mCandidates.size() > mSettings.maxOccluders) {
+        auto end = mCandidates.begin() + mSettings.maxOccluders;
+        std::nth_element(mCandidates.begin(), end, mCandidates.end(),
+            [](const auto& a, const auto& b) { return a.first > b.first; });
+        mCandidates.erase(end, mCandidates.end());
+    }
+
+    for (const auto& [size, index] : mCandidates)
+        addOccluder(packet.draws[index]);
+    stats.occluders = (uint32_t)mCandidates.size();
+}
+
+void OcclusionCuller::addOccluder(const DrawItem& draw) {
+    glm::mat4 modelViewProjection = mViewProjection * draw.modelMatrix;
+
+    for (const Mesh& mesh : draw.model->meshes) {
+        // The finest level that fits the budget; the full mesh if it already does
+        const std::vector<Vertex>* vertices = &mesh.vertices;
+        const std::vector<unsigned int>* indices = &mesh.indices;
+        for (size_t level = 0; indices->size() / 3 > mSettings.maxOccluderTriangles; level++) {
+            if (level == mesh.lods.size()) {
+                indices = nullptr;
+                break;
+            }
+            vertices = &mesh.lods[level].vertices;
+            indices = &mesh.lods[level].indices;
+        }
+        if (!indices)
+            continue;
+
+        for (size_t i = 0; i + 2 < indices->size(); i += 3) {
+            addTriangle(modelViewProjection * glm::vec4((*vertices)[(*indices)[i]].position, 1.0f),
+                modelViewProjection * glm::vec4((*vertices)[(*indices)[i + 1]].position, 1.0f),
+                modelViewProjection * glm::vec4((*vertices)[(*indices)[i + 2]].position, 1.0f));
+        }
+    }
+}
+
+void OcclusionCuller::addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+    // Entirely outside one side of the frustum
+    if ((a.x < -a.w && b.x < -b.w && c.x < -c.w) || (a.x > a.w && b.x > b.w && c.x > c.w)
+        || (a.y < -a.w && b.y < -b.w && c.y < -c.w) || (a.y > a.w && b.y > b.w && c.y > c.w)
+        || (a.z < -a.w && b.z < -b.w && c.z < -c.w))
+        return;
+
+    // Clip against the near plane (z >= -w), which leaves at most a quad
+    glm::vec4 polygon[4];
+    int count = 0;
+    const glm::vec4* input[3] = { &a, &b, &c };
+    for (int i = 0; i < 3; i++) {
+        const glm::vec4& current = *input[i];
+        const glm::vec4& next = *input[(i + 1) % 3];
+        float currentDistance = current.z + current.w;
+        float nextDistance = next.z + next.w;
+        if (currentDistance >= 0.0f)
+            polygon[count++] = current;
+        if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+            polygon[count++] = glm::mix(current, next, currentDistance / (currentDistance - nextDistance));
+    }
+
+    float width = (float)mSettings.width, height = (float)mSettings.height;
+    for (int fan = 1; fan + 1 < count; fan++) {
+        const glm::vec4* corners[3] = { &polygon[0], &polygon[fan], &polygon[fan + 1] };
+        ScreenTriangle triangle;
+        float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX;
+        for (int i = 0; i < 3; i++) {
+            float invW = 1.0f / corners[i]->w;
+            triangle.x[i] = (corners[i]->x * invW * 0.5f + 0.5f) * width;
+            triangle.y[i] = (corners[i]->y * invW * 0.5f + 0.5f) * height;
+            triangle.invW[i] = invW;
+            minX = std::min(minX, triangle.x[i]);
+            maxX = std::max(maxX, triangle.x[i]);
+            minY = std::min(minY, triangle.y[i]);
+            maxY = std::max(maxY, triangle.y[i]);
+        }
+        if (maxX < 0.0f || minX >= width || maxY < 0.0f || minY >= height)
+            continue;
+
+        triangle.minY = std::max(0, (int)std::floor(minY));
+        triangle.maxY = std::min(mSettings.height - 1, (int)std::ceil(maxY));
+        mTriangles.push_back(triangle);
+    }
+}
+
+void OcclusionCuller::rasterizeBand(int firstRow, int lastRow) {
+    for (const ScreenTriangle& triangle : mTriangles) {
+        if (triangle.maxY >= firstRow && triangle.minY <= lastRow)
+            rasterizeTriangle(triangle, firstRow, lastRow);
+    }
+}
+
+void OcclusionCuller::rasterizeTriangle(const ScreenTriangle& triangle, int firstRow, int lastRow) {
+    float x0 = triangle.x[0], y0 = triangle.y[0];
+    float x1 = triangle.x[1], y1 = triangle.y[1];
+    float x2 = triangle.x[2], y2 = triangle.y[2];
+    float w0 = triangle.invW[0], w1 = triangle.invW[1], w2 = triangle.invW[2];
+
+    // Occluders aren't backface culled, their winding isn't reliable, so flip
+    // clockwise triangles instead of dropping them
+    float area = (x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0);
+    if (std::abs(area) < 1e-6f)
+        return;
+    if (area < 0.0f) {
+        std::swap(x1, x2);
+        std::swap(y1, y2);
+        std::swap(w1, w2);
+        area = -area;
+    }
+
+    // Edge functions e(x, y) = a*x + b*y + c, positive inside. Edge i is
+    // opposite vertex i, so e_i / area is that vertex's barycentric weight.
+    float a0 = y1 - y2, b0 = x2 - x1, c0 = x1 * y2 - x2 * y1;
+    float a1 = y2 - y0, b1 = x0 - x2, c1 = x2 * y0 - x0 * y2;
+    float a2 = y0 - y1, b2 = x1 - x0, c2 = x0 * y1 - x1 * y0;
+
+    // 1/w is linear in screen space, so it is a plane too
+    float invArea = 1.0f / area;
+    float depthA = (a0 * w0 + a1 * w1 + a2 * w2) * invArea;
+    float depthB = (b0 * w0 + b1 * w1 + b2 * w2) * invArea;
+    float depthC = (c0 * w0 + c1 * w1 + c2 * w2) * invArea;
+
+    int minX = std::max(0, (int)std::floor(std::min(x0, std::min(x1, x2)))) & ~3;
+    int maxX = std::min(mSettings.width - 1, (int)std::ceil(std::max(x0, std::max(x1, x2))));
+    int rowStart = std::max(firstRow, triangle.minY);
+    int rowEnd = std::min(lastRow, triangle.maxY);
+
+    const Vec4 laneOffsets(0.5f, 1.5f, 2.5f, 3.5f);
+    const Vec4 edgeA0 = Vec4::sReplicate(a0), edgeA1 = Vec4::sReplicate(a1), edgeA2 = Vec4::sReplicate(a2);
+    const Vec4 planeA = Vec4::sReplicate(depthA);
+    const Vec4 zero = Vec4::sZero();
+
+    for (int y = rowStart; y <= rowEnd; y++) {
+        float pixelY = (float)y + 0.5f;
+        Vec4 rowE0 = Vec4::sReplicate(b0 * pixelY + c0);
+        Vec4 rowE1 = Vec4::sReplicate(b1 * pixelY + c1);
+        Vec4 rowE2 = Vec4::sReplicate(b2 * pixelY + c2);
+        Vec4 rowDepth = Vec4::sReplicate(depthB * pixelY + depthC);
+        float* row = &mDepth[(size_t)y * mStride];
+
+        for (int x = minX; x <= maxX; x += 4) {
+            Vec4 pixelX = Vec4::sReplicate((float)x) + laneOffsets;
+            UVec4 inside = UVec4::sAnd(UVec4::sAnd(
+                Vec4::sGreaterOrEqual(edgeA0 * pixelX + rowE0, zero),
+                Vec4::sGreaterOrEqual(edgeA1 * pixelX + rowE1, zero)),
+                Vec4::sGreaterOrEqual(edgeA2 * pixelX + rowE2, zero));
+            if (!inside.TestAnyTrue())
+                continue;
+
+            Float4* cell = reinterpret_cast<Float4*>(row + x);
+            Vec4 current = Vec4::sLoadFloat4(cell);
+            Vec4 depth = planeA * pixelX + rowDepth;
+            Vec4::sSelect(current, Vec4::sMax(current, depth), inside).StoreFloat4(cell);
+        }
+    }
+}
+
+int OcclusionCuller::classify(const Bounds& bounds) const {
+    float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX;
+    float nearestInvW = 0.0f;
+    bool crossesNearPlane = false;
+    int outsideAll = 0x3F;
+
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner((i & 1) ? bounds.max.x : bounds.min.x, (i & 2) ? bounds.max.y : bounds.min.y,
+            (i & 4) ? bounds.max.z : bounds.min.z);
+        glm::vec4 clip = mViewProjection * glm::vec4(corner, 1.0f);
+
+        int outside = (clip.x < -clip.w) | (clip.x > clip.w) << 1 | (clip.y < -clip.w) << 2
+            | (clip.y > clip.w) << 3 | (clip.z < -clip.w) << 4 | (clip.z > clip.w) << 5;
+        outsideAll &= outside;
+
+        if (clip.z < -clip.w || clip.w <= 1e-4f) {
+            crossesNearPlane = true;
+            continue;
+        }
+        float invW = 1.0f / clip.w;
+        float screenX = (clip.x * invW * 0.5f + 0.5f) * (float)mSettings.width;
+        float screenY = (clip.y * invW * 0.5f + 0.5f) * (float)mSettings.height;
+        minX = std::min(minX, screenX);
+        maxX = std::max(maxX, screenX);
+        minY = std::min(minY, screenY);
+        maxY = std::max(maxY, screenY);
+        nearestInvW = std::max(nearestInvW, invW);
+    }
+
+    if (outsideAll != 0)
+        return 0;
+    if (crossesNearPlane)
+        return 2;
+
+    // Every pixel the box touches, so partly covered edge pixels count too
+    int x0 = std::max(0, (int)std::floor(minX)) & ~3;
+    int x1 = std::min(mSettings.width - 1, (int)std::floor(maxX));
+    int y0 = std::max(0, (int)std::floor(minY));
+    int y1 = std::min(mSettings.height - 1, (int)std::floor(maxY));
+    if (x0 > x1 || y0 > y1)
+        return 0;
+
+    // Lanes left of x0 or right of x1 can only make the box look more visible,
+    // so they aren't masked off
+    Vec4 boxDepth = Vec4::sReplicate(nearestInvW);
+    for (int y = y0; y <= y1; y++) {
+        const float* row = &mDepth[(size_t)y * mStride];
+        for (int x = x0; x <= x1; x += 4) {
+            Vec4 occluderDepth = Vec4::sLoadFloat4(reinterpret_cast<const Float4*>(row + x));
+            if (Vec4::sLess(occluderDepth, boxDepth).TestAnyTrue())
+                return 2;
+        }
+    }
+    return 1;
+}
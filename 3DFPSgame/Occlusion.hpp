@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Jolt/Jolt.h>
+#include <Jolt/Core/JobSystem.h>
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+struct RenderPacket;
+struct DrawItem;
+struct Bounds;
+
+struct OcclusionSettings {
+    int width = 256;                       // depth buffer, rounded up to a multiple of 4
+    int height = 128;
+    int bandHeight = 16;                   // rows per rasterization job
+
+    // The biggest draws on screen become occluders, each drawn with the finest
+    // level of detail that fits the triangle budget
+    int maxOccluders = 48;
+    float minOccluderScreenSize = 0.2f;    // see screenSize in Lod.hpp
+    size_t maxOccluderTriangles = 2048;
+};
+
+struct OcclusionStats {
+    uint32_t occluders = 0;
+    uint32_t occluderTriangles = 0;
+    uint32_t frustumCulled = 0;
+    uint32_t occluded = 0;
+};
+
+// Software occlusion culling on the simulation thread. A few large draws are
+// rasterized into a small 1/w buffer, four pixels at a time with Jolt's Vec4,
+// in row bands spread over the job system. Every draw's screen rectangle is
+// then tested against it and hidden ones are dropped from the camera pass.
+// Nothing is read back from the GPU, so results are ready the frame they're
+// needed and the whole pass runs without a GL context.
+class OcclusionCuller {
+public:
+    OcclusionCuller(JPH::JobSystem& inJobSystem, const OcclusionSettings& inSettings = OcclusionSettings());
+
+    // Filters packet.cameraDraws in place. Shadow casters are unaffected.
+    OcclusionStats cull(RenderPacket& packet);
+
+private:
+    struct ScreenTriangle {
+        float x[3], y[3];
+        float invW[3];
+        int minY, maxY;
+    };
+
+    void gatherOccluders(const RenderPacket& packet, OcclusionStats& stats);
+    void addOccluder(const DrawItem& draw);
+    void addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+    void rasterizeBand(int firstRow, int lastRow);
+    void rasterizeTriangle(const ScreenTriangle& triangle, int firstRow, int lastRow);
+
+    // 0 = off screen, 1 = hidden, 2 = possibly visible
+    int classify(const Bounds& bounds) const;
+
+    JPH::JobSystem& mJobSystem;
+    OcclusionSettings mSettings;
+    int mStride;
+
+    glm::mat4 mViewProjection;
+    std::vector<float> mDepth;  // 1/w of the closest occluder, 0 where there is none
+    std::vector<ScreenTriangle> mTriangles;
+    std::vector<std::pair<float, uint32_t>> mCandidates;
+};
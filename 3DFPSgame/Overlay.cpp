@@ -0,0 +1,116 @@
+#include "Overlay.hpp"
+#include "Shader.hpp"
+
+#include <algorithm>
+
+namespace {
+
+struct GlyphBits {
+    char character;
+    uint16_t bits;
+};
+
+constexpr GlyphBits cFont[] = {
+    { '!', 0x2482 }, { '"', 0x5A00 }, { '#', 0x5F7D }, { '%', 0x52A5 }, { '\'', 0x2400 }, { '(', 0x2922 },
+    { ')', 0x224A }, { '*', 0x0AA8 }, { '+', 0x05D0 }, { ',', 0x0014 }, { '-', 0x01C0 }, { '.', 0x0002 },
+    { '/', 0x12A4 }, { '0', 0x7B6F }, { '1', 0x2C97 }, { '2', 0x73E7 }, { '3', 0x72CF }, { '4', 0x5BC9 },
+    { '5', 0x79CF }, { '6', 0x79EF }, { '7', 0x7292 }, { '8', 0x7BEF }, { '9', 0x7BCF }, { ':', 0x0410 },
+    { '<', 0x1511 }, { '=', 0x0E38 }, { '>', 0x4454 }, { '?', 0x6282 }, { 'A', 0x2BED }, { 'B', 0x6BAE },
+    { 'C', 0x3923 }, { 'D', 0x6B6E }, { 'E', 0x79A7 }, { 'F', 0x79A4 }, { 'G', 0x396B }, { 'H', 0x5BED },
+    { 'I', 0x7497 }, { 'J', 0x126A }, { 'K', 0x5BAD }, { 'L', 0x4927 }, { 'M', 0x5FED }, { 'N', 0x6B6D },
+    { 'O', 0x2B6A }, { 'P', 0x6BA4 }, { 'Q', 0x2B73 }, { 'R', 0x6BAD }, { 'S', 0x388E }, { 'T', 0x7492 },
+    { 'U', 0x5B6F }, { 'V', 0x5B6A }, { 'W', 0x5BFD }, { 'X', 0x5AAD }, { 'Y', 0x5A92 }, { 'Z', 0x72A7 },
+    { '[', 0x6926 }, { ']', 0x324B }, { '_', 0x0007 }, { '{', 0x3593 }, { '|', 0x2492 }, { '}', 0x64D6 },
+};
+
+constexpr float cPixelSize = 2.0f;              // screen pixels per font pixel
+constexpr float cAdvance = 4.0f * cPixelSize;    // 3 wide plus a column of spacing
+constexpr float cLineHeight = 7.0f * cPixelSize; // 5 high plus two rows of spacing
+constexpr float cMargin = 8.0f;
+
+}
+
+TextOverlay::TextOverlay(const char* inVertexPath, const char* inFragmentPath)
+    : mShader(std::make_unique<Shader>(inVertexPath, inFragmentPath)) {
+    for (const GlyphBits& glyph : cFont)
+        mGlyphs[(unsigned char)glyph.character] = glyph.bits;
+
+    glGenVertexArrays(1, &mVAO);
+    glGenBuffers(1, &mVBO);
+    glBindVertexArray(mVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+}
+
+TextOverlay::~TextOverlay() {
+    glDeleteVertexArrays(1, &mVAO);
+    glDeleteBuffers(1, &mVBO);
+}
+
+void TextOverlay::appendQuad(float x, float y, float width, float height) {
+    glm::vec2 a(x, y), b(x + width, y), c(x + width, y + height), d(x, y + height);
+    mVertices.insert(mVertices.end(), { a, b, c, a, c, d });
+}
+
+void TextOverlay::draw(const std::string& text, int viewportWidth, int viewportHeight) {
+    if (text.empty() || viewportWidth <= 0 || viewportHeight <= 0)
+        return;
+
+    size_t columns = 0, lines = 0, column = 0;
+    for (char c : text) {
+        if (c == '\n') {
+            lines++;
+            column = 0;
+        }
+        else
+            columns = std::max(columns, ++column);
+    }
+    if (column > 0)
+        lines++;
+
+    // The backing goes first so one buffer holds both passes
+    mVertices.clear();
+    appendQuad(cMargin - cPixelSize * 2.0f, cMargin - cPixelSize * 2.0f,
+        columns * cAdvance + cPixelSize * 3.0f, lines * cLineHeight + cPixelSize * 2.0f);
+    size_t textStart = mVertices.size();
+
+    float x = cMargin, y = cMargin;
+    for (char c : text) {
+        if (c == '\n') {
+            x = cMargin;
+            y += cLineHeight;
+            continue;
+        }
+        unsigned char index = (unsigned char)(c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c);
+        uint16_t bits = index < 128 ? mGlyphs[index] : 0;
+        if (bits == 0 && c != ' ')
+            bits = mGlyphs[(unsigned char)'?'];
+        for (int row = 0; row < 5; row++)
+            for (int col = 0; col < 3; col++)
+                if ((bits >> (14 - row * 3 - col)) & 1)
+                    appendQuad(x + col * cPixelSize, y + row * cPixelSize, cPixelSize, cPixelSize);
+        x += cAdvance;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+    glBufferData(GL_ARRAY_BUFFER, mVertices.size() * sizeof(glm::vec2), mVertices.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    mShader->use();
+    mShader->setVec2("viewport", glm::vec2((float)viewportWidth, (float)viewportHeight));
+    glBindVertexArray(mVAO);
+    mShader->setVec4("color", glm::vec4(0.0f, 0.0f, 0.0f, 0.6f));
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)textStart);
+    mShader->setVec4("color", glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
+    glDrawArrays(GL_TRIANGLES, (GLint)textStart, (GLsizei)(mVertices.size() - textStart));
+    glBindVertexArray(0);
+
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+}
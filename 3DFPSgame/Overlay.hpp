@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Shader;
+
+// Debug text drawn over the finished frame from a built-in 3x5 pixel font.
+// Every lit font pixel is a quad generated on the CPU, so there is no font
+// texture to load and nothing to do when the text changes. Lowercase prints as
+// uppercase and characters without a glyph print as '?'. Render thread only.
+class TextOverlay {
+public:
+    TextOverlay(const char* inVertexPath, const char* inFragmentPath);
+    ~TextOverlay();
+
+    // Lines split on '\n', top left of the viewport, on a translucent backing
+    void draw(const std::string& text, int viewportWidth, int viewportHeight);
+
+    Shader& shader() { return *mShader; }
+
+private:
+    void appendQuad(float x, float y, float width, float height);
+
+    std::unique_ptr<Shader> mShader;
+    unsigned int mVAO = 0;
+    unsigned int mVBO = 0;
+    uint16_t mGlyphs[128] = {};       // 5 rows of 3 bits, top row in the high bits
+    std::vector<glm::vec2> mVertices;  // rebuilt every draw, capacity kept
+};
@@ -1,41 +1,55 @@
 #include "Physics.hpp"
+#include "Determinism.hpp"
+#include "Hitboxes.hpp"
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <chrono>
 
 using namespace JPH;
 using namespace JPH::literals;
 
+namespace
+{
+    struct PhysicsMetrics
+    {
+        MetricsRegistry& registry = Metrics::registry();
+        Histogram& stepTime = registry.histogram("fps_physics_step_seconds", "Wall time of one physics step", Metrics::tickBuckets());
+        Gauge& bodies = registry.gauge("fps_physics_bodies", "Bodies in the physics system");
+        Gauge& activeBodies = registry.gauge("fps_physics_active_bodies", "Bodies awake after the last step");
+        Gauge& maxBodies = registry.gauge("fps_physics_max_bodies", "Body capacity the physics system was created with");
+        Gauge& maxBodyPairs = registry.gauge("fps_physics_max_body_pairs", "Broadphase pair capacity per step");
+        Gauge& maxContactConstraints = registry.gauge("fps_physics_max_contact_constraints", "Contact constraint capacity per step");
+        Gauge& activeContacts = registry.gauge("fps_physics_active_contacts", "Touching sub-shape pairs after the last step");
+
+        // Counted before ContactEventQueue folds them into body pairs, so added minus removed is
+        // the number of manifolds alive
+        Counter& contactsAdded = registry.counter("fps_physics_contacts_added_total", "Sub-shape contacts that started");
+        Counter& contactsRemoved = registry.counter("fps_physics_contacts_removed_total", "Sub-shape contacts that ended");
+    };
+
+    PhysicsMetrics& metrics()
+    {
+        static PhysicsMetrics sMetrics;
+        return sMetrics;
+    }
+}
 
 
-// Layer filters
+// Layer filters, all driven by cLayerTable
 class Physics::ObjectLayerPairFilterImpl : public ObjectLayerPairFilter
 {
 public:
     bool ShouldCollide(ObjectLayer inObject1, ObjectLayer inObject2) const override
     {
-        switch (inObject1)
-        {
-        case Layers::NON_MOVING: return inObject2 == Layers::MOVING;
-        case Layers::MOVING: return true;
-        default: JPH_ASSERT(false); return false;
-        }
+        JPH_ASSERT(inObject1 < Layers::NUM_LAYERS && inObject2 < Layers::NUM_LAYERS);
+        return (cLayerTable[inObject1].collidesWith >> inObject2) & 1;
     }
 };
 
-namespace BroadPhaseLayers
-{
-    static constexpr BroadPhaseLayer NON_MOVING(0);
-    static constexpr BroadPhaseLayer MOVING(1);
-    static constexpr uint NUM_LAYERS(2);
-}
-
 class Physics::BPLayerInterfaceImpl final : public BroadPhaseLayerInterface
 {
 public:
-    BPLayerInterfaceImpl()
-    {
-        mObjectToBroadPhase[Layers::NON_MOVING] = BroadPhaseLayers::NON_MOVING;
-        mObjectToBroadPhase[Layers::MOVING] = BroadPhaseLayers::MOVING;
-    }
-
     uint GetNumBroadPhaseLayers() const override
     {
         return BroadPhaseLayers::NUM_LAYERS;
@@ -44,7 +58,7 @@ public:
     BroadPhaseLayer GetBroadPhaseLayer(ObjectLayer inLayer) const override
     {
         JPH_ASSERT(inLayer < Layers::NUM_LAYERS);
-        return mObjectToBroadPhase[inLayer];
+        return cLayerTable[inLayer].broadPhaseLayer;
     }
 
 #if defined(JPH_EXTERNAL_PROFILE) || defined(JPH_PROFILE_ENABLED)
@@ -54,55 +68,110 @@ public:
         {
         case (BroadPhaseLayer::Type)BroadPhaseLayers::NON_MOVING: return "NON_MOVING";
         case (BroadPhaseLayer::Type)BroadPhaseLayers::MOVING:     return "MOVING";
+        case (BroadPhaseLayer::Type)BroadPhaseLayers::DEBRIS:     return "DEBRIS";
+        case (BroadPhaseLayer::Type)BroadPhaseLayers::QUERY:      return "QUERY";
+        case (BroadPhaseLayer::Type)BroadPhaseLayers::TRIGGER:    return "TRIGGER";
         default:                                                  JPH_ASSERT(false); return "INVALID";
         }
     }
 #endif
-
-private:
-    BroadPhaseLayer mObjectToBroadPhase[Layers::NUM_LAYERS];
 };
 
 class Physics::ObjectVsBroadPhaseLayerFilterImpl : public ObjectVsBroadPhaseLayerFilter
 {
 public:
+    ObjectVsBroadPhaseLayerFilterImpl()
+    {
+        for (ObjectLayer layer = 0; layer < Layers::NUM_LAYERS; layer++)
+            mBroadPhaseMask[layer] = broadPhaseMask(cLayerTable[layer].collidesWith);
+    }
+
     bool ShouldCollide(ObjectLayer inLayer1, BroadPhaseLayer inLayer2) const override
     {
-        switch (inLayer1)
-        {
-        case Layers::NON_MOVING: return inLayer2 == BroadPhaseLayers::MOVING;
-        case Layers::MOVING: return true;
-        default: JPH_ASSERT(false); return false;
-        }
+        JPH_ASSERT(inLayer1 < Layers::NUM_LAYERS);
+        return (mBroadPhaseMask[inLayer1] >> (BroadPhaseLayer::Type)inLayer2) & 1;
     }
+
+private:
+    uint32_t mBroadPhaseMask[Layers::NUM_LAYERS];
 };
 
+// Both listeners run on Jolt worker threads mid-step and only record into the queue
 class Physics::MyBodyActivationListener : public BodyActivationListener
 {
 public:
-    void OnBodyActivated(const BodyID&, uint64) override { std::cout << "Body activated" << std::endl; }
-    void OnBodyDeactivated(const BodyID&, uint64) override { std::cout << "Body deactivated" << std::endl; }
+    explicit MyBodyActivationListener(ContactEventQueue& inQueue) : mQueue(inQueue) {}
+
+    void OnBodyActivated(const BodyID& inBodyID, uint64) override { push(ContactEventType::Activated, inBodyID); }
+    void OnBodyDeactivated(const BodyID& inBodyID, uint64) override { push(ContactEventType::Deactivated, inBodyID); }
+
+private:
+    void push(ContactEventType inType, const BodyID& inBodyID)
+    {
+        ContactEvent event;
+        event.type = inType;
+        event.body1 = inBodyID;
+        mQueue.push(event);
+    }
+
+    ContactEventQueue& mQueue;
 };
 
 class Physics::MyContactListener : public ContactListener
 {
 public:
+    explicit MyContactListener(ContactEventQueue& inQueue) : mQueue(inQueue) {}
+
     ValidateResult OnContactValidate(const Body&, const Body&, RVec3Arg, const CollideShapeResult&) override
     {
         return ValidateResult::AcceptAllContactsForThisBodyPair;
     }
-    void OnContactAdded(const Body&, const Body&, const ContactManifold&, ContactSettings&) override
+    void OnContactAdded(const Body& inBody1, const Body& inBody2, const ContactManifold& inManifold, ContactSettings&) override
     {
-        std::cout << "Contact added" << std::endl;
+        ContactEvent event;
+        event.type = ContactEventType::Added;
+        event.body1 = inBody1.GetID();
+        event.body2 = inBody2.GetID();
+        event.subShape1 = inManifold.mSubShapeID1;
+        event.subShape2 = inManifold.mSubShapeID2;
+        event.normal = inManifold.mWorldSpaceNormal;
+        event.position = inManifold.mRelativeContactPointsOn1.empty() ? inManifold.mBaseOffset : inManifold.GetWorldSpaceContactPointOn1(0);
+
+        // Positive when the bodies are moving into each other
+        Vec3 relativeVelocity = inBody1.GetPointVelocity(event.position) - inBody2.GetPointVelocity(event.position);
+        event.impactSpeed = relativeVelocity.Dot(event.normal);
+
+        if (event.body2 < event.body1)
+        {
+            std::swap(event.body1, event.body2);
+            std::swap(event.subShape1, event.subShape2);
+            event.normal = -event.normal;
+        }
+        mQueue.push(event);
+        metrics().contactsAdded.add();
     }
     void OnContactPersisted(const Body&, const Body&, const ContactManifold&, ContactSettings&) override
     {
-        //std::cout << "Contact persisted" << std::endl;
     }
-    void OnContactRemoved(const SubShapeIDPair&) override
+    void OnContactRemoved(const SubShapeIDPair& inPair) override
     {
-        std::cout << "Contact removed" << std::endl;
+        ContactEvent event;
+        event.type = ContactEventType::Removed;
+        event.body1 = inPair.GetBody1ID();
+        event.body2 = inPair.GetBody2ID();
+        event.subShape1 = inPair.GetSubShapeID1();
+        event.subShape2 = inPair.GetSubShapeID2();
+        if (event.body2 < event.body1)
+        {
+            std::swap(event.body1, event.body2);
+            std::swap(event.subShape1, event.subShape2);
+        }
+        mQueue.push(event);
+        metrics().contactsRemoved.add();
     }
+
+private:
+    ContactEventQueue& mQueue;
 };
 
 // Tracing and asserts
@@ -128,17 +197,29 @@ static bool AssertFailedImpl(const char* inExpression, const char* inMessage, co
 // Physics class code
 // -----------------
 
-Physics::Physics()
+PhysicsCapacity PhysicsCapacity::withPlayers(size_t players)
+{
+    // Crowds touch each other as well as the floor, so pairs and constraints get
+    // a few per player
+    static constexpr JPH::uint cPairsPerPlayer = 8;
+
+    PhysicsCapacity capacity;
+    capacity.maxBodies += (JPH::uint)players * cBodiesPerPlayer;
+    capacity.maxBodyPairs += (JPH::uint)players * cPairsPerPlayer;
+    capacity.maxContactConstraints += (JPH::uint)players * cPairsPerPlayer;
+    return capacity;
+}
+
+Physics::Physics(const PhysicsCapacity& inCapacity)
 {
     // Initialize Jolt
-    RegisterDefaultAllocator();
+    Memory::installJoltAllocator();
     Trace = TraceImpl;
     JPH_IF_ENABLE_ASSERTS(AssertFailed = AssertFailedImpl;)
         Factory::sInstance = new Factory();
     RegisterTypes();
 
-    // Create temp allocator and job system
-    mTempAllocator = std::make_unique<TempAllocatorImpl>(10 * 1024 * 1024);
+    // Step scratch comes from the per-frame arena; only the job system is ours
     mJobSystem = std::make_unique<JobSystemThreadPool>(cMaxPhysicsJobs, cMaxPhysicsBarriers, thread::hardware_concurrency() - 1);
 
     // Create filters
@@ -148,44 +229,200 @@ Physics::Physics()
 
     // Init physics system
     mPhysicsSystem.Init(
-        1024, // Max bodies
+        inCapacity.maxBodies,
         0,    // Mutex count
-        1024, // Max body pairs
-        1024, // Max contact constraints
+        inCapacity.maxBodyPairs,
+        inCapacity.maxContactConstraints,
         *mBroadPhaseLayerInterface,
         *mObjectVsBroadPhaseLayerFilter,
         *mObjectLayerPairFilter
     );
 
     // Setup listeners
-    mBodyActivationListener = std::make_unique<MyBodyActivationListener>();
-    mContactListener = std::make_unique<MyContactListener>();
+    mContactEvents = std::make_unique<ContactEventQueue>();
+    mBodyActivationListener = std::make_unique<MyBodyActivationListener>(*mContactEvents);
+    mContactListener = std::make_unique<MyContactListener>(*mContactEvents);
     mPhysicsSystem.SetBodyActivationListener(mBodyActivationListener.get());
     mPhysicsSystem.SetContactListener(mContactListener.get());
 
-    // Create the floor
+    mHitboxes = std::make_unique<HitboxSystem>(*this);
+
+    PhysicsMetrics& stats = metrics();
+    stats.maxBodies.set(inCapacity.maxBodies);
+    stats.maxBodyPairs.set(inCapacity.maxBodyPairs);
+    stats.maxContactConstraints.set(inCapacity.maxContactConstraints);
+}
+
+Physics::~Physics()
+{
+    // Cleanup
+    UnregisterTypes();
+    delete Factory::sInstance;
+    Factory::sInstance = nullptr;
+}
+
+void Physics::update(float deltaTime)
+{
+    optimizeBroadPhaseIfChurned();
+    auto stepStart = std::chrono::steady_clock::now();
+    mPhysicsSystem.Update(deltaTime, 1, &Memory::frameArena(), mJobSystem.get());
+    std::chrono::duration<double> stepTime = std::chrono::steady_clock::now() - stepStart;
+    mContactEvents->merge();
+    mHitboxes->sync();
+
+    PhysicsMetrics& stats = metrics();
+    stats.stepTime.observe(stepTime.count());
+    PhysicsSystem::BodyStats bodyStats = mPhysicsSystem.GetBodyStats();
+    stats.bodies.set(bodyStats.mNumBodies);
+    stats.activeBodies.set(bodyStats.mNumActiveBodiesDynamic + bodyStats.mNumActiveBodiesKinematic);
+    stats.activeContacts.set((double)stats.contactsAdded.value() - (double)stats.contactsRemoved.value());
+}
+
+BodyBatch Physics::prepareBodies(const std::vector<BodyCreationSettings>& settings)
+{
+    BodyInterface& bodyInterface = mPhysicsSystem.GetBodyInterface();
+
+    BodyBatch batch;
+    batch.bodyIDs.reserve(settings.size());
+    for (const BodyCreationSettings& bodySettings : settings)
+    {
+        Body* body = bodyInterface.CreateBody(bodySettings);
+        if (body == nullptr)
+        {
+            std::cout << "Out of bodies, " << settings.size() - batch.bodyIDs.size() << " spawns dropped" << std::endl;
+            break;
+        }
+        batch.bodyIDs.push_back(body->GetID());
+    }
+
+    if (!batch.bodyIDs.empty())
+        batch.addState = bodyInterface.AddBodiesPrepare(batch.bodyIDs.data(), (int)batch.bodyIDs.size());
+    return batch;
+}
+
+void Physics::commitBodies(BodyBatch& batch, EActivation activation)
+{
+    if (batch.bodyIDs.empty())
+        return;
+
+    mPhysicsSystem.GetBodyInterface().AddBodiesFinalize(batch.bodyIDs.data(), (int)batch.bodyIDs.size(), batch.addState, activation);
+    batch.addState = nullptr;
+
+    // The batch went in as a single pre-built subtree
+    noteBroadPhaseChurn(1);
+}
+
+void Physics::abortBodies(BodyBatch& batch)
+{
+    if (batch.bodyIDs.empty())
+        return;
+
+    BodyInterface& bodyInterface = mPhysicsSystem.GetBodyInterface();
+    bodyInterface.AddBodiesAbort(batch.bodyIDs.data(), (int)batch.bodyIDs.size(), batch.addState);
+    bodyInterface.DestroyBodies(batch.bodyIDs.data(), (int)batch.bodyIDs.size());
+    batch.bodyIDs.clear();
+    batch.addState = nullptr;
+}
+
+std::vector<BodyID> Physics::spawnBodies(const std::vector<BodyCreationSettings>& settings, EActivation activation)
+{
+    BodyBatch batch = prepareBodies(settings);
+    commitBodies(batch, activation);
+    return std::move(batch.bodyIDs);
+}
+
+BodyID Physics::spawnBody(const BodyCreationSettings& settings, EActivation activation)
+{
+    std::vector<BodyID> bodyIDs = spawnBodies({ settings }, activation);
+    return bodyIDs.empty() ? BodyID() : bodyIDs.front();
+}
+
+void Physics::despawnBodies(const std::vector<BodyID>& bodyIDs)
+{
+    if (bodyIDs.empty())
+        return;
+
+    // RemoveBodies sorts its input, so work on a copy
+    std::vector<BodyID> ids = bodyIDs;
     BodyInterface& bodyInterface = mPhysicsSystem.GetBodyInterface();
+    bodyInterface.RemoveBodies(ids.data(), (int)ids.size());
+    bodyInterface.DestroyBodies(ids.data(), (int)ids.size());
+
+    // Every removal leaves a hole in the tree that only a rebuild compacts
+    noteBroadPhaseChurn((uint32_t)ids.size());
+}
+
+void Physics::noteBroadPhaseChurn(uint32_t edits)
+{
+    mBroadPhaseChurn += edits;
+}
+
+void Physics::optimizeBroadPhaseIfChurned()
+{
+    uint32_t threshold = std::max(cMinBroadPhaseChurn, (uint32_t)(mPhysicsSystem.GetNumBodies() * cBroadPhaseChurnFraction));
+    if (mBroadPhaseChurn < threshold)
+        return;
+
+    mBroadPhaseChurn = 0;
+
+    // Jolt requires that nothing else modifies or queries bodies while the tree
+    // rebuilds, so it runs here on the stepping thread, right before the step,
+    // where gameplay is already waiting on physics
+    mPhysicsSystem.OptimizeBroadPhase();
+}
+
+BodyID Physics::addStaticBody(const ShapeRefC& shape, RVec3Arg position, QuatArg rotation)
+{
+    BodyCreationSettings settings(shape, position, rotation, EMotionType::Static, Layers::NON_MOVING);
+    return spawnBody(settings, EActivation::DontActivate);
+}
+
+void Physics::createDefaultFloor()
+{
     BoxShapeSettings floorShapeSettings(Vec3(1000.0f, 1.0f, 1000.0f));
     floorShapeSettings.SetEmbedded();
     ShapeRefC floorShape = floorShapeSettings.Create().Get();
-    BodyCreationSettings floorSettings(floorShape, RVec3(0.0_r, -1.0_r, 0.0_r), Quat::sIdentity(), EMotionType::Static, Layers::NON_MOVING);
 
-	floorBodyID = bodyInterface.CreateAndAddBody(floorSettings, EActivation::DontActivate);
+    floorBodyID = addStaticBody(floorShape, RVec3(0.0_r, -1.0_r, 0.0_r), Quat::sIdentity());
 
     mPhysicsSystem.OptimizeBroadPhase();
 }
 
-Physics::~Physics()
+void Physics::setDeterministic(bool inDeterministic)
 {
-    BodyInterface& bodyInterface = mPhysicsSystem.GetBodyInterface();
+    mDeterministic = inDeterministic;
 
-    // Cleanup
-    UnregisterTypes();
-    delete Factory::sInstance;
-    Factory::sInstance = nullptr;
+    // Jolt only guarantees identical results independent of job scheduling when
+    // this is set. Bodies must also be created in the same order every run, which
+    // holds as long as they are added from a single thread.
+    PhysicsSettings settings = mPhysicsSystem.GetPhysicsSettings();
+    settings.mDeterministicSimulation = inDeterministic;
+    mPhysicsSystem.SetPhysicsSettings(settings);
 }
 
-void Physics::update(float deltaTime)
+void Physics::hashState(StateHasher& hasher) const
 {
-    mPhysicsSystem.Update(deltaTime, 1, mTempAllocator.get(), mJobSystem.get());
+    BodyIDVector bodyIDs;
+    mPhysicsSystem.GetBodies(bodyIDs);
+    std::sort(bodyIDs.begin(), bodyIDs.end());
+
+    const BodyLockInterfaceNoLock& lockInterface = mPhysicsSystem.GetBodyLockInterfaceNoLock();
+    for (const BodyID& id : bodyIDs)
+    {
+        BodyLockRead lock(lockInterface, id);
+        if (!lock.Succeeded())
+            continue;
+
+        const Body& body = lock.GetBody();
+        RVec3 position = body.GetPosition();
+        Quat rotation = body.GetRotation();
+        Vec3 linearVelocity = body.GetLinearVelocity();
+        Vec3 angularVelocity = body.GetAngularVelocity();
+
+        hasher.add(id.GetIndexAndSequenceNumber());
+        hasher.add(position.GetX()); hasher.add(position.GetY()); hasher.add(position.GetZ());
+        hasher.add(rotation.GetX()); hasher.add(rotation.GetY()); hasher.add(rotation.GetZ()); hasher.add(rotation.GetW());
+        hasher.add(linearVelocity.GetX()); hasher.add(linearVelocity.GetY()); hasher.add(linearVelocity.GetZ());
+        hasher.add(angularVelocity.GetX()); hasher.add(angularVelocity.GetY()); hasher.add(angularVelocity.GetZ());
+    }
 }
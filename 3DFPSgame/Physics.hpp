@@ -13,48 +13,225 @@
 #include <Jolt/Physics/Collision/Shape/SphereShape.h>
 #include <Jolt/Physics/Body/BodyCreationSettings.h>
 #include <Jolt/Physics/Body/BodyActivationListener.h>
+#include <Jolt/Physics/Body/BodyLock.h>
 #include <Jolt/Physics/Collision/Shape/CapsuleShape.h>
 #include <Jolt/Physics/Collision/ShapeCast.h>
 #include <Jolt/Physics/Collision/RayCast.h> 
 #include <Jolt/Physics/Collision/CastResult.h>
 #include <Jolt/Physics/Collision/CollisionCollectorImpl.h>
+#include "ContactEvents.hpp"
+#include "Memory.hpp"
 #include <iostream>
 #include <cstdarg>
 #include <thread>
+#include <vector>
+
+class StateHasher;
+class HitboxSystem;
 
 namespace Layers
 {
-    static constexpr JPH::ObjectLayer NON_MOVING = 0;
-    static constexpr JPH::ObjectLayer MOVING = 1;
-    static constexpr JPH::ObjectLayer NUM_LAYERS = 2;
+    static constexpr JPH::ObjectLayer NON_MOVING = 0;  // static world geometry
+    static constexpr JPH::ObjectLayer MOVING = 1;      // dynamic props
+    static constexpr JPH::ObjectLayer PLAYER = 2;      // player movement capsules
+    static constexpr JPH::ObjectLayer HITBOX = 3;      // damage shapes, queried but never simulated
+    static constexpr JPH::ObjectLayer DEBRIS = 4;      // cosmetic bodies nobody shoots at or stands on
+    static constexpr JPH::ObjectLayer PROJECTILE = 5;  // physical projectiles such as grenades
+    static constexpr JPH::ObjectLayer TRIGGER = 6;     // sensor volumes
+    static constexpr JPH::ObjectLayer NUM_LAYERS = 7;
+
+    constexpr uint32_t bit(JPH::ObjectLayer inLayer) { return 1u << inLayer; }
+}
+
+// Each broadphase layer is its own tree, so a query that rejects a layer here
+// never walks that tree at all
+namespace BroadPhaseLayers
+{
+    static constexpr JPH::BroadPhaseLayer NON_MOVING(0);
+    static constexpr JPH::BroadPhaseLayer MOVING(1);
+    static constexpr JPH::BroadPhaseLayer DEBRIS(2);
+    static constexpr JPH::BroadPhaseLayer QUERY(3);    // hitboxes, only reached by explicit queries
+    static constexpr JPH::BroadPhaseLayer TRIGGER(4);  // sensor volumes, overlapped by movers
+    static constexpr JPH::uint NUM_LAYERS(5);
 }
 
+struct LayerInfo
+{
+    const char* name;
+    JPH::BroadPhaseLayer broadPhaseLayer;
+    uint32_t collidesWith;  // Layers::bit mask, must be symmetric
+};
+
+// The collision matrix. Edit rows here; the filters below are derived from it.
+inline constexpr LayerInfo cLayerTable[Layers::NUM_LAYERS] =
+{
+    { "NON_MOVING", BroadPhaseLayers::NON_MOVING, Layers::bit(Layers::MOVING) | Layers::bit(Layers::PLAYER) | Layers::bit(Layers::DEBRIS) | Layers::bit(Layers::PROJECTILE) },
+    { "MOVING",     BroadPhaseLayers::MOVING,     Layers::bit(Layers::NON_MOVING) | Layers::bit(Layers::MOVING) | Layers::bit(Layers::PLAYER) | Layers::bit(Layers::DEBRIS) | Layers::bit(Layers::PROJECTILE) | Layers::bit(Layers::TRIGGER) },
+    { "PLAYER",     BroadPhaseLayers::MOVING,     Layers::bit(Layers::NON_MOVING) | Layers::bit(Layers::MOVING) | Layers::bit(Layers::PLAYER) | Layers::bit(Layers::TRIGGER) },
+    { "HITBOX",     BroadPhaseLayers::QUERY,      0 },
+    { "DEBRIS",     BroadPhaseLayers::DEBRIS,     Layers::bit(Layers::NON_MOVING) | Layers::bit(Layers::MOVING) | Layers::bit(Layers::DEBRIS) },
+    { "PROJECTILE", BroadPhaseLayers::MOVING,     Layers::bit(Layers::NON_MOVING) | Layers::bit(Layers::MOVING) },
+    { "TRIGGER",    BroadPhaseLayers::TRIGGER,    Layers::bit(Layers::MOVING) | Layers::bit(Layers::PLAYER) },
+};
+
+constexpr bool isLayerTableSymmetric()
+{
+    for (JPH::ObjectLayer a = 0; a < Layers::NUM_LAYERS; a++)
+        for (JPH::ObjectLayer b = 0; b < Layers::NUM_LAYERS; b++)
+            if (((cLayerTable[a].collidesWith >> b) & 1) != ((cLayerTable[b].collidesWith >> a) & 1))
+                return false;
+    return true;
+}
+static_assert(isLayerTableSymmetric(), "cLayerTable collision matrix must be symmetric");
+
+// Broadphase trees that contain any of the object layers in the mask
+constexpr uint32_t broadPhaseMask(uint32_t inLayerMask)
+{
+    uint32_t mask = 0;
+    for (JPH::ObjectLayer layer = 0; layer < Layers::NUM_LAYERS; layer++)
+        if ((inLayerMask >> layer) & 1)
+            mask |= 1u << (JPH::BroadPhaseLayer::Type)cLayerTable[layer].broadPhaseLayer;
+    return mask;
+}
+
+// Layer sets for gameplay queries
+namespace QueryLayers
+{
+    // Players are hit through their hitboxes, not their movement capsules
+    static constexpr uint32_t HITSCAN = Layers::bit(Layers::NON_MOVING) | Layers::bit(Layers::MOVING);
+    static constexpr uint32_t GROUND = Layers::bit(Layers::NON_MOVING) | Layers::bit(Layers::MOVING);
+    // Props move, so the nav grid is built from static geometry only
+    static constexpr uint32_t NAVIGATION = Layers::bit(Layers::NON_MOVING);
+}
+
+class ObjectLayerMaskFilter : public JPH::ObjectLayerFilter
+{
+public:
+    explicit ObjectLayerMaskFilter(uint32_t inLayerMask) : mLayerMask(inLayerMask) {}
+
+    bool ShouldCollide(JPH::ObjectLayer inLayer) const override { return (mLayerMask >> inLayer) & 1; }
+
+private:
+    uint32_t mLayerMask;
+};
+
+class BroadPhaseLayerMaskFilter : public JPH::BroadPhaseLayerFilter
+{
+public:
+    explicit BroadPhaseLayerMaskFilter(uint32_t inLayerMask) : mBroadPhaseMask(broadPhaseMask(inLayerMask)) {}
+
+    bool ShouldCollide(JPH::BroadPhaseLayer inLayer) const override { return (mBroadPhaseMask >> (JPH::BroadPhaseLayer::Type)inLayer) & 1; }
+
+private:
+    uint32_t mBroadPhaseMask;
+};
+
+// Both halves of a query filter built from one Layers::bit mask
+struct QueryFilter
+{
+    explicit QueryFilter(uint32_t inLayerMask) : broadPhase(inLayerMask), object(inLayerMask) {}
+
+    BroadPhaseLayerMaskFilter broadPhase;
+    ObjectLayerMaskFilter object;
+};
+
+// Bodies created and inserted into the broadphase as one subtree. Preparing is
+// allowed on any thread; committing happens on the thread that steps the world.
+struct BodyBatch
+{
+    std::vector<JPH::BodyID> bodyIDs;
+    JPH::BodyInterface::AddState addState = nullptr;
+};
+
+// Capacity the physics system is created with. Spawns past maxBodies fail;
+// pairs and constraints past theirs are dropped for the step.
+struct PhysicsCapacity
+{
+    JPH::uint maxBodies = 1024;
+    JPH::uint maxBodyPairs = 1024;
+    JPH::uint maxContactConstraints = 1024;
+
+    // Each player or bot is a capsule and a hitbox compound
+    static constexpr JPH::uint cBodiesPerPlayer = 2;
+
+    // The defaults, which cover the level and projectiles, plus room for this
+    // many players and bots
+    static PhysicsCapacity withPlayers(size_t players);
+};
+
 class Physics
 {
 public:
-    Physics();
+    explicit Physics(const PhysicsCapacity& inCapacity = PhysicsCapacity());
     ~Physics();
 
     void update(float deltaTime);
 
+    // Step length used when running deterministically; variable frame times are
+    // accumulated by the caller and consumed in multiples of this.
+    static constexpr float cFixedTimeStep = 1.0f / 60.0f;
+
+    void setDeterministic(bool inDeterministic);
+    bool isDeterministic() const { return mDeterministic; }
+
+    // Folds every body's position, rotation and velocities into the hasher in
+    // BodyID order, so the digest does not depend on internal array layout.
+    void hashState(StateHasher& hasher) const;
+
+    // Static level geometry. Scene loading supplies the real collision; the
+    // default floor is only a fallback when no scene could be loaded.
+    JPH::BodyID addStaticBody(const JPH::ShapeRefC& shape, JPH::RVec3Arg position, JPH::QuatArg rotation);
+    void createDefaultFloor();
+
+    // Bulk spawning. A committed batch costs the broadphase one subtree insertion
+    // instead of one leaf per body, and removals are batched the same way.
+    BodyBatch prepareBodies(const std::vector<JPH::BodyCreationSettings>& settings);
+    void commitBodies(BodyBatch& batch, JPH::EActivation activation);
+    void abortBodies(BodyBatch& batch);
+
+    std::vector<JPH::BodyID> spawnBodies(const std::vector<JPH::BodyCreationSettings>& settings, JPH::EActivation activation);
+    JPH::BodyID spawnBody(const JPH::BodyCreationSettings& settings, JPH::EActivation activation);
+    void despawnBodies(const std::vector<JPH::BodyID>& bodyIDs);
+
     JPH::PhysicsSystem& getPhysicsSystem() { return mPhysicsSystem; }
+    HitboxSystem& getHitboxes() { return *mHitboxes; }
+
+    // Contacts and activations from the last update, sorted by body pair. Also
+    // includes activations caused between steps (spawning, waking bodies).
+    const std::vector<ContactEvent>& getContactEvents() const { return mContactEvents->events(); }
+
+    // Free between steps for short gameplay jobs (projectile sweeps and the like)
+    JPH::JobSystem& getJobSystem() { return *mJobSystem; }
 
     JPH::BodyID floorBodyID;
 private:
-    std::unique_ptr<JPH::TempAllocatorImpl> mTempAllocator;
     std::unique_ptr<JPH::JobSystemThreadPool> mJobSystem;
     JPH::PhysicsSystem mPhysicsSystem;
 
+    bool mDeterministic = false;
+
+    // Broadphase tree edits since the last full optimize. Once it crosses the
+    // threshold the next update() rebuilds the tree before stepping.
+    void noteBroadPhaseChurn(uint32_t edits);
+    void optimizeBroadPhaseIfChurned();
+
+    static constexpr uint32_t cMinBroadPhaseChurn = 64;
+    static constexpr float cBroadPhaseChurnFraction = 0.25f;
+    uint32_t mBroadPhaseChurn = 0;
+
     class MyBodyActivationListener;
     class MyContactListener;
     class ObjectLayerPairFilterImpl;
     class BPLayerInterfaceImpl;
     class ObjectVsBroadPhaseLayerFilterImpl;
 
+    std::unique_ptr<ContactEventQueue> mContactEvents;
     std::unique_ptr<MyBodyActivationListener> mBodyActivationListener;
     std::unique_ptr<MyContactListener> mContactListener;
     std::unique_ptr<ObjectLayerPairFilterImpl> mObjectLayerPairFilter;
     std::unique_ptr<BPLayerInterfaceImpl> mBroadPhaseLayerInterface;
     std::unique_ptr<ObjectVsBroadPhaseLayerFilterImpl> mObjectVsBroadPhaseLayerFilter;
 
+    std::unique_ptr<HitboxSystem> mHitboxes;
+
 };
@@ -1,4 +1,9 @@
 #include "PlayerController.hpp"
+#include "Determinism.hpp"
+#include "Hitboxes.hpp"
+
+#include <algorithm>
+#include <cmath>
 
 PlayerController::PlayerController(glm::vec3 startPosi, Physics& inPhysics)
     : startPos(startPosi),
@@ -6,9 +11,7 @@ PlayerController::PlayerController(glm::vec3 startPosi, Physics& inPhysics)
     jumpVelocity(4.0f),
     camera(startPosi),
     physics(inPhysics),
-    gun(inPhysics, playerBodyID, 0.2f, 3.0f){
-
-    JPH::BodyInterface& bodyInterface = physics.getPhysicsSystem().GetBodyInterface();
+    gun(inPhysics, playerBodyID){
 
     mPlayerShape = new JPH::CapsuleShape(mPlayerHeight * 0.5f, mPlayerRadius);
 
@@ -17,14 +20,16 @@ PlayerController::PlayerController(glm::vec3 startPosi, Physics& inPhysics)
         JPH::RVec3(startPos.x, startPos.y, startPos.z),
         JPH::Quat::sIdentity(),
         JPH::EMotionType::Dynamic,
-        Layers::MOVING // Use the moving layer
+        Layers::PLAYER
     );
     playerBodySettings.mAllowSleeping = false;
     playerBodySettings.mMotionQuality = JPH::EMotionQuality::LinearCast;
     playerBodySettings.mInertiaMultiplier = 0.0f; // disable rotations
 
 
-    playerBodyID = bodyInterface.CreateAndAddBody(playerBodySettings, JPH::EActivation::Activate);
+    playerBodyID = physics.spawnBody(playerBodySettings, JPH::EActivation::Activate);
+    if (hasBody())
+        physics.getHitboxes().registerPlayer(playerBodyID, mPlayerHeight, mPlayerRadius);
 
 }
 
@@ -43,8 +48,7 @@ bool PlayerController::isGrounded() {
 
 	JPH::ShapeFilter shapeFilter;
 	JPH::IgnoreSingleBodyFilter bodyFilter(playerBodyID);// ignore the player body itself
-	JPH::ObjectLayerFilter objectLayerFilter;
-	JPH::BroadPhaseLayerFilter broadPhaseLayerFilter;
+	QueryFilter groundFilter(QueryLayers::GROUND);
 
     
     JPH::ClosestHitCollisionCollector<JPH::CastShapeCollector> collector;
@@ -56,8 +60,8 @@ bool PlayerController::isGrounded() {
         settings,
         JPH::Vec3::sZero(),
         collector,
-        broadPhaseLayerFilter,
-        objectLayerFilter,
+        groundFilter.broadPhase,
+        groundFilter.object,
         bodyFilter, 
         shapeFilter
     );
@@ -70,7 +74,49 @@ bool PlayerController::isGrounded() {
     return false;
 }
 
+PlayerInput PlayerController::sampleInput(GLFWwindow* window) const {
+    PlayerInput input;
+    input.yaw = static_cast<float>(yaw);
+    input.pitch = pitch;
+    input.weaponSlot = weaponSlot;
+
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+        input.press(PlayerInput::Forward);
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+        input.press(PlayerInput::Back);
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+        input.press(PlayerInput::Left);
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        input.press(PlayerInput::Right);
+    if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
+        input.press(PlayerInput::Run);
+    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
+        input.press(PlayerInput::Jump);
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
+        input.press(PlayerInput::Reload);
+    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
+        input.press(PlayerInput::Fire);
+    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS)
+        input.press(PlayerInput::AltFire);
+
+    for (int key = GLFW_KEY_1; key <= GLFW_KEY_9; key++) {
+        if (glfwGetKey(window, key) == GLFW_PRESS)
+            input.weaponSlot = static_cast<uint8_t>(key - GLFW_KEY_1);
+    }
+
+    return input;
+}
+
 void PlayerController::update(GLFWwindow* window, double deltaTime) {
+    update(sampleInput(window), deltaTime);
+}
+
+void PlayerController::update(const PlayerInput& input, double deltaTime) {
+    lastInput = input;
+
+    // View angles travel with the input so replays and non-mouse drivers steer too
+    camera.updateRotation(input.yaw, input.pitch);
+    physics.getHitboxes().setYaw(playerBodyID, input.yaw);
 
     JPH::BodyInterface& bodyInterface = physics.getPhysicsSystem().GetBodyInterface();
     JPH::Vec3 currentVelocity = bodyInterface.GetLinearVelocity(playerBodyID);
@@ -82,20 +128,19 @@ void PlayerController::update(GLFWwindow* window, double deltaTime) {
 
     glm::vec3 moveDir(0.0f);
 
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    if (input.isDown(PlayerInput::Forward))
         moveDir += camera.XZfront;
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+    if (input.isDown(PlayerInput::Back))
         moveDir -= camera.XZfront;
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+    if (input.isDown(PlayerInput::Left))
         moveDir -= glm::normalize(glm::cross(camera.front, camera.up));
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+    if (input.isDown(PlayerInput::Right))
         moveDir += glm::normalize(glm::cross(camera.front, camera.up));
 
     if (glm::length(moveDir) > 0.0f)
         moveDir = glm::normalize(moveDir);
 
-    float currentSpeed = (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS && glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) ? runSpeed : moveSpeed;
-
+    float currentSpeed = (input.isDown(PlayerInput::Forward) && input.isDown(PlayerInput::Run)) ? runSpeed : moveSpeed;
     float targetFov = (currentSpeed == runSpeed) ? runningFov * runningFovMultiplier : walkFov;
     float fovSmoothSpeed = 10.0f;
     currentFov += (targetFov - currentFov) * fovSmoothSpeed * deltaTime;
@@ -105,14 +150,26 @@ void PlayerController::update(GLFWwindow* window, double deltaTime) {
     JPH::Vec3 inputVel(inputVelocity.x, currentVelocity.GetY(), inputVelocity.z);
 
     bool grounded = isGrounded();
-    bool spacePressed = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
+    bool spacePressed = input.isDown(PlayerInput::Jump);
 
 
     if (spacePressed && grounded) {
         inputVel.SetY(jumpVelocity);
     }
 
-    if (grounded && !spacePressed) {
+    // Knockback rides on top of walking, which would otherwise overwrite it every tick.
+    // The upward part keeps lifting until the player is off the ground, gravity takes over from there.
+    bool launched = mKnockback.y > 0.0f;
+    inputVel += JPH::Vec3(mKnockback.x, 0.0f, mKnockback.z);
+    if (launched)
+        inputVel.SetY(std::max(inputVel.GetY(), mKnockback.y));
+    if (!grounded)
+        mKnockback.y = 0.0f;
+    mKnockback *= std::exp(-cKnockbackDamping * (float)deltaTime);
+    if (glm::dot(mKnockback, mKnockback) < 0.01f)
+        mKnockback = glm::vec3(0.0f);
+
+    if (grounded && !spacePressed && !launched) {
         inputVel.SetY(0); // Cancel falling when on ground, doesn't entirely prevent the player from slowly falling through the florr until Y = 0.3
 
         //disable gravity when grounded to fix the problem
@@ -136,16 +193,31 @@ void PlayerController::update(GLFWwindow* window, double deltaTime) {
     position.z = playerPos.GetZ();
 
 
-	if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) {
+    if (weapons && input.weaponSlot != weaponSlot && input.weaponSlot < weapons->size()) {
+        weaponSlot = input.weaponSlot;
+        gun.equip((*weapons)[weaponSlot]);
+    }
+
+	if (input.isDown(PlayerInput::Reload)) {
         gun.reload();
 	}
 
-    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
+    if (input.isDown(PlayerInput::Fire)) {
         gun.requestFire();
+    }
+    if (input.isDown(PlayerInput::AltFire)) {
+        gun.requestAltFire();
     }
 	gun.update(camera.position, camera.front, physics.floorBodyID, deltaTime);
 }
 
+void PlayerController::setWeaponTable(const WeaponTable* inWeapons) {
+    weapons = inWeapons;
+    weaponSlot = 0;
+    if (weapons && weapons->size() > 0)
+        gun.equip((*weapons)[0]);
+}
+
 void PlayerController::processMouse(double xpos, double ypos) {
 
     if (firstMouse) {
@@ -173,3 +245,19 @@ void PlayerController::processMouse(double xpos, double ypos) {
 glm::mat4 PlayerController::getViewMatrix() const {
     return camera.getViewMatrix();
 }
+
+
+void PlayerController::hashState(StateHasher& hasher) const {
+    hasher.add(position.x);
+    hasher.add(position.y);
+    hasher.add(position.z);
+    // The simulated view angles; yaw/pitch only follow the live mouse, which replays skip
+    hasher.add(lastInput.yaw);
+    hasher.add(lastInput.pitch);
+    hasher.add(currentFov);
+    hasher.add(weaponSlot);
+    hasher.add(mKnockback.x);
+    hasher.add(mKnockback.y);
+    hasher.add(mKnockback.z);
+    gun.hashState(hasher);
+}
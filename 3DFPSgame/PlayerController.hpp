@@ -4,6 +4,7 @@
 #include "Camera.hpp"
 #include "Physics.hpp"
 #include "Gun.hpp"
+#include "PlayerInput.hpp"
 
 #include <glm/glm.hpp>
 #include <GLFW/glfw3.h>
@@ -17,9 +18,25 @@ public:
 
     ~PlayerController() = default;
     void update(GLFWwindow* window, double deltaTime);
+    void update(const PlayerInput& input, double deltaTime);
     void processMouse(double xpos, double ypos);
 
+    PlayerInput sampleInput(GLFWwindow* window) const;
+    void setProjectileSystem(ProjectileSystem* projectiles) { gun.setProjectileSystem(projectiles); }
+    void setVerbose(bool verbose) { gun.setVerbose(verbose); }
+
+    // Equips slot 0; input.weaponSlot switches between the table's entries after that
+    void setWeaponTable(const WeaponTable* inWeapons);
+    void hashState(StateHasher& hasher) const;
+    // Pushes the player; the upward part launches them, the sideways part fades over a few ticks
+    void addKnockback(const glm::vec3& velocity) { mKnockback += velocity; }
+
     bool isGrounded();
+    JPH::BodyID getBodyID() const { return playerBodyID; }
+    // False when physics was out of bodies; such a player must not be simulated
+    bool hasBody() const { return !playerBodyID.IsInvalid(); }
+    // Distance from position (the capsule center) down to the feet
+    float getFootOffset() const { return mPlayerHeight * 0.5f + mPlayerRadius; }
 
     bool firstMouse = true;
     double lastX = 0.0f, lastY = 0.0f;
@@ -29,6 +46,7 @@ public:
     glm::vec3 startPos = glm::vec3(0.0f, 10.0f, 0.0f);
 
     glm::vec3 position = startPos;
+    PlayerInput lastInput;  // what the last update acted on, for match recording
     glm::mat4 getViewMatrix() const;
 
     float currentFov = 80.0f;
@@ -37,6 +55,8 @@ private:
     Physics& physics;
     Camera camera;
     Gun gun;
+    const WeaponTable* weapons = nullptr;
+    uint8_t weaponSlot = 0;
 
     float moveSpeed = 2.5f;
 	float forwardSpeed = 2.5f;
@@ -58,6 +78,9 @@ private:
 
     float mGroundSensorRadius = 0.1f; // meters
 
+    glm::vec3 mKnockback = glm::vec3(0.0f); // m/s on top of walking, from explosions
+    static constexpr float cKnockbackDamping = 4.0f; // 1/s
+
 	float walkFov = 80.0f;
     float runningFov = 83.0f;
     float runningFovMultiplier = 1.0f;
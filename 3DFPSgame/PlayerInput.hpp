@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+// One tick worth of player intent, decoupled from GLFW so it can be recorded,
+// replayed and produced by non-keyboard drivers.
+struct PlayerInput {
+    enum Button : uint16_t {
+        Forward = 1 << 0,
+        Back    = 1 << 1,
+        Left    = 1 << 2,
+        Right   = 1 << 3,
+        Run     = 1 << 4,
+        Jump    = 1 << 5,
+        Fire    = 1 << 6,
+        Reload  = 1 << 7,
+        AltFire = 1 << 8
+    };
+
+    uint16_t buttons = 0;
+    float yaw = -90.0f;  // degrees, absolute view angles
+    float pitch = 0.0f;
+    uint8_t weaponSlot = 0;  // index into the WeaponTable
+
+    bool isDown(Button button) const { return (buttons & button) != 0; }
+    void press(Button button) { buttons |= button; }
+};
@@ -0,0 +1,204 @@
+#include "Projectiles.hpp"
+#include "Determinism.hpp"
+
+#include <algorithm>
+
+using namespace JPH;
+
+ProjectileSystem::ProjectileSystem(Physics& inPhysics)
+    : mPhysics(inPhysics) {
+    reserve(256);
+}
+
+void ProjectileSystem::reserve(size_t capacity) {
+    capacity = (capacity + 3) & ~size_t(3);
+    if (capacity <= mPosX.size())
+        return;
+
+    for (std::vector<float>* column : { &mPosX, &mPosY, &mPosZ, &mPrevX, &mPrevY, &mPrevZ,
+        &mVelX, &mVelY, &mVelZ, &mDrag, &mGravity, &mLife, &mDamage, &mExplosionRadius, &mHitFraction }) {
+        column->resize(capacity, 0.0f);
+    }
+    mOwner.resize(capacity);
+    mHitWorldBody.resize(capacity);
+    mHitVictim.resize(capacity);
+    mHitZone.resize(capacity, HitZone::Torso);
+}
+
+void ProjectileSystem::spawn(const glm::vec3& origin, const glm::vec3& direction, const ProjectileParams& params, BodyID ownerBodyID) {
+    if (mCount == mPosX.size())
+        reserve(mPosX.size() * 2);
+
+    glm::vec3 velocity = glm::normalize(direction) * params.speed;
+    size_t i = mCount++;
+    mPosX[i] = mPrevX[i] = origin.x;
+    mPosY[i] = mPrevY[i] = origin.y;
+    mPosZ[i] = mPrevZ[i] = origin.z;
+    mVelX[i] = velocity.x;
+    mVelY[i] = velocity.y;
+    mVelZ[i] = velocity.z;
+    mDrag[i] = params.drag;
+    mGravity[i] = params.gravityScale;
+    mLife[i] = params.lifetime;
+    mDamage[i] = params.damage;
+    mExplosionRadius[i] = params.explosionRadius;
+    mOwner[i] = ownerBodyID;
+}
+
+void ProjectileSystem::update(float deltaTime) {
+    mImpacts.clear();
+    if (mCount == 0)
+        return;
+
+    integrate(deltaTime);
+
+    if (mCount <= cSweepBatchSize) {
+        sweep(0, mCount);
+    }
+    else {
+        // Each job owns a disjoint slice of the result arrays, so no locking
+        JobSystem& jobSystem = mPhysics.getJobSystem();
+        JobSystem::Barrier* barrier = jobSystem.CreateBarrier();
+        for (size_t begin = 0; begin < mCount; begin += cSweepBatchSize) {
+            size_t end = std::min(begin + cSweepBatchSize, mCount);
+            JobHandle job = jobSystem.CreateJob("SweepProjectiles", Color::sOrange, [this, begin, end]() {
+                sweep(begin, end);
+            });
+            barrier->AddJob(job);
+        }
+        jobSystem.WaitForJobs(barrier);
+        jobSystem.DestroyBarrier(barrier);
+    }
+
+    resolve();
+}
+
+void ProjectileSystem::integrate(float deltaTime) {
+    Vec3 gravity = mPhysics.getPhysicsSystem().GetGravity();
+    Vec4 dt = Vec4::sReplicate(deltaTime);
+    Vec4 gravityX = Vec4::sReplicate(gravity.GetX());
+    Vec4 gravityY = Vec4::sReplicate(gravity.GetY());
+    Vec4 gravityZ = Vec4::sReplicate(gravity.GetZ());
+
+    // Semi-implicit Euler with quadratic drag: a = g * scale - drag * |v| * v
+    for (size_t i = 0; i < mCount; i += 4) {
+        Vec4 px = Vec4::sLoadFloat4(reinterpret_cast<const Float4*>(&mPosX[i]));
+        Vec4 py = Vec4::sLoadFloat4(reinterpret_cast<const Float4*>(&mPosY[i]));
+        Vec4 pz = Vec4::sLoadFloat4(reinterpret_cast<const Float4*>(&mPosZ[i]));
+        Vec4 vx = Vec4::sLoadFloat4(reinterpret_cast<const Float4*>(&mVelX[i]));
+        Vec4 vy = Vec4::sLoadFloat4(reinterpret_cast<const Float4*>(&mVelY[i]));
+        Vec4 vz = Vec4::sLoadFloat4(reinterpret_cast<const Float4*>(&mVelZ[i]));
+        Vec4 drag = Vec4::sLoadFloat4(reinterpret_cast<const Float4*>(&mDrag[i]));
+        Vec4 scale = Vec4::sLoadFloat4(reinterpret_cast<const Float4*>(&mGravity[i]));
+        Vec4 life = Vec4::sLoadFloat4(reinterpret_cast<const Float4*>(&mLife[i]));
+
+        px.StoreFloat4(reinterpret_cast<Float4*>(&mPrevX[i]));
+        py.StoreFloat4(reinterpret_cast<Float4*>(&mPrevY[i]));
+        pz.StoreFloat4(reinterpret_cast<Float4*>(&mPrevZ[i]));
+
+        Vec4 speed = (vx * vx + vy * vy + vz * vz).Sqrt();
+        Vec4 dragFactor = drag * speed;
+
+        vx += (gravityX * scale - dragFactor * vx) * dt;
+        vy += (gravityY * scale - dragFactor * vy) * dt;
+        vz += (gravityZ * scale - dragFactor * vz) * dt;
+
+        px += vx * dt;
+        py += vy * dt;
+        pz += vz * dt;
+        life -= dt;
+
+        px.StoreFloat4(reinterpret_cast<Float4*>(&mPosX[i]));
+        py.StoreFloat4(reinterpret_cast<Float4*>(&mPosY[i]));
+        pz.StoreFloat4(reinterpret_cast<Float4*>(&mPosZ[i]));
+        vx.StoreFloat4(reinterpret_cast<Float4*>(&mVelX[i]));
+        vy.StoreFloat4(reinterpret_cast<Float4*>(&mVelY[i]));
+        vz.StoreFloat4(reinterpret_cast<Float4*>(&mVelZ[i]));
+        life.StoreFloat4(reinterpret_cast<Float4*>(&mLife[i]));
+    }
+}
+
+void ProjectileSystem::sweep(size_t begin, size_t end) {
+    const NarrowPhaseQuery& query = mPhysics.getPhysicsSystem().GetNarrowPhaseQuery();
+    const HitboxSystem& hitboxes = mPhysics.getHitboxes();
+
+    for (size_t i = begin; i < end; i++) {
+        mHitFraction[i] = 1.0f;
+        mHitWorldBody[i] = BodyID();
+        mHitVictim[i] = BodyID();
+
+        RRayCast ray(
+            RVec3(mPrevX[i], mPrevY[i], mPrevZ[i]),
+            Vec3(mPosX[i] - mPrevX[i], mPosY[i] - mPrevY[i], mPosZ[i] - mPrevZ[i]));
+
+        IgnoreSingleBodyFilter bodyFilter(mOwner[i]);
+        RayCastResult worldHit;
+        if (query.CastRay(ray, worldHit, mWorldFilter.broadPhase, mWorldFilter.object, bodyFilter)) {
+            mHitFraction[i] = worldHit.mFraction;
+            mHitWorldBody[i] = worldHit.mBodyID;
+        }
+
+        HitboxHit playerHit;
+        if (hitboxes.castRay(ray, mHitFraction[i], mOwner[i], playerHit)) {
+            mHitFraction[i] = playerHit.fraction;
+            mHitWorldBody[i] = BodyID();
+            mHitVictim[i] = playerHit.ownerBodyID;
+            mHitZone[i] = playerHit.zone;
+        }
+    }
+}
+
+void ProjectileSystem::resolve() {
+    // Walk backwards so swap-removal never skips an element
+    for (size_t i = mCount; i-- > 0;) {
+        bool hit = !mHitWorldBody[i].IsInvalid() || !mHitVictim[i].IsInvalid();
+        if (hit) {
+            float t = mHitFraction[i];
+            ProjectileImpact impact;
+            impact.position = glm::vec3(
+                mPrevX[i] + (mPosX[i] - mPrevX[i]) * t,
+                mPrevY[i] + (mPosY[i] - mPrevY[i]) * t,
+                mPrevZ[i] + (mPosZ[i] - mPrevZ[i]) * t);
+            impact.ownerBodyID = mOwner[i];
+            impact.worldBodyID = mHitWorldBody[i];
+            impact.victimBodyID = mHitVictim[i];
+            impact.zone = mHitZone[i];
+            impact.damage = mDamage[i];
+            if (!mHitVictim[i].IsInvalid())
+                impact.damage *= HitboxSystem::damageMultiplier(mHitZone[i]);
+            impact.explosionRadius = mExplosionRadius[i];
+            mImpacts.push_back(impact);
+        }
+
+        if (hit || mLife[i] <= 0.0f)
+            removeAt(i);
+    }
+}
+
+void ProjectileSystem::removeAt(size_t index) {
+    size_t last = --mCount;
+    if (index != last) {
+        mPosX[index] = mPosX[last]; mPosY[index] = mPosY[last]; mPosZ[index] = mPosZ[last];
+        mPrevX[index] = mPrevX[last]; mPrevY[index] = mPrevY[last]; mPrevZ[index] = mPrevZ[last];
+        mVelX[index] = mVelX[last]; mVelY[index] = mVelY[last]; mVelZ[index] = mVelZ[last];
+        mDrag[index] = mDrag[last];
+        mGravity[index] = mGravity[last];
+        mLife[index] = mLife[last];
+        mDamage[index] = mDamage[last];
+        mExplosionRadius[index] = mExplosionRadius[last];
+        mOwner[index] = mOwner[last];
+    }
+
+    // Keep dead lanes finite so the SIMD loop never chews on NaNs
+    mPosX[last] = mPosY[last] = mPosZ[last] = 0.0f;
+    mVelX[last] = mVelY[last] = mVelZ[last] = 0.0f;
+}
+
+void ProjectileSystem::hashState(StateHasher& hasher) const {
+    hasher.add(mCount);
+    for (size_t i = 0; i < mCount; i++) {
+        hasher.add(mPosX[i]); hasher.add(mPosY[i]); hasher.add(mPosZ[i]);
+        hasher.add(mVelX[i]); hasher.add(mVelY[i]); hasher.add(mVelZ[i]);
+        hasher.add(mLife[i]);
+    }
+}
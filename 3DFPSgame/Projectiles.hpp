@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Physics.hpp"
+#include "Hitboxes.hpp"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+class StateHasher;
+
+struct ProjectileParams {
+    float speed = 30.0f;          // m/s at the muzzle
+    float drag = 0.0f;            // quadratic drag coefficient, per meter
+    float gravityScale = 1.0f;
+    float lifetime = 5.0f;        // seconds before it is dropped without hitting anything
+    float damage = 10.0f;
+    float explosionRadius = 0.0f; // 0 for plain bullets
+};
+
+struct ProjectileImpact {
+    glm::vec3 position;
+    JPH::BodyID ownerBodyID;      // who fired it
+    JPH::BodyID worldBodyID;      // set when it hit the world
+    JPH::BodyID victimBodyID;     // set when it hit a player's hitbox
+    HitZone zone = HitZone::Torso;
+    float damage = 0.0f;
+    float explosionRadius = 0.0f;
+};
+
+// All in-flight projectiles in flat structure-of-arrays storage. Integration runs
+// four projectiles per SIMD instruction, and the step segments are swept against
+// the world in batches spread over the physics job system. A minigun burst is a
+// handful of array appends, not thousands of objects.
+class ProjectileSystem {
+public:
+    explicit ProjectileSystem(Physics& inPhysics);
+
+    void spawn(const glm::vec3& origin, const glm::vec3& direction, const ProjectileParams& params, JPH::BodyID ownerBodyID);
+    void update(float deltaTime);
+
+    size_t count() const { return mCount; }
+
+    // Impacts produced by the last update
+    const std::vector<ProjectileImpact>& impacts() const { return mImpacts; }
+
+    void hashState(StateHasher& hasher) const;
+
+    // Rays per job; below this everything is swept on the calling thread
+    static constexpr size_t cSweepBatchSize = 128;
+
+private:
+    void reserve(size_t capacity);
+    void integrate(float deltaTime);
+    void sweep(size_t begin, size_t end);
+    void resolve();
+    void removeAt(size_t index);
+
+    Physics& mPhysics;
+    QueryFilter mWorldFilter{ QueryLayers::HITSCAN };
+
+    size_t mCount = 0;
+
+    // Kinematic state, sized to a multiple of 4 so the SIMD loop never needs a tail
+    std::vector<float> mPosX, mPosY, mPosZ;
+    std::vector<float> mPrevX, mPrevY, mPrevZ;
+    std::vector<float> mVelX, mVelY, mVelZ;
+    std::vector<float> mDrag, mGravity, mLife;
+
+    // Cold data, only read when something hits
+    std::vector<float> mDamage, mExplosionRadius;
+    std::vector<JPH::BodyID> mOwner;
+
+    // Sweep results, written by the jobs, one slot per projectile
+    std::vector<float> mHitFraction;
+    std::vector<JPH::BodyID> mHitWorldBody;
+    std::vector<JPH::BodyID> mHitVictim;
+    std::vector<HitZone> mHitZone;
+
+    std::vector<ProjectileImpact> mImpacts;
+};
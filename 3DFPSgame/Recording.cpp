@@ -0,0 +1,385 @@
+#include "Recording.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+static constexpr char cMatchMagic[4] = { 'F', 'P', 'S', 'M' };
+static constexpr char cIndexMagic[4] = { 'F', 'P', 'S', 'X' };
+static constexpr uint32_t cMatchVersion = 1;
+
+namespace {
+
+// Each actor is seven quantized ints; a tick stores a mask of the ones that
+// changed and their differences
+enum Field { PosX, PosY, PosZ, Yaw, Pitch, Buttons, WeaponSlot, FieldCount };
+
+constexpr float cPositionScale = 1024.0f;           // ~1 mm
+constexpr float cAngleScale = 65536.0f / 360.0f;    // yaw wraps at 16 bits
+constexpr float cRadiusScale = 64.0f;
+
+struct ChunkHeader {
+    uint32_t firstTick;
+    uint32_t tickCount;
+    uint32_t size;
+};
+
+struct IndexTrailer {
+    uint64_t indexOffset;
+    uint32_t chunkCount;
+    char magic[4];
+};
+
+void quantize(const ActorFrame& frame, int32_t* out) {
+    out[PosX] = (int32_t)std::lround(frame.position.x * cPositionScale);
+    out[PosY] = (int32_t)std::lround(frame.position.y * cPositionScale);
+    out[PosZ] = (int32_t)std::lround(frame.position.z * cPositionScale);
+    float yaw = std::fmod(frame.yaw, 360.0f);
+    if (yaw < 0.0f)
+        yaw += 360.0f;
+    out[Yaw] = (int32_t)std::lround(yaw * cAngleScale) & 0xFFFF;
+    out[Pitch] = (int32_t)std::lround(frame.pitch * cAngleScale);
+    out[Buttons] = frame.buttons;
+    out[WeaponSlot] = frame.weaponSlot;
+}
+
+ActorFrame dequantize(const int32_t* fields) {
+    ActorFrame frame;
+    frame.position = glm::vec3(fields[PosX], fields[PosY], fields[PosZ]) / cPositionScale;
+    frame.yaw = fields[Yaw] / cAngleScale;
+    frame.pitch = fields[Pitch] / cAngleScale;
+    frame.buttons = (uint16_t)fields[Buttons];
+    frame.weaponSlot = (uint8_t)fields[WeaponSlot];
+    return frame;
+}
+
+void writeVarint(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+void writeSigned(std::vector<uint8_t>& out, int32_t value) {
+    writeVarint(out, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+bool readVarint(const std::vector<uint8_t>& in, size_t& cursor, uint32_t& outValue) {
+    outValue = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (cursor >= in.size())
+            return false;
+        uint8_t byte = in[cursor++];
+        outValue |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+bool readSigned(const std::vector<uint8_t>& in, size_t& cursor, int32_t& outValue) {
+    uint32_t raw;
+    if (!readVarint(in, cursor, raw))
+        return false;
+    outValue = (int32_t)(raw >> 1) ^ -(int32_t)(raw & 1);
+    return true;
+}
+
+// Yaw differences take the short way round the 16-bit circle
+int32_t fieldDelta(int field, int32_t current, int32_t previous) {
+    if (field == Yaw)
+        return (int16_t)(uint16_t)(current - previous);
+    return current - previous;
+}
+
+int32_t applyDelta(int field, int32_t previous, int32_t delta) {
+    if (field == Yaw)
+        return (previous + delta) & 0xFFFF;
+    return previous + delta;
+}
+
+}
+
+void interpolateActors(const std::vector<ActorFrame>& from, const std::vector<ActorFrame>& to, float t,
+    std::vector<ActorFrame>& outFrames) {
+    outFrames = to;
+    size_t shared = std::min(from.size(), to.size());
+    for (size_t i = 0; i < shared; i++) {
+        float yawStep = std::fmod(to[i].yaw - from[i].yaw + 540.0f, 360.0f) - 180.0f;
+        outFrames[i].position = glm::mix(from[i].position, to[i].position, t);
+        outFrames[i].yaw = from[i].yaw + yawStep * t;
+        outFrames[i].pitch = glm::mix(from[i].pitch, to[i].pitch, t);
+    }
+}
+
+MatchRecorder::~MatchRecorder() {
+    close();
+}
+
+bool MatchRecorder::open(const std::string& path, float inTickRate, uint32_t inChunkTicks) {
+    mFile.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!mFile) {
+        std::cout << "Failed to open match recording: " << path << std::endl;
+        return false;
+    }
+    mChunkTicks = std::max(inChunkTicks, 1u);
+    mTick = 0;
+    mIndex.clear();
+    mChunk.clear();
+    mChunkTickCount = 0;
+
+    mFile.write(cMatchMagic, sizeof(cMatchMagic));
+    mFile.write(reinterpret_cast<const char*>(&cMatchVersion), sizeof(cMatchVersion));
+    mFile.write(reinterpret_cast<const char*>(&inTickRate), sizeof(inTickRate));
+    mFile.write(reinterpret_cast<const char*>(&mChunkTicks), sizeof(mChunkTicks));
+    mBytesWritten = sizeof(cMatchMagic) + sizeof(cMatchVersion) + sizeof(inTickRate) + sizeof(mChunkTicks);
+    return true;
+}
+
+void MatchRecorder::record(const std::vector<ActorFrame>& actors, const std::vector<MatchEvent>& events) {
+    if (!mFile.is_open())
+        return;
+
+    // Every chunk opens on a keyframe, so it decodes without its predecessors
+    if (mChunkTickCount == 0) {
+        mChunkFirstTick = mTick;
+        mPrevious.clear();
+    }
+    mPrevious.resize(actors.size() * FieldCount, 0);
+
+    writeVarint(mChunk, (uint32_t)actors.size());
+    int32_t fields[FieldCount];
+    for (size_t a = 0; a < actors.size(); a++) {
+        quantize(actors[a], fields);
+        int32_t* previous = &mPrevious[a * FieldCount];
+
+        uint8_t mask = 0;
+        for (int f = 0; f < FieldCount; f++) {
+            if (fields[f] != previous[f])
+                mask |= 1 << f;
+        }
+        mChunk.push_back(mask);
+        for (int f = 0; f < FieldCount; f++) {
+            if (mask & (1 << f))
+                writeSigned(mChunk, fieldDelta(f, fields[f], previous[f]));
+            previous[f] = fields[f];
+        }
+    }
+
+    writeVarint(mChunk, (uint32_t)events.size());
+    for (const MatchEvent& event : events) {
+        mChunk.push_back(event.type);
+        writeSigned(mChunk, (int32_t)std::lround(event.position.x * cPositionScale));
+        writeSigned(mChunk, (int32_t)std::lround(event.position.y * cPositionScale));
+        writeSigned(mChunk, (int32_t)std::lround(event.position.z * cPositionScale));
+        writeVarint(mChunk, (uint32_t)std::lround(std::max(event.radius, 0.0f) * cRadiusScale));
+    }
+
+    mTick++;
+    if (++mChunkTickCount == mChunkTicks)
+        flushChunk();
+}
+
+void MatchRecorder::flushChunk() {
+    if (mChunkTickCount == 0)
+        return;
+
+    ChunkHeader header{ mChunkFirstTick, mChunkTickCount, (uint32_t)mChunk.size() };
+    mIndex.push_back({ mChunkFirstTick, mChunkTickCount, mBytesWritten });
+    mFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    mFile.write(reinterpret_cast<const char*>(mChunk.data()), (std::streamsize)mChunk.size());
+    mBytesWritten += sizeof(header) + mChunk.size();
+
+    mChunk.clear();
+    mChunkTickCount = 0;
+}
+
+void MatchRecorder::close() {
+    if (!mFile.is_open())
+        return;
+
+    flushChunk();
+    IndexTrailer trailer{ mBytesWritten, (uint32_t)mIndex.size(), {} };
+    std::memcpy(trailer.magic, cIndexMagic, sizeof(cIndexMagic));
+    for (const ChunkEntry& entry : mIndex) {
+        mFile.write(reinterpret_cast<const char*>(&entry.firstTick), sizeof(entry.firstTick));
+        mFile.write(reinterpret_cast<const char*>(&entry.tickCount), sizeof(entry.tickCount));
+        mFile.write(reinterpret_cast<const char*>(&entry.offset), sizeof(entry.offset));
+    }
+    mFile.write(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+    mFile.close();
+
+    std::cout << "Recorded " << mTick << " ticks in " << mBytesWritten / 1024 << " KiB" << std::endl;
+}
+
+bool MatchPlayer::open(const std::string& path) {
+    mFile.open(path, std::ios::in | std::ios::binary);
+    if (!mFile) {
+        std::cout << "Failed to open match recording: " << path << std::endl;
+        return false;
+    }
+
+    char magic[4] = {};
+    uint32_t version = 0;
+    uint32_t chunkTicks = 0;
+    mFile.read(magic, sizeof(magic));
+    mFile.read(reinterpret_cast<char*>(&version), sizeof(version));
+    mFile.read(reinterpret_cast<char*>(&mTickRate), sizeof(mTickRate));
+    mFile.read(reinterpret_cast<char*>(&chunkTicks), sizeof(chunkTicks));
+    if (!mFile || std::memcmp(magic, cMatchMagic, sizeof(magic)) != 0 || version != cMatchVersion) {
+        std::cout << "Match recording has an unknown format: " << path << std::endl;
+        mFile.close();
+        return false;
+    }
+
+    if (!readIndex() && !scanChunks()) {
+        std::cout << "Match recording has no readable chunks: " << path << std::endl;
+        mFile.close();
+        return false;
+    }
+    mTickCount = mIndex.back().firstTick + mIndex.back().tickCount;
+    mChunk = SIZE_MAX;
+    return seek(0);
+}
+
+bool MatchPlayer::readIndex() {
+    IndexTrailer trailer;
+    mFile.clear();
+    mFile.seekg(-(std::streamoff)sizeof(trailer), std::ios::end);
+    if (!mFile.read(reinterpret_cast<char*>(&trailer), sizeof(trailer))
+        || std::memcmp(trailer.magic, cIndexMagic, sizeof(cIndexMagic)) != 0 || trailer.chunkCount == 0)
+        return false;
+
+    mFile.seekg((std::streamoff)trailer.indexOffset);
+    mIndex.resize(trailer.chunkCount);
+    for (ChunkEntry& entry : mIndex) {
+        mFile.read(reinterpret_cast<char*>(&entry.firstTick), sizeof(entry.firstTick));
+        mFile.read(reinterpret_cast<char*>(&entry.tickCount), sizeof(entry.tickCount));
+        mFile.read(reinterpret_cast<char*>(&entry.offset), sizeof(entry.offset));
+    }
+    if (!mFile) {
+        mIndex.clear();
+        return false;
+    }
+    return true;
+}
+
+// Recovery for files whose recorder never got to close()
+bool MatchPlayer::scanChunks() {
+    mIndex.clear();
+    mFile.clear();
+    mFile.seekg(0, std::ios::end);
+    uint64_t fileSize = (uint64_t)mFile.tellg();
+    uint64_t offset = sizeof(cMatchMagic) + sizeof(cMatchVersion) + sizeof(mTickRate) + sizeof(uint32_t);
+    mFile.seekg((std::streamoff)offset);
+
+    // Stops at the first chunk that doesn't follow on or doesn't fit, e.g. one cut short by a crash
+    ChunkHeader header;
+    while (mFile.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        uint32_t expectedTick = mIndex.empty() ? 0 : mIndex.back().firstTick + mIndex.back().tickCount;
+        if (header.firstTick != expectedTick || header.tickCount == 0 || offset + sizeof(header) + header.size > fileSize)
+            break;
+        mIndex.push_back({ header.firstTick, header.tickCount, offset });
+        offset += sizeof(header) + header.size;
+        mFile.seekg((std::streamoff)offset);
+    }
+    mFile.clear();
+
+    if (!mIndex.empty())
+        std::cout << "Match recording has no index, recovered " << mIndex.size() << " chunks" << std::endl;
+    return !mIndex.empty();
+}
+
+bool MatchPlayer::loadChunk(size_t chunk) {
+    ChunkHeader header;
+    mFile.clear();
+    mFile.seekg((std::streamoff)mIndex[chunk].offset);
+    if (!mFile.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+    mChunkData.resize(header.size);
+    if (!mFile.read(reinterpret_cast<char*>(mChunkData.data()), header.size))
+        return false;
+
+    mChunk = chunk;
+    mCursor = 0;
+    mState.clear();
+    return true;
+}
+
+bool MatchPlayer::decodeTick() {
+    uint32_t actorCount;
+    if (!readVarint(mChunkData, mCursor, actorCount))
+        return false;
+    mState.resize((size_t)actorCount * FieldCount, 0);
+    mActors.resize(actorCount);
+
+    for (uint32_t a = 0; a < actorCount; a++) {
+        if (mCursor >= mChunkData.size())
+            return false;
+        uint8_t mask = mChunkData[mCursor++];
+        int32_t* fields = &mState[(size_t)a * FieldCount];
+        for (int f = 0; f < FieldCount; f++) {
+            int32_t delta;
+            if (!(mask & (1 << f)))
+                continue;
+            if (!readSigned(mChunkData, mCursor, delta))
+                return false;
+            fields[f] = applyDelta(f, fields[f], delta);
+        }
+        mActors[a] = dequantize(fields);
+    }
+
+    uint32_t eventCount;
+    if (!readVarint(mChunkData, mCursor, eventCount))
+        return false;
+    mEvents.resize(eventCount);
+    for (MatchEvent& event : mEvents) {
+        int32_t x, y, z;
+        uint32_t radius;
+        if (mCursor >= mChunkData.size())
+            return false;
+        event.type = (MatchEvent::Type)mChunkData[mCursor++];
+        if (!readSigned(mChunkData, mCursor, x) || !readSigned(mChunkData, mCursor, y)
+            || !readSigned(mChunkData, mCursor, z) || !readVarint(mChunkData, mCursor, radius))
+            return false;
+        event.position = glm::vec3(x, y, z) / cPositionScale;
+        event.radius = radius / cRadiusScale;
+    }
+    return true;
+}
+
+bool MatchPlayer::seek(uint32_t tick) {
+    if (tick >= mTickCount)
+        return false;
+
+    auto chunk = std::upper_bound(mIndex.begin(), mIndex.end(), tick,
+        [](uint32_t value, const ChunkEntry& entry) { return value < entry.firstTick; }) - 1;
+    size_t chunkIndex = (size_t)(chunk - mIndex.begin());
+
+    // Moving forward inside the loaded chunk carries on from where we are
+    uint32_t from;
+    if (chunkIndex == mChunk && tick > mTick) {
+        from = mTick + 1;
+    }
+    else {
+        if (!loadChunk(chunkIndex))
+            return false;
+        from = chunk->firstTick;
+    }
+
+    for (uint32_t t = from; t <= tick; t++) {
+        if (!decodeTick()) {
+            std::cout << "Match recording is corrupt at tick " << t << std::endl;
+            mChunk = SIZE_MAX;
+            return false;
+        }
+    }
+    mTick = tick;
+    return true;
+}
+
+bool MatchPlayer::step() {
+    return seek(mTick + 1);
+}
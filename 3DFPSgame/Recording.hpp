@@ -0,0 +1,121 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// One actor's visible state for a tick. Actor 0 is the local player and bots
+// follow in spawn order, as in resolveExplosions. The Fire, AltFire and Reload
+// bits of buttons are the gun events; playback derives shots from them.
+struct ActorFrame {
+    glm::vec3 position = glm::vec3(0.0f);  // capsule center, same as PlayerController::position
+    float yaw = -90.0f;
+    float pitch = 0.0f;
+    uint16_t buttons = 0;
+    uint8_t weaponSlot = 0;
+};
+
+struct MatchEvent {
+    enum Type : uint8_t {
+        Impact = 1,  // projectile hit, radius > 0 for explosions
+    };
+
+    Type type = Impact;
+    glm::vec3 position = glm::vec3(0.0f);
+    float radius = 0.0f;
+};
+
+// Blends two ticks for smooth playback, yaw along the shorter way round
+void interpolateActors(const std::vector<ActorFrame>& from, const std::vector<ActorFrame>& to, float t,
+    std::vector<ActorFrame>& outFrames);
+
+// Match files are a run of chunks followed by a keyframe index. Each chunk
+// holds chunkTicks ticks; its first tick is a keyframe against an all-zero
+// state and every later tick stores only the quantized fields that changed,
+// as zigzag varints. An idle actor costs one byte a tick. The index at the end
+// lets a player seek anywhere by decoding at most one chunk. A file cut off
+// before the index is still readable by walking the chunk headers.
+class MatchRecorder {
+public:
+    ~MatchRecorder();
+
+    bool open(const std::string& path, float inTickRate, uint32_t inChunkTicks = 64);
+    bool isOpen() const { return mFile.is_open(); }
+
+    // Appends one tick; chunks go to disk as they fill
+    void record(const std::vector<ActorFrame>& actors, const std::vector<MatchEvent>& events);
+
+    // Flushes the last chunk and writes the index
+    void close();
+
+    uint32_t tickCount() const { return mTick; }
+    uint64_t bytesWritten() const { return mBytesWritten; }
+
+private:
+    struct ChunkEntry {
+        uint32_t firstTick;
+        uint32_t tickCount;
+        uint64_t offset;
+    };
+
+    void flushChunk();
+
+    std::ofstream mFile;
+    uint32_t mChunkTicks = 64;
+    uint32_t mTick = 0;
+    uint64_t mBytesWritten = 0;
+
+    std::vector<uint8_t> mChunk;
+    uint32_t mChunkFirstTick = 0;
+    uint32_t mChunkTickCount = 0;
+    std::vector<ChunkEntry> mIndex;
+    std::vector<int32_t> mPrevious;  // quantized fields of the last tick, see Recording.cpp
+};
+
+class MatchPlayer {
+public:
+    bool open(const std::string& path);
+    bool isOpen() const { return mFile.is_open(); }
+
+    float tickRate() const { return mTickRate; }
+    uint32_t tickCount() const { return mTickCount; }
+    uint32_t currentTick() const { return mTick; }
+
+    // Decodes from the chunk's keyframe to tick; false if past the end
+    bool seek(uint32_t tick);
+
+    // Moves to the next tick; false at the end of the match
+    bool step();
+
+    const std::vector<ActorFrame>& actors() const { return mActors; }
+    const std::vector<MatchEvent>& events() const { return mEvents; }
+
+private:
+    struct ChunkEntry {
+        uint32_t firstTick;
+        uint32_t tickCount;
+        uint64_t offset;
+    };
+
+    bool readIndex();
+    bool scanChunks();
+    bool loadChunk(size_t chunk);
+    bool decodeTick();
+
+    std::ifstream mFile;
+    float mTickRate = 60.0f;
+    uint32_t mTickCount = 0;
+    std::vector<ChunkEntry> mIndex;
+
+    size_t mChunk = SIZE_MAX;
+    std::vector<uint8_t> mChunkData;
+    size_t mCursor = 0;
+    uint32_t mTick = 0;
+
+    std::vector<int32_t> mState;
+    std::vector<ActorFrame> mActors;
+    std::vector<MatchEvent> mEvents;
+};
@@ -0,0 +1,224 @@
+#include "Renderer.hpp"
+#include "Model.hpp"
+#include "Shader.hpp"
+#include "Memory.hpp"
+#include "Overlay.hpp"
+
+#include <GLFW/glfw3.h>
+#include <cstddef>
+#include <cstring>
+
+// Above the units Mesh::draw binds material textures to
+static constexpr int cShadowTextureUnit = 8;
+
+// Lets the driver compile on threads of its own. Shader only reads a program's
+// status at first use, so every program created before then builds in parallel.
+static void enableParallelShaderCompile() {
+    using MaxShaderCompilerThreads = void (APIENTRY*)(GLuint count);
+
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (name == nullptr)
+            continue;
+        const char* function = nullptr;
+        if (std::strcmp(name, "GL_KHR_parallel_shader_compile") == 0)
+            function = "glMaxShaderCompilerThreadsKHR";
+        else if (std::strcmp(name, "GL_ARB_parallel_shader_compile") == 0)
+            function = "glMaxShaderCompilerThreadsARB";
+        if (function == nullptr)
+            continue;
+
+        auto setThreads = reinterpret_cast<MaxShaderCompilerThreads>(glfwGetProcAddress(function));
+        if (setThreads)
+            setThreads(0xFFFFFFFFu);  // as many as the implementation likes
+        return;
+    }
+}
+
+Bounds transformBounds(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& matrix) {
+    glm::vec3 center = glm::vec3(matrix * glm::vec4((localMin + localMax) * 0.5f, 1.0f));
+    glm::vec3 extents = (localMax - localMin) * 0.5f;
+    glm::vec3 worldExtents(0.0f);
+    for (int axis = 0; axis < 3; axis++)
+        worldExtents += glm::abs(glm::vec3(matrix[axis])) * extents[axis];
+    return { center - worldExtents, center + worldExtents };
+}
+
+void RenderPacket::clear() {
+    draws.clear();
+    cameraDraws.clear();
+    shadows.clear();
+    skinMatrices.clear();
+    skinnedVertices.clear();
+    uploads.clear();
+    releases.clear();
+    overlayText.clear();
+    shaderReloads.clear();
+}
+
+void submitDraw(const RenderPacket& packet, const DrawItem& item, const Shader& shader, unsigned int streamVAO, bool depthOnly) {
+    shader.setMat4("model", item.modelMatrix);
+    shader.setBool("skinned", item.skinCount > 0);
+
+    if (item.skinCount > 0)
+        shader.setMat4Array("joints[0]", &packet.skinMatrices[item.skinOffset], (int)item.skinCount);
+
+    if (item.skinnedVertexOffset >= 0)
+        item.model->drawStreamed(streamVAO, item.skinnedVertexOffset, depthOnly);
+    else if (depthOnly)
+        item.model->drawDepth(item.lod);
+    else
+        item.model->draw(item.lod);
+}
+
+Renderer::Renderer(GLFWwindow* inWindow, std::string inVertexPath, std::string inFragmentPath)
+    : mWindow(inWindow),
+    mVertexPath(std::move(inVertexPath)),
+    mFragmentPath(std::move(inFragmentPath)) {
+
+    // A context can only be current on one thread at a time
+    glfwMakeContextCurrent(nullptr);
+    mThread = std::thread(&Renderer::renderLoop, this);
+}
+
+Renderer::~Renderer() {
+    stop();
+}
+
+void Renderer::stop() {
+    if (!mThread.joinable())
+        return;
+
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mCondition.notify_all();
+    mThread.join();
+
+    // Give the context back so shutdown code on this thread can still use GL
+    glfwMakeContextCurrent(mWindow);
+}
+
+void Renderer::submit() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCondition.wait(lock, [this]() { return mPendingIndex < 0 && !mBusy; });
+
+    mPendingIndex = mWriteIndex;
+    mWriteIndex ^= 1;
+    lock.unlock();
+    mCondition.notify_all();
+
+    // The render thread finished with this one before taking the previous submit
+    mPackets[mWriteIndex].clear();
+}
+
+void Renderer::flush() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCondition.wait(lock, [this]() { return mPendingIndex < 0 && !mBusy; });
+}
+
+void Renderer::renderLoop() {
+    MemTagScope tag(MemTag::Render);
+    glfwMakeContextCurrent(mWindow);
+    glEnable(GL_DEPTH_TEST);
+    enableParallelShaderCompile();
+
+    Shader shader(mVertexPath.c_str(), mFragmentPath.c_str());
+    ShadowMap shadowMap("shaders/shadow_depth.vert", "shaders/shadow_depth.frag");
+    TextOverlay overlay("shaders/overlay.vert", "shaders/overlay.frag");
+    createSkinnedStream();
+
+    for (;;) {
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this]() { return mPendingIndex >= 0 || mStopping; });
+            if (mPendingIndex < 0)
+                break;
+            index = mPendingIndex;
+            mPendingIndex = -1;
+            mBusy = true;
+        }
+
+        renderPacket(mPackets[index], shader, shadowMap, overlay);
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mBusy = false;
+            mFramesRendered.fetch_add(1, std::memory_order_relaxed);
+        }
+        mCondition.notify_all();
+    }
+
+    glDeleteVertexArrays(1, &mStreamVAO);
+    glDeleteBuffers(1, &mStreamVBO);
+    glfwMakeContextCurrent(nullptr);
+}
+
+void Renderer::createSkinnedStream() {
+    glGenVertexArrays(1, &mStreamVAO);
+    glGenBuffers(1, &mStreamVBO);
+
+    glBindVertexArray(mStreamVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, mStreamVBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+}
+
+void Renderer::uploadSkinnedVertices(const RenderPacket& packet) {
+    if (packet.skinnedVertices.empty())
+        return;
+
+    // Orphan last frame's storage so the driver doesn't wait for draws still reading it
+    size_t size = packet.skinnedVertices.size() * sizeof(Vertex);
+    glBindBuffer(GL_ARRAY_BUFFER, mStreamVBO);
+    glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, packet.skinnedVertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Renderer::renderPacket(RenderPacket& packet, Shader& shader, ShadowMap& shadowMap, TextOverlay& overlay) {
+    for (const std::string& path : packet.shaderReloads) {
+        for (Shader* program : { &shader, &shadowMap.shader(), &overlay.shader() }) {
+            if (program->usesFile(path))
+                program->reload();
+        }
+    }
+
+    for (const std::shared_ptr<Model>& model : packet.uploads) {
+        if (!model->isUploaded())
+            model->uploadToGPU();
+    }
+
+    uploadSkinnedVertices(packet);
+    shadowMap.render(packet, mStreamVAO);
+
+    if (packet.viewportWidth > 0 && packet.viewportHeight > 0)
+        glViewport(0, 0, packet.viewportWidth, packet.viewportHeight);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    shader.use();
+    shader.setMat4("view", packet.view);
+    shader.setMat4("projection", packet.projection);
+    shadowMap.bind(shader, packet.shadows, cShadowTextureUnit);
+    for (uint32_t index : packet.cameraDraws)
+        submitDraw(packet, packet.draws[index], shader, mStreamVAO, false);
+    overlay.draw(packet.overlayText, packet.viewportWidth, packet.viewportHeight);
+
+    glfwSwapBuffers(mWindow);
+
+    // Nothing from an older packet can still reference these, the previous
+    // frame was finished before this one started
+    for (const std::shared_ptr<Model>& model : packet.releases)
+        model->releaseGPU();
+    packet.releases.clear();
+}
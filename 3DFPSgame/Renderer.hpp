@@ -0,0 +1,131 @@
+#pragma once
+
+#include "Shadows.hpp"
+
+#include <glm/glm.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct GLFWwindow;
+class Model;
+class Shader;
+class ShadowMap;
+class TextOverlay;
+struct Vertex;
+
+// World-space axis aligned box
+struct Bounds {
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+};
+
+// Transforms a local box by an affine matrix, keeping it axis aligned
+Bounds transformBounds(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& matrix);
+
+struct DrawItem {
+    Model* model;          // kept alive by its owner until a packet lists it in releases
+    glm::mat4 modelMatrix;
+    Bounds bounds;
+    uint8_t lod = 0;
+
+    // Skinned draws use either skinCount matrices at skinOffset in skinMatrices
+    // (GPU skinning) or vertices at skinnedVertexOffset in skinnedVertices (CPU)
+    uint32_t skinOffset = 0;
+    uint32_t skinCount = 0;
+    int32_t skinnedVertexOffset = -1;
+
+    bool isSkinned() const { return skinCount > 0 || skinnedVertexOffset >= 0; }
+};
+
+// Everything the render thread needs for one frame, written by the simulation
+// thread and then handed over whole. Vectors are cleared, not freed, between
+// uses, so a steady frame doesn't allocate.
+struct RenderPacket {
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    int viewportWidth = 0;
+    int viewportHeight = 0;
+
+    std::vector<DrawItem> draws;
+    std::vector<uint32_t> cameraDraws;  // indices into draws that survived culling for the main pass
+    ShadowFrame shadows;
+
+    std::vector<glm::mat4> skinMatrices;
+    std::vector<Vertex> skinnedVertices;  // streamed to the GPU once per frame
+
+    // GL work for models streaming in and out. Uploads run before drawing, releases
+    // after, and a released model is dropped only once its GL objects are gone.
+    std::vector<std::shared_ptr<Model>> uploads;
+    std::vector<std::shared_ptr<Model>> releases;
+
+    std::string overlayText;  // drawn over the frame when not empty, see TextOverlay
+    std::vector<std::string> shaderReloads;  // changed shader sources, rebuilt before drawing
+
+    void clear();
+};
+
+// Issues one draw with whatever shader is bound, setting its skinning uniforms.
+// streamVAO reads from the frame's skinnedVertices.
+void submitDraw(const RenderPacket& packet, const DrawItem& item, const Shader& shader, unsigned int streamVAO, bool depthOnly);
+
+// Owns the GL context and draws on its own thread. The simulation thread fills
+// one of two packets while the render thread draws the other, so a frame costs
+// max(simulation, render) instead of their sum, and vsync waits in
+// glfwSwapBuffers no longer hold up the simulation.
+//
+// The GL context must be current on the calling thread when the renderer is
+// created. It is handed over to the render thread, and from then on nothing
+// else may touch GL.
+class Renderer {
+public:
+    Renderer(GLFWwindow* inWindow, std::string inVertexPath, std::string inFragmentPath);
+    ~Renderer();
+
+    // The packet to fill this frame. Never the one being drawn.
+    RenderPacket& beginPacket() { return mPackets[mWriteIndex]; }
+
+    // Hands the packet to the render thread. Waits only if the previous frame is
+    // still being drawn, which caps the pipeline at one frame of latency.
+    void submit();
+
+    // Blocks until every submitted packet has been drawn
+    void flush();
+
+    // Finishes the last frame, joins the render thread and makes the context current
+    // on the caller again. Must run before glfwTerminate; safe to call twice.
+    void stop();
+
+    uint64_t framesRendered() const { return mFramesRendered.load(std::memory_order_relaxed); }
+
+private:
+    void renderLoop();
+    void renderPacket(RenderPacket& packet, Shader& shader, ShadowMap& shadowMap, TextOverlay& overlay);
+    void createSkinnedStream();
+    void uploadSkinnedVertices(const RenderPacket& packet);
+
+    GLFWwindow* mWindow;
+    std::string mVertexPath;
+    std::string mFragmentPath;
+
+    RenderPacket mPackets[2];
+    int mWriteIndex = 0;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    int mPendingIndex = -1;  // submitted, not yet picked up
+    bool mBusy = false;      // render thread is drawing a packet
+    bool mStopping = false;
+    std::atomic<uint64_t> mFramesRendered{ 0 };
+
+    std::thread mThread;
+
+    // Render thread only
+    unsigned int mStreamVAO = 0;
+    unsigned int mStreamVBO = 0;
+};
@@ -0,0 +1,73 @@
+#include "Scene.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <fstream>
+#include <sstream>
+
+JPH::Quat ScenePlacement::rotation() const {
+    return JPH::Quat::sEulerAngles(JPH::Vec3(
+        glm::radians(rotationDegrees.x),
+        glm::radians(rotationDegrees.y),
+        glm::radians(rotationDegrees.z)));
+}
+
+bool loadSceneFile(const std::string& path, std::vector<ScenePlacement>& outPlacements) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cout << "Failed to open scene: " << path << std::endl;
+        return false;
+    }
+
+    size_t firstPlacement = outPlacements.size();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+
+        std::istringstream tokens(line);
+        std::string keyword;
+        if (!(tokens >> keyword))
+            continue;
+
+        if (keyword != "model") {
+            std::cout << path << ":" << lineNumber << ": unknown keyword '" << keyword << "'" << std::endl;
+            continue;
+        }
+
+        ScenePlacement placement;
+        if (!(tokens >> placement.modelPath
+            >> placement.position.x >> placement.position.y >> placement.position.z
+            >> placement.rotationDegrees.x >> placement.rotationDegrees.y >> placement.rotationDegrees.z
+            >> placement.scale)) {
+            std::cout << path << ":" << lineNumber << ": malformed model placement" << std::endl;
+            continue;
+        }
+
+        std::string flag;
+        while (tokens >> flag) {
+            if (flag == "none")
+                placement.collision = CollisionType::None;
+            else if (flag == "hull")
+                placement.collision = CollisionType::ConvexHulls;
+            else if (flag == "mesh")
+                placement.collision = CollisionType::Mesh;
+            else if (flag == "persistent")
+                placement.persistent = true;
+            else
+                std::cout << path << ":" << lineNumber << ": ignoring unknown flag '" << flag << "'" << std::endl;
+        }
+
+        JPH::Quat q = placement.rotation();
+        placement.modelMatrix = glm::translate(glm::mat4(1.0f), placement.position)
+            * glm::mat4_cast(glm::quat(q.GetW(), q.GetX(), q.GetY(), q.GetZ()))
+            * glm::scale(glm::mat4(1.0f), glm::vec3(placement.scale));
+
+        outPlacements.push_back(placement);
+    }
+
+    return outPlacements.size() > firstPlacement;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Physics.hpp"
+#include "ShapeCache.hpp"
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// A model placed in the level. Unless marked otherwise it gets static collision
+// built from the same geometry that is rendered.
+struct ScenePlacement {
+    std::string modelPath;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 rotationDegrees = glm::vec3(0.0f);
+    float scale = 1.0f;
+    CollisionType collision = CollisionType::Mesh;
+
+    // Kept resident regardless of where players are, for geometry whose extent
+    // is far larger than a streaming cell (terrain, the ground plane)
+    bool persistent = false;
+
+    // Render transform, derived from the physics rotation so both always agree
+    glm::mat4 modelMatrix = glm::mat4(1.0f);
+
+    JPH::Quat rotation() const;
+};
+
+// Reads a level description, one placement per line ('#' starts a comment):
+//   model <path> <x> <y> <z> <pitch> <yaw> <roll> <scale> [mesh|hull|none] [persistent]
+bool loadSceneFile(const std::string& path, std::vector<ScenePlacement>& outPlacements);
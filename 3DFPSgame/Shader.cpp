@@ -1,49 +1,108 @@
 #include "Shader.hpp"
+#include <filesystem>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath) {
-    std::string vertexCode = loadFile(vertexPath);
-    std::string fragmentCode = loadFile(fragmentPath);
+Shader::Shader(const char* inVertexPath, const char* inFragmentPath)
+    : vertexPath(inVertexPath), fragmentPath(inFragmentPath) {
+    ID = build();
+}
+
+unsigned int Shader::build() {
+    std::string vertexCode = loadFile(vertexPath.c_str());
+    std::string fragmentCode = loadFile(fragmentPath.c_str());
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
 
     unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vertex, 1, &vShaderCode, nullptr);
     glCompileShader(vertex);
-    checkCompileErrors(vertex, "VERTEX");
 
     unsigned int fragment = glCreateShader(GL_FRAGMENT_SHADER);
     glShaderSource(fragment, 1, &fShaderCode, nullptr);
     glCompileShader(fragment);
-    checkCompileErrors(fragment, "FRAGMENT");
-
-    ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
-    glLinkProgram(ID);
-    checkCompileErrors(ID, "PROGRAM");
 
+    // The shaders stay attached, and so alive for their info logs, until the program goes
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    glLinkProgram(program);
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+    return program;
+}
+
+// Blocks until the driver has finished with the program
+bool Shader::checkStatus(unsigned int program) const {
+    int linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked)
+        return true;
+
+    unsigned int shaders[2];
+    GLsizei count = 0;
+    glGetAttachedShaders(program, 2, &count, shaders);
+    for (GLsizei i = 0; i < count; i++) {
+        int type = 0;
+        glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type);
+        checkCompileErrors(shaders[i], type == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT");
+    }
+    checkCompileErrors(program, "PROGRAM");
+    return false;
 }
 
 void Shader::use() const {
+    if (!statusChecked) {
+        checkStatus(ID);
+        statusChecked = true;
+    }
     glUseProgram(ID);
 }
 
-void Shader::setBool(const std::string& name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+bool Shader::reload() {
+    unsigned int program = build();
+    if (!checkStatus(program)) {
+        std::cout << "Keeping the previous build of " << vertexPath << " + " << fragmentPath << std::endl;
+        glDeleteProgram(program);
+        return false;
+    }
+
+    glDeleteProgram(ID);
+    ID = program;
+    statusChecked = true;
+    std::cout << "Reloaded " << vertexPath << " + " << fragmentPath << std::endl;
+    return true;
+}
+
+bool Shader::usesFile(const std::string& path) const {
+    std::error_code error;
+    return std::filesystem::equivalent(path, vertexPath, error) || std::filesystem::equivalent(path, fragmentPath, error);
+}
+
+void Shader::setBool(const char* name, bool value) const {
+    glUniform1i(glGetUniformLocation(ID, name), (int)value);
+}
+void Shader::setInt(const char* name, int value) const {
+    glUniform1i(glGetUniformLocation(ID, name), value);
+}
+void Shader::setFloat(const char* name, float value) const {
+    glUniform1f(glGetUniformLocation(ID, name), value);
+}
+void Shader::setVec2(const char* name, const glm::vec2& value) const {
+    glUniform2fv(glGetUniformLocation(ID, name), 1, &value[0]);
+}
+void Shader::setVec3(const char* name, const glm::vec3& value) const {
+    glUniform3fv(glGetUniformLocation(ID, name), 1, &value[0]);
 }
-void Shader::setInt(const std::string& name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+void Shader::setVec4(const char* name, const glm::vec4& value) const {
+    glUniform4fv(glGetUniformLocation(ID, name), 1, &value[0]);
 }
-void Shader::setFloat(const std::string& name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+void Shader::setMat4(const char* name, const glm::mat4& mat) const {
+    glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
 }
-void Shader::setMat4(const std::string& name, const glm::mat4& mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+void Shader::setMat4Array(const char* name, const glm::mat4* mats, int count) const {
+    glUniformMatrix4fv(glGetUniformLocation(ID, name), count, GL_FALSE, &mats[0][0][0]);
 }
 
 std::string Shader::loadFile(const char* path) {
@@ -57,7 +116,7 @@ std::string Shader::loadFile(const char* path) {
     return buffer.str();
 }
 
-void Shader::checkCompileErrors(unsigned int shader, const std::string& type) {
+void Shader::checkCompileErrors(unsigned int shader, const std::string& type) const {
     int success;
     char infoLog[1024];
     if (type != "PROGRAM") {
@@ -9,17 +9,36 @@ class Shader {
 public:
     unsigned int ID;
 
-    Shader(const char* vertexPath, const char* fragmentPath);
+    // Compiles and links without waiting for the result, so a driver with parallel
+    // compilation can work on several programs at once. Errors are reported at the
+    // first use().
+    Shader(const char* inVertexPath, const char* inFragmentPath);
     void use() const;
 
-    void setBool(const std::string& name, bool value) const;
-    void setInt(const std::string& name, int value) const;
-    void setFloat(const std::string& name, float value) const;
-    void setMat4(const std::string& name, const glm::mat4& mat) const;
+    // Rebuilds from the same files. If the new source doesn't compile the old
+    // program stays in use, so a bad save never leaves the screen black.
+    bool reload();
+    bool usesFile(const std::string& path) const;
+
+    // Plain C strings so per-draw calls with literal names never build a std::string
+    void setBool(const char* name, bool value) const;
+    void setInt(const char* name, int value) const;
+    void setFloat(const char* name, float value) const;
+    void setVec2(const char* name, const glm::vec2& value) const;
+    void setVec3(const char* name, const glm::vec3& value) const;
+    void setVec4(const char* name, const glm::vec4& value) const;
+    void setMat4(const char* name, const glm::mat4& mat) const;
+    void setMat4Array(const char* name, const glm::mat4* mats, int count) const;
 
 private:
+    std::string vertexPath;
+    std::string fragmentPath;
+    mutable bool statusChecked = false;
+
+    unsigned int build();
+    bool checkStatus(unsigned int program) const;
     std::string loadFile(const char* path);
-    void checkCompileErrors(unsigned int shader, const std::string& type);
+    void checkCompileErrors(unsigned int shader, const std::string& type) const;
 };
 
 #endif
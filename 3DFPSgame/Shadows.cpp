@@ -0,0 +1,218 @@
+#include "Shadows.hpp"
+#include "Renderer.hpp"
+#include "Model.hpp"
+#include "Shader.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+void ShadowFrame::clear() {
+    cascadeCount = 0;
+    for (ShadowCascade& cascade : cascades)
+        cascade.casters.clear();
+}
+
+// Light-space center and half extents of a world-space box
+static void toLightSpace(const glm::mat4& lightView, const Bounds& bounds, glm::vec3& outCenter, glm::vec3& outExtents) {
+    glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+    glm::vec3 extents = (bounds.max - bounds.min) * 0.5f;
+    glm::mat3 rotation(lightView);
+    glm::mat3 absRotation(glm::abs(rotation[0]), glm::abs(rotation[1]), glm::abs(rotation[2]));
+    outCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+    outExtents = absRotation * extents;
+}
+
+ShadowStats buildShadowCascades(const ShadowSettings& settings, const glm::mat4& view, float fovRadians,
+    float aspect, float nearPlane, const std::vector<DrawItem>& draws, ShadowFrame& frame) {
+    ShadowStats stats;
+    frame.clear();
+    frame.cascadeCount = std::clamp(settings.cascadeCount, 0, cMaxShadowCascades);
+    frame.resolution = settings.resolution;
+    frame.lightDirection = glm::normalize(settings.lightDirection);
+    if (frame.cascadeCount == 0)
+        return stats;
+
+    glm::vec3 lightDir = frame.lightDirection;
+    glm::vec3 up = std::abs(lightDir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), lightDir, up);
+
+    glm::mat4 invView = glm::inverse(view);
+    float tanHalfY = std::tan(fovRadians * 0.5f);
+    float tanHalfX = tanHalfY * aspect;
+    float splitNear = nearPlane;
+
+    for (int c = 0; c < frame.cascadeCount; c++) {
+        ShadowCascade& cascade = frame.cascades[c];
+
+        float t = (float)(c + 1) / (float)frame.cascadeCount;
+        float logSplit = nearPlane * std::pow(settings.maxDistance / nearPlane, t);
+        float uniformSplit = nearPlane + (settings.maxDistance - nearPlane) * t;
+        float splitFar = glm::mix(uniformSplit, logSplit, settings.splitLambda);
+
+        // Fit a sphere rather than a box around the slice so the volume keeps its
+        // size as the camera turns, then snap it to whole texels so it doesn't
+        // shimmer as the camera moves
+        glm::vec3 corners[8];
+        glm::vec3 center(0.0f);
+        for (int i = 0; i < 8; i++) {
+            float depth = (i & 4) ? splitFar : splitNear;
+            float x = ((i & 1) ? 1.0f : -1.0f) * tanHalfX * depth;
+            float y = ((i & 2) ? 1.0f : -1.0f) * tanHalfY * depth;
+            corners[i] = glm::vec3(invView * glm::vec4(x, y, -depth, 1.0f));
+            center += corners[i];
+        }
+        center /= 8.0f;
+
+        float radius = 0.0f;
+        for (const glm::vec3& corner : corners)
+            radius = std::max(radius, glm::length(corner - center));
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        float texel = 2.0f * radius / (float)frame.resolution;
+        glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+        lightCenter.x = std::floor(lightCenter.x / texel) * texel;
+        lightCenter.y = std::floor(lightCenter.y / texel) * texel;
+
+        float minX = lightCenter.x - radius, maxX = lightCenter.x + radius;
+        float minY = lightCenter.y - radius, maxY = lightCenter.y + radius;
+        float receiverBottom = lightCenter.z - radius;
+        float casterTop = lightCenter.z + radius;
+        float minCasterSize = settings.minCasterTexels * texel;
+
+        // The light looks down -Z, so anything above the receivers can cast into them
+        for (uint32_t i = 0; i < (uint32_t)draws.size(); i++) {
+            glm::vec3 casterCenter, casterExtents;
+            toLightSpace(lightView, draws[i].bounds, casterCenter, casterExtents);
+
+            if (casterCenter.x + casterExtents.x < minX || casterCenter.x - casterExtents.x > maxX
+                || casterCenter.y + casterExtents.y < minY || casterCenter.y - casterExtents.y > maxY
+                || casterCenter.z + casterExtents.z < receiverBottom) {
+                stats.culled++;
+                continue;
+            }
+            if (std::max(casterExtents.x, casterExtents.y) * 2.0f < minCasterSize) {
+                stats.tooSmall++;
+                continue;
+            }
+
+            casterTop = std::max(casterTop, casterCenter.z + casterExtents.z);
+            cascade.casters.push_back(i);
+        }
+
+        if ((int)cascade.casters.size() > settings.maxCastersPerCascade) {
+            auto footprint = [&](uint32_t index) {
+                glm::vec3 casterCenter, casterExtents;
+                toLightSpace(lightView, draws[index].bounds, casterCenter, casterExtents);
+                return casterExtents.x * casterExtents.y;
+            };
+            auto budgetEnd = cascade.casters.begin() + settings.maxCastersPerCascade;
+            std::nth_element(cascade.casters.begin(), budgetEnd, cascade.casters.end(),
+                [&](uint32_t a, uint32_t b) { return footprint(a) > footprint(b); });
+            stats.overBudget += (uint32_t)(cascade.casters.end() - budgetEnd);
+            cascade.casters.erase(budgetEnd, cascade.casters.end());
+        }
+
+        glm::mat4 projection = glm::ortho(minX, maxX, minY, maxY, -casterTop, -receiverBottom);
+        cascade.lightViewProjection = projection * lightView;
+        cascade.splitFar = splitFar;
+        stats.casters[c] = (uint32_t)cascade.casters.size();
+
+        splitNear = splitFar;
+    }
+
+    return stats;
+}
+
+ShadowMap::ShadowMap(const char* inVertexPath, const char* inFragmentPath)
+    : mDepthShader(std::make_unique<Shader>(inVertexPath, inFragmentPath)) {
+    glGenFramebuffers(1, &mFramebuffer);
+}
+
+ShadowMap::~ShadowMap() {
+    glDeleteFramebuffers(1, &mFramebuffer);
+    if (mDepthTexture != 0)
+        glDeleteTextures(1, &mDepthTexture);
+}
+
+void ShadowMap::allocate(int resolution) {
+    if (mDepthTexture != 0)
+        glDeleteTextures(1, &mDepthTexture);
+
+    glGenTextures(1, &mDepthTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, mDepthTexture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, cMaxShadowCascades,
+        0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+
+    // Linear filtering on a compare texture gives 2x2 PCF for free per tap
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    float border[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, mDepthTexture, 0, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "Shadow map framebuffer is incomplete at " << resolution << "x" << resolution << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    mResolution = resolution;
+}
+
+void ShadowMap::render(const RenderPacket& packet, unsigned int streamVAO) {
+    const ShadowFrame& frame = packet.shadows;
+    if (frame.cascadeCount == 0)
+        return;
+    if (frame.resolution != mResolution)
+        allocate(frame.resolution);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    glViewport(0, 0, mResolution, mResolution);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+
+    mDepthShader->use();
+    for (int c = 0; c < frame.cascadeCount; c++) {
+        const ShadowCascade& cascade = frame.cascades[c];
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, mDepthTexture, 0, c);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        mDepthShader->setMat4("lightViewProjection", cascade.lightViewProjection);
+        for (uint32_t index : cascade.casters)
+            submitDraw(packet, packet.draws[index], *mDepthShader, streamVAO, true);
+    }
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowMap::bind(const Shader& shader, const ShadowFrame& frame, int textureUnit) const {
+    static const char* cMatrixNames[cMaxShadowCascades] = {
+        "lightViewProjection[0]", "lightViewProjection[1]", "lightViewProjection[2]", "lightViewProjection[3]"
+    };
+
+    // Always point the shadow sampler at its own unit, even with shadows off, so it
+    // never shares a unit with the diffuse sampler2D
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, mDepthTexture);
+    glActiveTexture(GL_TEXTURE0);
+    shader.setInt("shadowMap", textureUnit);
+
+    shader.setInt("cascadeCount", frame.cascadeCount);
+    shader.setVec3("lightDirection", frame.lightDirection);
+
+    glm::vec4 splits(0.0f);
+    for (int c = 0; c < frame.cascadeCount; c++) {
+        shader.setMat4(cMatrixNames[c], frame.cascades[c].lightViewProjection);
+        splits[c] = frame.cascades[c].splitFar;
+    }
+    shader.setVec4("cascadeSplits", splits);
+}
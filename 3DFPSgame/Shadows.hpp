@@ -0,0 +1,78 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct DrawItem;
+struct RenderPacket;
+class Shader;
+
+struct ShadowSettings {
+    int cascadeCount = 3;              // 0 turns shadows off, at most cMaxShadowCascades
+    int resolution = 2048;             // per cascade layer
+    float maxDistance = 120.0f;        // receivers beyond this are unshadowed
+    float splitLambda = 0.75f;         // 0 = uniform splits, 1 = logarithmic
+    glm::vec3 lightDirection = glm::vec3(-0.4f, -1.0f, -0.3f);  // direction the light travels
+
+    // Budget: casters smaller than this many shadow texels are skipped outright, and
+    // a cascade draws at most maxCastersPerCascade, biggest light-space footprint first
+    float minCasterTexels = 2.0f;
+    int maxCastersPerCascade = 1024;
+};
+
+constexpr int cMaxShadowCascades = 4;
+
+struct ShadowCascade {
+    glm::mat4 lightViewProjection = glm::mat4(1.0f);
+    float splitFar = 0.0f;          // view depth where the next cascade takes over
+    std::vector<uint32_t> casters;  // indices into RenderPacket::draws
+};
+
+// The shadow part of a render packet, built on the simulation thread
+struct ShadowFrame {
+    int cascadeCount = 0;
+    int resolution = 0;
+    glm::vec3 lightDirection = glm::vec3(0.0f, -1.0f, 0.0f);
+    ShadowCascade cascades[cMaxShadowCascades];
+
+    void clear();
+};
+
+struct ShadowStats {
+    uint32_t casters[cMaxShadowCascades] = {};
+    uint32_t culled = 0;      // outside a cascade's light volume
+    uint32_t tooSmall = 0;    // under minCasterTexels
+    uint32_t overBudget = 0;  // dropped by maxCastersPerCascade
+};
+
+// Splits the view frustum up to maxDistance into cascades, fits a texel-snapped
+// orthographic light volume around each slice and culls the draw list against it.
+// Each draw is only tested against the light volumes, never rendered, so this
+// costs one bounds transform per draw and cascade.
+ShadowStats buildShadowCascades(const ShadowSettings& settings, const glm::mat4& view, float fovRadians,
+    float aspect, float nearPlane, const std::vector<DrawItem>& draws, ShadowFrame& frame);
+
+// Render thread side: one depth texture array layer per cascade, filled with a
+// depth-only shader. Uses nothing past GL 3.3 core, so llvmpipe runs it.
+class ShadowMap {
+public:
+    ShadowMap(const char* inVertexPath, const char* inFragmentPath);
+    ~ShadowMap();
+
+    void render(const RenderPacket& packet, unsigned int streamVAO);
+
+    // Binds the cascade array for sampler2DArrayShadow and sets the lighting uniforms
+    void bind(const Shader& shader, const ShadowFrame& frame, int textureUnit) const;
+
+    Shader& shader() { return *mDepthShader; }
+
+private:
+    void allocate(int resolution);
+
+    std::unique_ptr<Shader> mDepthShader;
+    unsigned int mFramebuffer = 0;
+    unsigned int mDepthTexture = 0;
+    int mResolution = 0;
+};
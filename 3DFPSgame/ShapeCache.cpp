@@ -0,0 +1,195 @@
+#include "ShapeCache.hpp"
+#include "Model.hpp"
+#include "Determinism.hpp"
+
+#include <Jolt/Core/StreamWrapper.h>
+#include <Jolt/Physics/Collision/Shape/MeshShape.h>
+#include <Jolt/Physics/Collision/Shape/ConvexHullShape.h>
+#include <Jolt/Physics/Collision/Shape/StaticCompoundShape.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+using namespace JPH;
+
+static constexpr uint32 cShapeCacheMagic = 0x53504A46; // "FJPS"
+static constexpr uint32 cShapeCacheVersion = 1;
+
+ShapeCache::ShapeCache(std::string cacheDirectory)
+    : mCacheDirectory(std::move(cacheDirectory)) {
+    std::error_code error;
+    std::filesystem::create_directories(mCacheDirectory, error);
+    if (error) {
+        std::cout << "Failed to create shape cache directory " << mCacheDirectory << ": " << error.message() << std::endl;
+    }
+}
+
+std::string ShapeCache::cacheKey(const std::string& sourcePath, CollisionType type, float scale) const {
+    std::error_code error;
+    uintmax_t fileSize = std::filesystem::file_size(sourcePath, error);
+    if (error)
+        fileSize = 0;
+    auto writeTime = std::filesystem::last_write_time(sourcePath, error);
+    long long writeTicks = error ? 0 : static_cast<long long>(writeTime.time_since_epoch().count());
+
+    StateHasher hasher;
+    hasher.addBytes(sourcePath.data(), sourcePath.size());
+    hasher.add(fileSize);
+    hasher.add(writeTicks);
+    hasher.add(type);
+    hasher.add(scale);
+    hasher.add(cShapeCacheVersion);
+
+    std::stringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << hasher.digest();
+    return ss.str();
+}
+
+ShapeRefC ShapeCache::getOrBuild(const Model& model, const std::string& sourcePath, CollisionType type, float scale) {
+    if (type == CollisionType::None)
+        return nullptr;
+
+    std::string key = cacheKey(sourcePath, type, scale);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mResident.find(key);
+        if (it != mResident.end())
+            return it->second;
+    }
+
+    std::string path = (std::filesystem::path(mCacheDirectory) / (key + ".shape")).string();
+
+    ShapeRefC shape = load(path);
+    if (shape == nullptr) {
+        shape = build(model, type, scale);
+        if (shape != nullptr)
+            save(path, shape.GetPtr());
+    }
+
+    if (shape != nullptr) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mResident[key] = shape;
+    }
+    return shape;
+}
+
+ShapeRefC ShapeCache::build(const Model& model, CollisionType type, float scale) const {
+    if (type == CollisionType::Mesh) {
+        VertexList vertices;
+        IndexedTriangleList triangles;
+
+        for (const Mesh& mesh : model.meshes) {
+            uint32 baseVertex = (uint32)vertices.size();
+            for (const Vertex& vertex : mesh.vertices) {
+                glm::vec3 p = vertex.position * scale;
+                vertices.push_back(Float3(p.x, p.y, p.z));
+            }
+            for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+                triangles.push_back(IndexedTriangle(
+                    baseVertex + mesh.indices[i],
+                    baseVertex + mesh.indices[i + 1],
+                    baseVertex + mesh.indices[i + 2]));
+            }
+        }
+
+        if (triangles.empty())
+            return nullptr;
+
+        MeshShapeSettings settings(std::move(vertices), std::move(triangles));
+        ShapeSettings::ShapeResult result = settings.Create();
+        if (result.HasError()) {
+            std::cout << "Failed to build mesh shape: " << result.GetError().c_str() << std::endl;
+            return nullptr;
+        }
+        return result.Get();
+    }
+
+    // Approximate decomposition: the artist's sub-mesh split decides the pieces
+    StaticCompoundShapeSettings compound;
+    for (const Mesh& mesh : model.meshes) {
+        Array<Vec3> points;
+        points.reserve(mesh.vertices.size());
+        for (const Vertex& vertex : mesh.vertices) {
+            glm::vec3 p = vertex.position * scale;
+            points.push_back(Vec3(p.x, p.y, p.z));
+        }
+        if (points.size() < 4)
+            continue;
+
+        ShapeSettings::ShapeResult hull = ConvexHullShapeSettings(points).Create();
+        if (hull.HasError()) {
+            std::cout << "Skipping sub-mesh, convex hull failed: " << hull.GetError().c_str() << std::endl;
+            continue;
+        }
+        compound.AddShape(Vec3::sZero(), Quat::sIdentity(), hull.Get());
+    }
+
+    if (compound.mSubShapes.empty())
+        return nullptr;
+
+    ShapeSettings::ShapeResult result = compound.Create();
+    if (result.HasError()) {
+        std::cout << "Failed to build hull compound: " << result.GetError().c_str() << std::endl;
+        return nullptr;
+    }
+    return result.Get();
+}
+
+ShapeRefC ShapeCache::load(const std::string& path) const {
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file)
+        return nullptr;
+
+    StreamInWrapper stream(file);
+    uint32 magic = 0, version = 0;
+    stream.Read(magic);
+    stream.Read(version);
+    if (stream.IsFailed() || magic != cShapeCacheMagic || version != cShapeCacheVersion)
+        return nullptr;
+
+    Shape::IDToShapeMap shapeMap;
+    Shape::IDToMaterialMap materialMap;
+    Shape::ShapeResult result = Shape::sRestoreWithChildren(stream, shapeMap, materialMap);
+    if (result.HasError() || stream.IsFailed()) {
+        std::cout << "Discarding unreadable shape cache entry: " << path << std::endl;
+        return nullptr;
+    }
+    return result.Get();
+}
+
+void ShapeCache::save(const std::string& path, const Shape* shape) const {
+    // Write to a temporary name first so a crash never leaves a truncated entry behind
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cout << "Failed to write shape cache entry: " << path << std::endl;
+            return;
+        }
+
+        StreamOutWrapper stream(file);
+        stream.Write(cShapeCacheMagic);
+        stream.Write(cShapeCacheVersion);
+
+        // SaveWithChildren runs SaveBinaryState on every unique sub-shape
+        Shape::ShapeToIDMap shapeMap;
+        Shape::MaterialToIDMap materialMap;
+        shape->SaveWithChildren(stream, shapeMap, materialMap);
+        file.close();
+        if (stream.IsFailed() || !file) {
+            std::cout << "Failed to write shape cache entry: " << path << std::endl;
+            std::error_code ignored;
+            std::filesystem::remove(tempPath, ignored);
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+        std::cout << "Failed to commit shape cache entry " << path << ": " << error.message() << std::endl;
+        std::filesystem::remove(tempPath, error);
+    }
+}
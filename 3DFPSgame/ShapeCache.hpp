@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Physics.hpp"
+
+#include <string>
+#include <unordered_map>
+#include <mutex>
+
+class Model;
+
+enum class CollisionType {
+    None,
+    Mesh,        // exact triangle mesh, static only
+    ConvexHulls  // one convex hull per sub-mesh, combined into a compound
+};
+
+// Builds Jolt collision from model geometry and keeps the cooked result on disk,
+// so only the first load of a map pays for MeshShape construction. Entries are
+// keyed on the source file's path, size and modification time plus the build
+// parameters; touching the model invalidates its cache entry.
+class ShapeCache {
+public:
+    explicit ShapeCache(std::string cacheDirectory = "cache/shapes");
+
+    JPH::ShapeRefC getOrBuild(const Model& model, const std::string& sourcePath, CollisionType type, float scale);
+
+private:
+    std::string cacheKey(const std::string& sourcePath, CollisionType type, float scale) const;
+
+    JPH::ShapeRefC build(const Model& model, CollisionType type, float scale) const;
+    JPH::ShapeRefC load(const std::string& path) const;
+    void save(const std::string& path, const JPH::Shape* shape) const;
+
+    std::string mCacheDirectory;
+
+    // Shapes already resident this session, so instanced placements share one shape
+    std::mutex mMutex;
+    std::unordered_map<std::string, JPH::ShapeRefC> mResident;
+};
@@ -0,0 +1,164 @@
+#include "SpatialHash.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace JPH;
+
+SpatialHash::SpatialHash(float inCellSize)
+    : mCellSize(inCellSize), mInvCellSize(1.0f / inCellSize) {
+}
+
+uint32_t SpatialHash::bucketOf(int x, int y, int z) const {
+    uint32_t hash = (static_cast<uint32_t>(x) * 73856093u) ^ (static_cast<uint32_t>(y) * 19349663u) ^ (static_cast<uint32_t>(z) * 83492791u);
+    return hash & mBucketMask;
+}
+
+void SpatialHash::build(const std::vector<glm::vec3>& positions) {
+    mCount = positions.size();
+
+    // Twice as many buckets as entities keeps collisions rare; the vectors only ever grow
+    uint32_t bucketCount = 16;
+    while (bucketCount < 2 * mCount)
+        bucketCount <<= 1;
+    mBucketMask = bucketCount - 1;
+
+    mBucketStart.assign(bucketCount + 1, 0);
+    mEntryBucket.resize(mCount);
+    size_t padded = mCount + 3;
+    mX.resize(padded);
+    mY.resize(padded);
+    mZ.resize(padded);
+    mIds.resize(padded);
+
+    for (size_t i = 0; i < mCount; i++) {
+        const glm::vec3& p = positions[i];
+        uint32_t bucket = bucketOf(
+            static_cast<int>(std::floor(p.x * mInvCellSize)),
+            static_cast<int>(std::floor(p.y * mInvCellSize)),
+            static_cast<int>(std::floor(p.z * mInvCellSize)));
+        mEntryBucket[i] = bucket;
+        mBucketStart[bucket + 1]++;
+    }
+    for (uint32_t b = 0; b < bucketCount; b++)
+        mBucketStart[b + 1] += mBucketStart[b];
+
+    // Scatter with each bucket's start as its write cursor, which leaves it at the
+    // bucket's end, then shift the table back by one
+    for (size_t i = 0; i < mCount; i++) {
+        uint32_t slot = mBucketStart[mEntryBucket[i]]++;
+        mX[slot] = positions[i].x;
+        mY[slot] = positions[i].y;
+        mZ[slot] = positions[i].z;
+        mIds[slot] = static_cast<uint32_t>(i);
+    }
+    for (uint32_t b = bucketCount; b > 0; b--)
+        mBucketStart[b] = mBucketStart[b - 1];
+    mBucketStart[0] = 0;
+
+    // Padding lanes are far away so they never pass a distance test
+    for (size_t i = mCount; i < padded; i++) {
+        mX[i] = mY[i] = mZ[i] = 1.0e30f;
+        mIds[i] = 0;
+    }
+}
+
+void SpatialHash::filterRange(uint32_t begin, uint32_t end, const glm::vec3& center, float radiusSq, std::vector<Candidate>& outCandidates) const {
+    Vec4 cx = Vec4::sReplicate(center.x);
+    Vec4 cy = Vec4::sReplicate(center.y);
+    Vec4 cz = Vec4::sReplicate(center.z);
+    Vec4 r2 = Vec4::sReplicate(radiusSq);
+
+    for (uint32_t i = begin; i < end; i += 4) {
+        Vec4 dx = Vec4::sLoadFloat4(reinterpret_cast<const Float4*>(&mX[i])) - cx;
+        Vec4 dy = Vec4::sLoadFloat4(reinterpret_cast<const Float4*>(&mY[i])) - cy;
+        Vec4 dz = Vec4::sLoadFloat4(reinterpret_cast<const Float4*>(&mZ[i])) - cz;
+        Vec4 distanceSq = dx * dx + dy * dy + dz * dz;
+
+        // Lanes past the bucket's end belong to the next bucket; mask them off
+        int inside = Vec4::sLessOrEqual(distanceSq, r2).GetTrues();
+        uint32_t remaining = end - i;
+        if (remaining < 4)
+            inside &= (1 << remaining) - 1;
+        if (inside == 0)
+            continue;
+
+        alignas(16) float distances[4];
+        distanceSq.StoreFloat4(reinterpret_cast<Float4*>(distances));
+        for (int lane = 0; lane < 4; lane++) {
+            if (inside & (1 << lane))
+                outCandidates.push_back({ distances[lane], mIds[i + lane] });
+        }
+    }
+}
+
+void SpatialHash::gather(const glm::vec3& center, float radius, std::vector<Candidate>& outCandidates) const {
+    if (mCount == 0)
+        return;
+
+    float radiusSq = radius * radius;
+    int minX = static_cast<int>(std::floor((center.x - radius) * mInvCellSize));
+    int minY = static_cast<int>(std::floor((center.y - radius) * mInvCellSize));
+    int minZ = static_cast<int>(std::floor((center.z - radius) * mInvCellSize));
+    int maxX = static_cast<int>(std::floor((center.x + radius) * mInvCellSize));
+    int maxY = static_cast<int>(std::floor((center.y + radius) * mInvCellSize));
+    int maxZ = static_cast<int>(std::floor((center.z + radius) * mInvCellSize));
+
+    int64_t cellCount = int64_t(maxX - minX + 1) * (maxY - minY + 1) * (maxZ - minZ + 1);
+    if (cellCount > cMaxQueryCells) {
+        filterRange(0, static_cast<uint32_t>(mCount), center, radiusSq, outCandidates);
+        return;
+    }
+
+    // Several cells can hash to one bucket; visit each bucket once so nothing is reported twice
+    uint32_t visited[cMaxQueryCells];
+    int visitedCount = 0;
+    for (int z = minZ; z <= maxZ; z++) {
+        for (int y = minY; y <= maxY; y++) {
+            for (int x = minX; x <= maxX; x++) {
+                uint32_t bucket = bucketOf(x, y, z);
+                if (std::find(visited, visited + visitedCount, bucket) != visited + visitedCount)
+                    continue;
+                visited[visitedCount++] = bucket;
+
+                uint32_t begin = mBucketStart[bucket];
+                uint32_t end = mBucketStart[bucket + 1];
+                if (begin != end)
+                    filterRange(begin, end, center, radiusSq, outCandidates);
+            }
+        }
+    }
+}
+
+void SpatialHash::queryRadius(const glm::vec3& center, float radius, std::vector<uint32_t>& outIds) const {
+    thread_local std::vector<Candidate> candidates;
+    candidates.clear();
+    gather(center, radius, candidates);
+    for (const Candidate& candidate : candidates)
+        outIds.push_back(candidate.id);
+}
+
+size_t SpatialHash::queryNearest(const glm::vec3& center, size_t k, float maxRadius, std::vector<uint32_t>& outIds) const {
+    if (k == 0 || mCount == 0)
+        return 0;
+
+    // Grow the search until it holds k entities; everything nearer is then inside it too
+    thread_local std::vector<Candidate> candidates;
+    float radius = std::min(mCellSize, maxRadius);
+    for (;;) {
+        candidates.clear();
+        gather(center, radius, candidates);
+        if (candidates.size() >= k || radius >= maxRadius)
+            break;
+        radius = std::min(radius * 2.0f, maxRadius);
+    }
+
+    size_t found = std::min(k, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + found, candidates.end(),
+        [](const Candidate& a, const Candidate& b) {
+            return a.distanceSq < b.distanceSq || (a.distanceSq == b.distanceSq && a.id < b.id);
+        });
+    for (size_t i = 0; i < found; i++)
+        outIds.push_back(candidates[i].id);
+    return found;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Jolt/Jolt.h>
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Uniform spatial hash over gameplay entity positions, rebuilt from scratch every
+// tick. Entities are counting-sorted by hashed cell into flat structure-of-arrays
+// storage, and queries test four candidates per SIMD instruction. Unlike the
+// physics queries there are no shapes, layers or locks, only points.
+//
+// Ids are the indices into the positions passed to build(). Queries are const and
+// safe to run from several threads at once.
+class SpatialHash {
+public:
+    explicit SpatialHash(float inCellSize = 4.0f);
+
+    void build(const std::vector<glm::vec3>& positions);
+
+    size_t size() const { return mCount; }
+
+    // Appends the ids of all entities within radius of center, in no particular order
+    void queryRadius(const glm::vec3& center, float radius, std::vector<uint32_t>& outIds) const;
+
+    // The k entities closest to center within maxRadius, nearest first. Returns how many were found.
+    size_t queryNearest(const glm::vec3& center, size_t k, float maxRadius, std::vector<uint32_t>& outIds) const;
+
+    // Larger queries scan every entity instead of visiting cells one by one
+    static constexpr int cMaxQueryCells = 64;
+
+private:
+    struct Candidate {
+        float distanceSq;
+        uint32_t id;
+    };
+
+    uint32_t bucketOf(int x, int y, int z) const;
+    void gather(const glm::vec3& center, float radius, std::vector<Candidate>& outCandidates) const;
+    void filterRange(uint32_t begin, uint32_t end, const glm::vec3& center, float radiusSq, std::vector<Candidate>& outCandidates) const;
+
+    float mCellSize;
+    float mInvCellSize;
+    size_t mCount = 0;
+    uint32_t mBucketMask = 0;
+
+    std::vector<uint32_t> mBucketStart;  // bucket b holds sorted entries [start[b], start[b + 1])
+    std::vector<uint32_t> mEntryBucket;  // build scratch
+
+    // Sorted by bucket, padded by three lanes so the SIMD loop can overrun a bucket's end
+    std::vector<float> mX, mY, mZ;
+    std::vector<uint32_t> mIds;
+};
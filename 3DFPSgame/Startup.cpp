@@ -0,0 +1,108 @@
+#include "Startup.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+StartupGraph::TaskId StartupGraph::add(const char* name, std::function<void()> work, std::vector<TaskId> dependencies) {
+    Task task;
+    task.name = name;
+    task.work = std::move(work);
+    task.dependencies = std::move(dependencies);
+    mTasks.push_back(std::move(task));
+    return mTasks.size() - 1;
+}
+
+StartupGraph::TaskId StartupGraph::addMainThread(const char* name, std::function<void()> work, std::vector<TaskId> dependencies) {
+    TaskId id = add(name, std::move(work), std::move(dependencies));
+    mTasks[id].mainThread = true;
+    return id;
+}
+
+bool StartupGraph::isReady(const Task& task) const {
+    return task.state == State::Waiting && std::all_of(task.dependencies.begin(), task.dependencies.end(),
+        [this](TaskId dependency) { return mTasks[dependency].state == State::Done; });
+}
+
+void StartupGraph::runTask(TaskId id) {
+    Task& task = mTasks[id];
+    double start = now();
+    task.work();
+    double end = now();
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        task.start = start;
+        task.end = end;
+        task.state = State::Done;
+    }
+    mFinished.notify_all();
+}
+
+void StartupGraph::run() {
+    double begin = now();
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;) {
+        // Start every worker task that can go, then do at most one main thread
+        // task before looking again, since finishing it may free up more workers
+        TaskId mainTask = mTasks.size();
+        bool running = false;
+        for (TaskId id = 0; id < mTasks.size(); id++) {
+            Task& task = mTasks[id];
+            if (isReady(task)) {
+                if (task.mainThread) {
+                    if (mainTask == mTasks.size())
+                        mainTask = id;
+                    continue;
+                }
+                task.state = State::Running;
+                mThreads.emplace_back(&StartupGraph::runTask, this, id);
+            }
+            running = running || task.state == State::Running;
+        }
+
+        if (mainTask < mTasks.size()) {
+            mTasks[mainTask].state = State::Running;
+            lock.unlock();
+            runTask(mainTask);
+            lock.lock();
+            continue;
+        }
+
+        bool allDone = std::all_of(mTasks.begin(), mTasks.end(), [](const Task& task) { return task.state == State::Done; });
+        if (allDone)
+            break;
+        if (!running) {
+            std::cout << "Startup graph has a dependency cycle, skipping what is left of it" << std::endl;
+            break;
+        }
+        mFinished.wait(lock);
+    }
+    lock.unlock();
+
+    for (std::thread& thread : mThreads)
+        thread.join();
+    mThreads.clear();
+    printTimings(begin, now());
+}
+
+void StartupGraph::printTimings(double begin, double end) const {
+    double serial = 0.0;
+    std::cout << "Startup took " << (int)((end - begin) * 1000.0) << " ms:";
+    for (const Task& task : mTasks) {
+        if (task.state != State::Done)
+            continue;
+        serial += task.end - task.start;
+        std::cout << " " << task.name << " " << (int)((task.end - task.start) * 1000.0) << " ms"
+            << " (+" << (int)((task.start - begin) * 1000.0) << ")";
+    }
+    std::cout << " | " << (int)(serial * 1000.0) << " ms if run one after another" << std::endl;
+}
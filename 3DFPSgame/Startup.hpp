@@ -0,0 +1,47 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs startup work as a dependency graph instead of one long serial list. Each
+// task starts as soon as everything it depends on has finished: worker tasks on
+// a thread of their own, main thread tasks (window and GL context creation,
+// anything GLFW insists on) on the thread that calls run(). Tasks report
+// failure through whatever state they capture; a failed task still counts as
+// finished so its dependents can fall back.
+class StartupGraph {
+public:
+    using TaskId = size_t;
+
+    TaskId add(const char* name, std::function<void()> work, std::vector<TaskId> dependencies = {});
+    TaskId addMainThread(const char* name, std::function<void()> work, std::vector<TaskId> dependencies = {});
+
+    // Returns once every task has run, then prints how long each one took
+    void run();
+
+private:
+    enum class State { Waiting, Running, Done };
+
+    struct Task {
+        const char* name;
+        std::function<void()> work;
+        std::vector<TaskId> dependencies;
+        bool mainThread = false;
+        State state = State::Waiting;
+        double start = 0.0;
+        double end = 0.0;
+    };
+
+    bool isReady(const Task& task) const;
+    void runTask(TaskId id);
+    void printTimings(double begin, double end) const;
+
+    std::vector<Task> mTasks;
+    std::vector<std::thread> mThreads;
+    std::mutex mMutex;
+    std::condition_variable mFinished;
+};
@@ -0,0 +1,482 @@
+#include "TextureCook.hpp"
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cfloat>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+
+using namespace JPH;
+
+// Not every glad build carries the S3TC extension's enums
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace {
+
+constexpr char cMagic[4] = { 'F', 'T', 'E', 'X' };
+constexpr uint32_t cVersion = 1;
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t format;
+    uint32_t width, height;
+    uint32_t mipCount;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+};
+// Followed by mipCount uint32 level sizes, then the levels, largest first
+
+struct SourceStamp {
+    uint64_t size = 0;
+    int64_t time = 0;
+};
+
+bool stampOf(const std::filesystem::path& source, SourceStamp& outStamp) {
+    std::error_code error;
+    outStamp.size = std::filesystem::file_size(source, error);
+    if (error)
+        return false;
+    outStamp.time = (int64_t)std::filesystem::last_write_time(source, error).time_since_epoch().count();
+    return !error;
+}
+
+size_t blockBytes(CookedFormat format) {
+    return format == CookedFormat::BC3 ? 16 : 8;
+}
+
+size_t levelSize(CookedFormat format, int width, int height) {
+    return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4) * blockBytes(format);
+}
+
+// Box filter down to the next level; odd edges reuse their last row or column
+std::vector<uint8_t> downsample(const std::vector<uint8_t>& pixels, int width, int height, int channels) {
+    int outWidth = std::max(width / 2, 1);
+    int outHeight = std::max(height / 2, 1);
+    std::vector<uint8_t> out((size_t)outWidth * outHeight * channels);
+
+    for (int y = 0; y < outHeight; y++) {
+        int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+        for (int x = 0; x < outWidth; x++) {
+            int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+            for (int c = 0; c < channels; c++) {
+                int sum = pixels[((size_t)y0 * width + x0) * channels + c] + pixels[((size_t)y0 * width + x1) * channels + c]
+                    + pixels[((size_t)y1 * width + x0) * channels + c] + pixels[((size_t)y1 * width + x1) * channels + c];
+                out[((size_t)y * outWidth + x) * channels + c] = (uint8_t)((sum + 2) / 4);
+            }
+        }
+    }
+    return out;
+}
+
+// The 4x4 block at (blockX, blockY), clamped at the image edges
+void fetchBlock(const uint8_t* pixels, int width, int height, int channels, int blockX, int blockY, uint8_t outBlock[16][4]) {
+    for (int y = 0; y < 4; y++) {
+        int sy = std::min(blockY * 4 + y, height - 1);
+        for (int x = 0; x < 4; x++) {
+            int sx = std::min(blockX * 4 + x, width - 1);
+            const uint8_t* pixel = &pixels[((size_t)sy * width + sx) * channels];
+            for (int c = 0; c < 4; c++)
+                outBlock[y * 4 + x][c] = c < channels ? pixel[c] : 255;
+        }
+    }
+}
+
+uint16_t pack565(const float color[3]) {
+    int r = std::clamp((int)(color[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+    int g = std::clamp((int)(color[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+    int b = std::clamp((int)(color[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+    return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+void unpack565(uint16_t packed, int outColor[3]) {
+    int r = packed >> 11 & 31, g = packed >> 5 & 63, b = packed & 31;
+    outColor[0] = r << 3 | r >> 2;
+    outColor[1] = g << 2 | g >> 4;
+    outColor[2] = b << 3 | b >> 2;
+}
+
+// Endpoints are the block's extremes along its principal axis, found by power
+// iteration on the color covariance. Always four-color mode, so the same
+// block also serves as BC3's color half.
+void encodeColorBlock(const uint8_t block[16][4], uint8_t* out) {
+    float mean[3] = {};
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += block[i][c] / 16.0f;
+
+    float cov[6] = {};  // xx xy xz yy yz zz
+    for (int i = 0; i < 16; i++) {
+        float d[3] = { block[i][0] - mean[0], block[i][1] - mean[1], block[i][2] - mean[2] };
+        cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+        cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+    }
+
+    float axis[3] = { 0.299f, 0.587f, 0.114f };
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[3] = {
+            cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+            cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+            cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2] };
+        float length = std::max({ std::abs(next[0]), std::abs(next[1]), std::abs(next[2]) });
+        if (length < 1e-6f)
+            break;  // flat block, any axis will do
+        for (int c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+
+    int minIndex = 0, maxIndex = 0;
+    float minDot = FLT_MAX, maxDot = -FLT_MAX;
+    for (int i = 0; i < 16; i++) {
+        float dot = block[i][0] * axis[0] + block[i][1] * axis[1] + block[i][2] * axis[2];
+        if (dot < minDot) { minDot = dot; minIndex = i; }
+        if (dot > maxDot) { maxDot = dot; maxIndex = i; }
+    }
+
+    float high[3] = { (float)block[maxIndex][0], (float)block[maxIndex][1], (float)block[maxIndex][2] };
+    float low[3] = { (float)block[minIndex][0], (float)block[minIndex][1], (float)block[minIndex][2] };
+    uint16_t color0 = pack565(high), color1 = pack565(low);
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        int palette[4][3];
+        unpack565(color0, palette[0]);
+        unpack565(color1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestError = INT32_MAX;
+            for (int p = 0; p < 4; p++) {
+                int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+                int error = dr * dr + dg * dg + db * db;
+                if (error < bestError) { bestError = error; best = p; }
+            }
+            indices |= (uint32_t)best << (i * 2);
+        }
+    }
+
+    out[0] = (uint8_t)(color0 & 0xFF); out[1] = (uint8_t)(color0 >> 8);
+    out[2] = (uint8_t)(color1 & 0xFF); out[3] = (uint8_t)(color1 >> 8);
+    std::memcpy(out + 4, &indices, 4);
+}
+
+// BC4, and BC3's alpha half: min and max with six steps between
+void encodeSingleChannelBlock(const uint8_t block[16][4], int channel, uint8_t* out) {
+    int high = 0, low = 255;
+    for (int i = 0; i < 16; i++) {
+        high = std::max(high, (int)block[i][channel]);
+        low = std::min(low, (int)block[i][channel]);
+    }
+
+    uint64_t indices = 0;
+    if (high != low) {
+        int palette[8] = { high, low };
+        for (int k = 2; k < 8; k++)
+            palette[k] = ((8 - k) * high + (k - 1) * low) / 7;
+
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestError = INT32_MAX;
+            for (int p = 0; p < 8; p++) {
+                int error = std::abs(block[i][channel] - palette[p]);
+                if (error < bestError) { bestError = error; best = p; }
+            }
+            indices |= (uint64_t)best << (i * 3);
+        }
+    }
+
+    out[0] = (uint8_t)high;
+    out[1] = (uint8_t)low;
+    for (int b = 0; b < 6; b++)
+        out[2 + b] = (uint8_t)(indices >> (b * 8));
+}
+
+void compressLevel(const uint8_t* pixels, int width, int height, int channels, CookedFormat format, uint8_t* out) {
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    uint8_t block[16][4];
+    for (int by = 0; by < blocksY; by++) {
+        for (int bx = 0; bx < blocksX; bx++) {
+            fetchBlock(pixels, width, height, channels, bx, by, block);
+            switch (format) {
+            case CookedFormat::BC1:
+                encodeColorBlock(block, out);
+                break;
+            case CookedFormat::BC3:
+                encodeSingleChannelBlock(block, 3, out);
+                encodeColorBlock(block, out + 8);
+                break;
+            case CookedFormat::BC4:
+                encodeSingleChannelBlock(block, 0, out);
+                break;
+            }
+            out += blockBytes(format);
+        }
+    }
+}
+
+bool isImageFile(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp";
+}
+
+bool isUpToDate(const std::filesystem::path& source) {
+    std::ifstream file(cookedPathFor(source), std::ios::binary);
+    FileHeader header;
+    SourceStamp stamp;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || !stampOf(source, stamp))
+        return false;
+    return std::memcmp(header.magic, cMagic, 4) == 0 && header.version == cVersion
+        && header.sourceSize == stamp.size && header.sourceTime == stamp.time;
+}
+
+bool hasS3tc() {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (name && std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+            return true;
+    }
+    return false;
+}
+
+}
+
+std::filesystem::path cookedPathFor(const std::filesystem::path& source) {
+    std::filesystem::path cooked = source;
+    cooked += ".ftex";
+    return cooked;
+}
+
+bool cookTexture(const std::filesystem::path& source, CookStats* stats) {
+    SourceStamp stamp;
+    int width, height, fileChannels;
+    unsigned char* decoded = stampOf(source, stamp) ? stbi_load(source.string().c_str(), &width, &height, &fileChannels, 0) : nullptr;
+    if (!decoded) {
+        std::cout << "Texture failed to cook: " << source.string() << std::endl;
+        return false;
+    }
+
+    // Grey + alpha is widened to RGBA, everything else keeps its channels or gains opaque alpha
+    int channels = fileChannels == 1 ? 1 : 4;
+    std::vector<uint8_t> pixels((size_t)width * height * channels);
+    bool hasAlpha = false;
+    for (size_t i = 0; i < (size_t)width * height; i++) {
+        const unsigned char* in = decoded + i * fileChannels;
+        uint8_t* out = &pixels[i * channels];
+        if (channels == 1) {
+            out[0] = in[0];
+            continue;
+        }
+        out[0] = in[0];
+        out[1] = fileChannels >= 3 ? in[1] : in[0];
+        out[2] = fileChannels >= 3 ? in[2] : in[0];
+        out[3] = fileChannels == 4 ? in[3] : fileChannels == 2 ? in[1] : 255;
+        hasAlpha |= out[3] != 255;
+    }
+    stbi_image_free(decoded);
+
+    CookedTexture texture;
+    texture.format = channels == 1 ? CookedFormat::BC4 : hasAlpha ? CookedFormat::BC3 : CookedFormat::BC1;
+
+    uint64_t uncompressedBytes = 0;
+    int levelWidth = width, levelHeight = height;
+    for (;;) {
+        CookedMip mip;
+        mip.width = levelWidth;
+        mip.height = levelHeight;
+        mip.offset = texture.data.size();
+        mip.size = levelSize(texture.format, levelWidth, levelHeight);
+        texture.data.resize(mip.offset + mip.size);
+        compressLevel(pixels.data(), levelWidth, levelHeight, channels, texture.format, &texture.data[mip.offset]);
+        texture.mips.push_back(mip);
+        uncompressedBytes += (uint64_t)levelWidth * levelHeight * 4;
+
+        if (levelWidth == 1 && levelHeight == 1)
+            break;
+        pixels = downsample(pixels, levelWidth, levelHeight, channels);
+        levelWidth = std::max(levelWidth / 2, 1);
+        levelHeight = std::max(levelHeight / 2, 1);
+    }
+
+    FileHeader header;
+    std::memcpy(header.magic, cMagic, 4);
+    header.version = cVersion;
+    header.format = (uint32_t)texture.format;
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+    header.mipCount = (uint32_t)texture.mips.size();
+    header.sourceSize = stamp.size;
+    header.sourceTime = stamp.time;
+
+    // Written aside and renamed over, so the game never reads a half-written file
+    std::filesystem::path target = cookedPathFor(source);
+    std::filesystem::path temporary = target;
+    temporary += ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const CookedMip& mip : texture.mips) {
+            uint32_t size = (uint32_t)mip.size;
+            file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        }
+        file.write(reinterpret_cast<const char*>(texture.data.data()), (std::streamsize)texture.data.size());
+        file.close();
+        if (!file) {
+            std::cout << "Failed to write " << temporary.string() << std::endl;
+            std::error_code ignored;
+            std::filesystem::remove(temporary, ignored);
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, target, error);
+    if (error) {
+        std::cout << "Failed to replace " << target.string() << ": " << error.message() << std::endl;
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+
+    if (stats) {
+        stats->cooked++;
+        stats->sourceBytes += uncompressedBytes;
+        stats->cookedBytes += texture.data.size();
+    }
+    return true;
+}
+
+CookStats cookTextures(const std::filesystem::path& directory, JobSystem& jobSystem, bool force) {
+    CookStats stats;
+    std::vector<std::filesystem::path> sources;
+    std::error_code error;
+    // Non-throwing iteration: without exceptions a file vanishing mid-scan would abort
+    for (auto it = std::filesystem::recursive_directory_iterator(directory, error);
+        !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+        std::error_code fileError;
+        if (!it->is_regular_file(fileError) || !isImageFile(it->path()))
+            continue;
+        if (!force && isUpToDate(it->path()))
+            stats.upToDate++;
+        else
+            sources.push_back(it->path());
+    }
+    if (error)
+        std::cout << "Failed to scan " << directory.string() << ": " << error.message() << std::endl;
+
+    // One job per worker pulling files off a shared counter, so a big directory
+    // doesn't run the job system out of job slots
+    std::atomic<size_t> next{ 0 };
+    std::mutex statsMutex;
+    int workers = std::max(1, std::min(jobSystem.GetMaxConcurrency(), (int)sources.size()));
+
+    JobSystem::Barrier* barrier = jobSystem.CreateBarrier();
+    for (int w = 0; w < workers; w++) {
+        JobHandle job = jobSystem.CreateJob("CookTextures", Color::sGreen, [&]() {
+            CookStats local;
+            for (size_t i = next++; i < sources.size(); i = next++) {
+                if (!cookTexture(sources[i], &local))
+                    local.failed++;
+            }
+
+            std::lock_guard<std::mutex> lock(statsMutex);
+            stats.cooked += local.cooked;
+            stats.failed += local.failed;
+            stats.sourceBytes += local.sourceBytes;
+            stats.cookedBytes += local.cookedBytes;
+        });
+        barrier->AddJob(job);
+    }
+    jobSystem.WaitForJobs(barrier);
+    jobSystem.DestroyBarrier(barrier);
+
+    return stats;
+}
+
+bool loadCookedTexture(const std::filesystem::path& source, CookedTexture& outTexture) {
+    std::ifstream file(cookedPathFor(source), std::ios::binary);
+    if (!file)
+        return false;
+
+    FileHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, cMagic, 4) != 0
+        || header.version != cVersion || header.mipCount == 0 || header.mipCount > 32) {
+        std::cout << "Ignoring unreadable cooked texture for " << source.string() << std::endl;
+        return false;
+    }
+
+    // Shipping builds may leave the sources out; only a source that changed makes the cook stale
+    SourceStamp stamp;
+    if (stampOf(source, stamp) && (header.sourceSize != stamp.size || header.sourceTime != stamp.time)) {
+        std::cout << "Cooked texture is stale, decoding " << source.string() << std::endl;
+        return false;
+    }
+
+    outTexture.format = (CookedFormat)header.format;
+    outTexture.mips.resize(header.mipCount);
+    size_t offset = 0;
+    int width = (int)header.width, height = (int)header.height;
+    for (CookedMip& mip : outTexture.mips) {
+        uint32_t size = 0;
+        file.read(reinterpret_cast<char*>(&size), sizeof(size));
+        mip.width = width;
+        mip.height = height;
+        mip.offset = offset;
+        mip.size = size;
+        offset += size;
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+
+    outTexture.data.resize(offset);
+    if (!file.read(reinterpret_cast<char*>(outTexture.data.data()), (std::streamsize)offset)) {
+        std::cout << "Cooked texture for " << source.string() << " is truncated" << std::endl;
+        outTexture = CookedTexture();
+        return false;
+    }
+    return true;
+}
+
+bool uploadCookedTexture(const CookedTexture& texture) {
+    static const bool s3tcSupported = hasS3tc();
+
+    GLenum internalFormat;
+    switch (texture.format) {
+    case CookedFormat::BC1:
+        internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        break;
+    case CookedFormat::BC3:
+        internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        break;
+    case CookedFormat::BC4:
+        internalFormat = GL_COMPRESSED_RED_RGTC1;  // core since 3.0
+        break;
+    default:
+        return false;
+    }
+    if (texture.format != CookedFormat::BC4 && !s3tcSupported)
+        return false;
+
+    for (size_t level = 0; level < texture.mips.size(); level++) {
+        const CookedMip& mip = texture.mips[level];
+        glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, internalFormat, mip.width, mip.height, 0,
+            (GLsizei)mip.size, &texture.data[mip.offset]);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture.mips.size() - 1);
+    return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Jolt/Jolt.h>
+#include <Jolt/Core/JobSystem.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Block-compressed formats a cooked texture can hold. All of them use 4x4
+// blocks; BC4 and BC1 take 8 bytes per block, BC3 takes 16.
+enum class CookedFormat : uint32_t {
+    BC1 = 1,  // RGB, opaque
+    BC3 = 2,  // RGBA, BC4-style alpha block + BC1 color block
+    BC4 = 3,  // single channel, sampled as red
+};
+
+struct CookedMip {
+    int width = 0, height = 0;
+    size_t offset = 0, size = 0;  // into CookedTexture::data
+};
+
+// A full mip chain, compressed and ready for glCompressedTexImage2D
+struct CookedTexture {
+    CookedFormat format = CookedFormat::BC1;
+    std::vector<CookedMip> mips;
+    std::vector<uint8_t> data;
+
+    bool empty() const { return mips.empty(); }
+};
+
+struct CookStats {
+    uint32_t cooked = 0;
+    uint32_t upToDate = 0;
+    uint32_t failed = 0;
+    uint64_t sourceBytes = 0;  // decoded RGBA8 with a full mip chain, what glGenerateMipmap would allocate
+    uint64_t cookedBytes = 0;
+};
+
+// Cooked files sit next to their source with .ftex appended: wall.png -> wall.png.ftex
+std::filesystem::path cookedPathFor(const std::filesystem::path& source);
+
+// Decodes the image, builds every mip level with a box filter and block
+// compresses each one. The source's size and write time go into the header so
+// stale files can be spotted.
+bool cookTexture(const std::filesystem::path& source, CookStats* stats = nullptr);
+
+// Cooks every image under directory whose .ftex is missing or stale, or all of
+// them with force, spreading the files over the job system
+CookStats cookTextures(const std::filesystem::path& directory, JPH::JobSystem& jobSystem, bool force = false);
+
+// Loads source's cooked file. False if there is none or it no longer matches
+// the source, in which case the caller decodes the source itself.
+bool loadCookedTexture(const std::filesystem::path& source, CookedTexture& outTexture);
+
+// Uploads every level into the texture bound to GL_TEXTURE_2D. False if the
+// driver can't sample the format, having uploaded nothing.
+bool uploadCookedTexture(const CookedTexture& texture);
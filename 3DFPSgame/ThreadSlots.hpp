@@ -0,0 +1,18 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// A small dense index per thread, handed out on first use and kept for the
+// thread's lifetime. Lets per-thread buffers be plain arrays indexed without
+// locks or hashing. Threads past cMaxThreadSlots get cNoThreadSlot and have to
+// take a slower shared path.
+inline constexpr uint32_t cMaxThreadSlots = 64;
+inline constexpr uint32_t cNoThreadSlot = ~0u;
+
+inline uint32_t currentThreadSlot()
+{
+    static std::atomic<uint32_t> sNextSlot{ 0 };
+    thread_local uint32_t slot = sNextSlot.fetch_add(1, std::memory_order_relaxed);
+    return slot < cMaxThreadSlots ? slot : cNoThreadSlot;
+}
@@ -0,0 +1,123 @@
+#include "Weapons.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static std::string trim(const std::string& text) {
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string::npos)
+        return "";
+    size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+bool WeaponTable::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cout << "Failed to open weapon definitions: " << path << std::endl;
+        return false;
+    }
+
+    mWeapons.clear();
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+        line = trim(line);
+        if (line.empty())
+            continue;
+
+        if (line.front() == '[' && line.back() == ']') {
+            WeaponDef weapon;
+            weapon.name = trim(line.substr(1, line.size() - 2));
+            mWeapons.push_back(weapon);
+            continue;
+        }
+
+        size_t equals = line.find('=');
+        if (equals == std::string::npos || mWeapons.empty()) {
+            std::cout << path << ":" << lineNumber << ": expected 'key = value' inside a [weapon] section" << std::endl;
+            continue;
+        }
+
+        std::string key = trim(line.substr(0, equals));
+        std::string value = trim(line.substr(equals + 1));
+        if (!setField(mWeapons.back(), key, value))
+            std::cout << path << ":" << lineNumber << ": bad value for '" << key << "': " << value << std::endl;
+    }
+
+    // Alt-fire borrows another weapon's projectile, so it only resolves once every section is in
+    for (WeaponDef& weapon : mWeapons) {
+        if (weapon.altFire.empty())
+            continue;
+        const WeaponDef* alt = find(weapon.altFire);
+        if (!alt || alt->mode != FireMode::Projectile) {
+            std::cout << path << ": [" << weapon.name << "] alt_fire must name a projectile weapon: " << weapon.altFire << std::endl;
+            continue;
+        }
+        weapon.hasAltFire = true;
+        weapon.altProjectile = alt->projectile;
+        weapon.altProjectile.damage = alt->damage;
+    }
+
+    std::cout << "Loaded " << mWeapons.size() << " weapons from " << path << std::endl;
+    return !mWeapons.empty();
+}
+
+bool WeaponTable::setField(WeaponDef& weapon, const std::string& key, const std::string& value) {
+    std::istringstream stream(value);
+
+    if (key == "mode") {
+        if (value == "hitscan")         weapon.mode = FireMode::Hitscan;
+        else if (value == "pellets")    weapon.mode = FireMode::Pellets;
+        else if (value == "projectile") weapon.mode = FireMode::Projectile;
+        else return false;
+        return true;
+    }
+    if (key == "alt_fire") {
+        weapon.altFire = value;
+        return !value.empty();
+    }
+    if (key == "automatic") {
+        weapon.automatic = value == "true" || value == "1";
+        return value == "true" || value == "false" || value == "1" || value == "0";
+    }
+
+    float* floatField = nullptr;
+    if (key == "fire_interval")           floatField = &weapon.fireInterval;
+    else if (key == "reload_time")        floatField = &weapon.reloadTime;
+    else if (key == "damage")             floatField = &weapon.damage;
+    else if (key == "range")              floatField = &weapon.range;
+    else if (key == "falloff_start")      floatField = &weapon.falloffStart;
+    else if (key == "falloff_end")        floatField = &weapon.falloffEnd;
+    else if (key == "falloff_min_scale")  floatField = &weapon.falloffMinScale;
+    else if (key == "spread")             floatField = &weapon.spreadDegrees;
+    else if (key == "projectile_speed")   floatField = &weapon.projectile.speed;
+    else if (key == "projectile_drag")    floatField = &weapon.projectile.drag;
+    else if (key == "projectile_gravity") floatField = &weapon.projectile.gravityScale;
+    else if (key == "projectile_lifetime") floatField = &weapon.projectile.lifetime;
+    else if (key == "explosion_radius")   floatField = &weapon.projectile.explosionRadius;
+
+    if (floatField)
+        return static_cast<bool>(stream >> *floatField);
+
+    if (key == "magazine")
+        return static_cast<bool>(stream >> weapon.magazineSize);
+    if (key == "pellets")
+        return static_cast<bool>(stream >> weapon.pellets) && weapon.pellets > 0;
+
+    return false;
+}
+
+const WeaponDef* WeaponTable::find(const std::string& name) const {
+    for (const WeaponDef& weapon : mWeapons) {
+        if (weapon.name == name)
+            return &weapon;
+    }
+    return nullptr;
+}
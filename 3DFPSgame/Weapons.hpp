@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Projectiles.hpp"
+
+#include <string>
+#include <vector>
+
+enum class FireMode : uint8_t {
+    Hitscan,     // one ray per shot
+    Pellets,     // several spread rays per shot, shotguns
+    Projectile   // simulated by ProjectileSystem
+};
+
+// Everything a designer can tune about a weapon. The defaults are the original
+// hard-coded rifle, which is also what a Gun carries before anything is equipped.
+struct WeaponDef {
+    std::string name = "rifle";
+    FireMode mode = FireMode::Hitscan;
+    bool automatic = true;            // keeps firing while the trigger is held
+
+    float fireInterval = 0.2f;        // seconds per shot
+    float reloadTime = 3.0f;          // seconds
+    unsigned int magazineSize = 30;
+
+    float damage = 25.0f;             // per ray or projectile
+    float range = 100000.0f;          // meters
+    float falloffStart = 0.0f;        // full damage up to here...
+    float falloffEnd = 0.0f;          // ...scaled down to falloffMinScale by here
+    float falloffMinScale = 1.0f;
+
+    float spreadDegrees = 0.0f;       // cone half-angle
+    unsigned int pellets = 1;
+
+    ProjectileParams projectile;      // used by FireMode::Projectile
+
+    std::string altFire;              // projectile weapon the alt-fire launches, by name
+    bool hasAltFire = false;          // set when the table resolves altFire
+    ProjectileParams altProjectile;   // copied from that weapon, damage included
+
+    bool hasSpread() const { return spreadDegrees > 0.0f; }
+    bool hasFalloff() const { return falloffEnd > falloffStart && falloffMinScale < 1.0f; }
+};
+
+// Flat table of weapons loaded once at startup. Slots are file order.
+//
+// Format: an INI-like list of sections, one per weapon:
+//   [shotgun]
+//   mode = pellets
+//   pellets = 8
+//   spread = 6
+class WeaponTable {
+public:
+    bool load(const std::string& path);
+
+    size_t size() const { return mWeapons.size(); }
+    const WeaponDef& operator[](size_t slot) const { return mWeapons[slot]; }
+    const WeaponDef* find(const std::string& name) const;
+
+private:
+    bool setField(WeaponDef& weapon, const std::string& key, const std::string& value);
+
+    std::vector<WeaponDef> mWeapons;
+};
@@ -0,0 +1,413 @@
+#include "WorldPartition.hpp"
+#include "Model.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <filesystem>
+#include <utility>
+
+// Persistent placements all go into one cell that is never streamed out
+static constexpr int cPersistentCell = INT_MIN;
+
+WorldPartition::WorldPartition(Physics& inPhysics, ShapeCache& inShapeCache, const WorldPartitionSettings& inSettings)
+    : mPhysics(inPhysics),
+    mShapeCache(inShapeCache),
+    mSettings(inSettings) {
+
+    mWorker = std::thread(&WorldPartition::workerLoop, this);
+}
+
+WorldPartition::~WorldPartition() {
+    {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        mStopping = true;
+        mJobs.clear();
+    }
+    mQueueCondition.notify_all();
+    mWorker.join();
+
+    for (LoadResult& result : mResults)
+        discard(result);
+    mResults.clear();
+
+    // Only the physics side is torn down here, the GL context is usually gone by now
+    for (auto& [key, cell] : mCells) {
+        if (cell.state == CellState::Loaded)
+            mPhysics.despawnBodies(cell.bodyIDs);
+    }
+}
+
+bool WorldPartition::load(const std::string& scenePath) {
+    if (!loadSceneFile(scenePath, mPlacements))
+        return false;
+
+    for (size_t i = 0; i < mPlacements.size(); i++) {
+        const ScenePlacement& placement = mPlacements[i];
+
+        CellKey key;
+        if (placement.persistent) {
+            key = { cPersistentCell, cPersistentCell };
+        }
+        else {
+            key.x = (int)std::floor(placement.position.x / mSettings.cellSize);
+            key.z = (int)std::floor(placement.position.z / mSettings.cellSize);
+        }
+
+        Cell& cell = mCells[key];
+        cell.placements.push_back(i);
+        cell.persistent = placement.persistent;
+        cell.min = glm::vec2(key.x, key.z) * mSettings.cellSize;
+        cell.max = cell.min + glm::vec2(mSettings.cellSize);
+    }
+
+    std::cout << "World partition: " << mPlacements.size() << " placements in " << mCells.size() << " cells" << std::endl;
+    return true;
+}
+
+void WorldPartition::markWanted(const std::vector<glm::vec3>& activePositions) {
+    for (auto& [key, cell] : mCells) {
+        if (cell.persistent) {
+            cell.wanted = true;
+            continue;
+        }
+
+        // Distance from each position to the cell rectangle on the XZ plane
+        float closest = FLT_MAX;
+        for (const glm::vec3& position : activePositions) {
+            glm::vec2 p(position.x, position.z);
+            glm::vec2 d = glm::max(glm::max(cell.min - p, p - cell.max), glm::vec2(0.0f));
+            closest = std::min(closest, glm::length(d));
+        }
+
+        if (closest <= mSettings.loadRadius)
+            cell.wanted = true;
+        else if (closest > mSettings.unloadRadius)
+            cell.wanted = false;
+        // In between: keep whatever was decided last, that's the hysteresis band
+    }
+}
+
+void WorldPartition::update(const std::vector<glm::vec3>& activePositions) {
+    markWanted(activePositions);
+
+    std::vector<LoadJob> toLoad;
+    for (auto& [key, cell] : mCells) {
+        if (cell.wanted && cell.state == CellState::Unloaded) {
+            cell.state = CellState::Loading;
+            toLoad.push_back({ key, cell.placements });
+        }
+        else if (!cell.wanted && cell.state == CellState::Loaded) {
+            unloadCell(cell);
+        }
+    }
+
+    if (!toLoad.empty()) {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        mJobs.insert(mJobs.end(), std::make_move_iterator(toLoad.begin()), std::make_move_iterator(toLoad.end()));
+        mJobsInFlight += (int)toLoad.size();
+    }
+    mQueueCondition.notify_one();
+
+    // Body IDs are handed out in creation order, so a deterministic run cannot let
+    // the loader's timing decide which frame a cell shows up in
+    bool synchronous = mPhysics.isDeterministic();
+    if (synchronous)
+        waitUntilIdle();
+
+    std::vector<LoadResult> ready;
+    {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        size_t count = synchronous ? mResults.size() : std::min(mResults.size(), (size_t)mSettings.maxFinalizesPerUpdate);
+        ready.assign(std::make_move_iterator(mResults.begin()), std::make_move_iterator(mResults.begin() + count));
+        mResults.erase(mResults.begin(), mResults.begin() + count);
+    }
+
+    if (synchronous) {
+        std::sort(ready.begin(), ready.end(), [](const LoadResult& a, const LoadResult& b) {
+            return a.key.x != b.key.x ? a.key.x < b.key.x : a.key.z < b.key.z;
+        });
+    }
+
+    for (LoadResult& result : ready) {
+        if (!result.modelPath.empty()) {
+            swapReloadedModel(result);
+            continue;
+        }
+        Cell& cell = mCells[result.key];
+        if (cell.wanted)
+            finalize(result);
+        else
+            discard(result);
+    }
+}
+
+void WorldPartition::preload(const std::vector<glm::vec3>& activePositions) {
+    update(activePositions);
+    waitUntilIdle();
+
+    int savedBudget = mSettings.maxFinalizesPerUpdate;
+    mSettings.maxFinalizesPerUpdate = INT_MAX;
+    update(activePositions);
+    mSettings.maxFinalizesPerUpdate = savedBudget;
+}
+
+void WorldPartition::waitUntilIdle() {
+    std::unique_lock<std::mutex> lock(mQueueMutex);
+    mIdleCondition.wait(lock, [this] { return mJobsInFlight == 0; });
+}
+
+void WorldPartition::workerLoop() {
+    for (;;) {
+        LoadJob job;
+        {
+            std::unique_lock<std::mutex> lock(mQueueMutex);
+            mQueueCondition.wait(lock, [this] { return mStopping || !mJobs.empty(); });
+            if (mStopping)
+                return;
+
+            job = std::move(mJobs.front());
+            mJobs.pop_front();
+        }
+
+        LoadResult result;
+        if (!job.modelPath.empty()) {
+            result.key = job.key;
+            result.modelPath = job.modelPath;
+            result.models.push_back(std::make_shared<Model>(job.modelPath, true, &mSettings.lod));
+        }
+        else
+            result = loadCell(job);
+        {
+            std::lock_guard<std::mutex> lock(mQueueMutex);
+            mResults.push_back(std::move(result));
+            mJobsInFlight--;
+        }
+        mIdleCondition.notify_all();
+    }
+}
+
+WorldPartition::LoadResult WorldPartition::loadCell(const LoadJob& job) {
+    LoadResult result;
+    result.key = job.key;
+    result.models.reserve(job.placements.size());
+
+    std::vector<JPH::BodyCreationSettings> bodySettings;
+    for (size_t index : job.placements) {
+        const ScenePlacement& placement = mPlacements[index];
+
+        std::shared_ptr<Model> model = acquireModel(placement.modelPath);
+        result.models.push_back(model);
+
+        JPH::ShapeRefC shape = mShapeCache.getOrBuild(*model, placement.modelPath, placement.collision, placement.scale);
+        if (shape == nullptr)
+            continue;
+
+        bodySettings.emplace_back(
+            shape,
+            JPH::RVec3(placement.position.x, placement.position.y, placement.position.z),
+            placement.rotation(),
+            JPH::EMotionType::Static,
+            Layers::NON_MOVING);
+    }
+
+    // Building the broadphase subtree for the batch is the expensive half of adding
+    // bodies and is allowed off the main thread
+    result.bodies = mPhysics.prepareBodies(bodySettings);
+    return result;
+}
+
+void WorldPartition::finalize(LoadResult& result) {
+    Cell& cell = mCells[result.key];
+
+    // A model hot reloaded while this cell was loading arrives as the old one
+    {
+        std::lock_guard<std::mutex> lock(mModelMutex);
+        for (size_t i = 0; i < result.models.size(); i++) {
+            auto it = mModels.find(mPlacements[cell.placements[i]].modelPath);
+            if (it != mModels.end())
+                result.models[i] = it->second.model;
+        }
+    }
+
+    // Uploaded by the render thread before the first packet that draws them
+    mPendingUploads.insert(mPendingUploads.end(), result.models.begin(), result.models.end());
+
+    mPhysics.commitBodies(result.bodies, JPH::EActivation::DontActivate);
+    if (mPhysics.floorBodyID.IsInvalid() && !result.bodies.bodyIDs.empty())
+        mPhysics.floorBodyID = result.bodies.bodyIDs.front();
+
+    cell.models = std::move(result.models);
+    cell.bounds.resize(cell.models.size());
+    cell.lods.assign(cell.models.size(), 0);
+    for (size_t i = 0; i < cell.models.size(); i++) {
+        const ScenePlacement& placement = mPlacements[cell.placements[i]];
+        const Model& model = *cell.models[i];
+        cell.bounds[i] = model.hasBounds()
+            ? transformBounds(model.boundsMin, model.boundsMax, placement.modelMatrix)
+            : Bounds{ placement.position, placement.position };
+    }
+    cell.bodyIDs = std::move(result.bodies.bodyIDs);
+    cell.state = CellState::Loaded;
+
+    mResidentCells++;
+    mResidentBodies += cell.bodyIDs.size();
+}
+
+void WorldPartition::discard(LoadResult& result) {
+    if (!result.modelPath.empty())
+        return;
+    mPhysics.abortBodies(result.bodies);
+
+    Cell& cell = mCells[result.key];
+    for (size_t i = 0; i < result.models.size(); i++)
+        releaseModel(mPlacements[cell.placements[i]].modelPath);
+
+    cell.state = CellState::Unloaded;
+}
+
+void WorldPartition::unloadCell(Cell& cell) {
+    mPhysics.despawnBodies(cell.bodyIDs);
+    if (std::find(cell.bodyIDs.begin(), cell.bodyIDs.end(), mPhysics.floorBodyID) != cell.bodyIDs.end())
+        mPhysics.floorBodyID = JPH::BodyID();
+
+    for (size_t i = 0; i < cell.models.size(); i++)
+        releaseModel(mPlacements[cell.placements[i]].modelPath);
+
+    mResidentCells--;
+    mResidentBodies -= cell.bodyIDs.size();
+
+    cell.models.clear();
+    cell.bounds.clear();
+    cell.lods.clear();
+    cell.bodyIDs.clear();
+    cell.state = CellState::Unloaded;
+}
+
+size_t WorldPartition::reloadModels(const std::string& changedFile) {
+    std::vector<LoadJob> jobs;
+    {
+        std::lock_guard<std::mutex> lock(mModelMutex);
+        for (const auto& [path, entry] : mModels) {
+            if (entry.model->usesFile(changedFile))
+                jobs.push_back({ { 0, 0 }, {}, path });
+        }
+    }
+    if (jobs.empty())
+        return 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        mJobs.insert(mJobs.end(), std::make_move_iterator(jobs.begin()), std::make_move_iterator(jobs.end()));
+        mJobsInFlight += (int)jobs.size();
+    }
+    mQueueCondition.notify_one();
+    return jobs.size();
+}
+
+void WorldPartition::swapReloadedModel(LoadResult& result) {
+    std::shared_ptr<Model>& reloaded = result.models.front();
+    if (reloaded->meshes.empty()) {
+        // Most likely caught halfway through an export; the next write triggers another try
+        std::cout << "Reload of " << result.modelPath << " failed, keeping the old model" << std::endl;
+        return;
+    }
+
+    std::shared_ptr<Model> previous;
+    {
+        std::lock_guard<std::mutex> lock(mModelMutex);
+        auto it = mModels.find(result.modelPath);
+        if (it == mModels.end())
+            return;  // streamed out while it was loading
+        previous = std::exchange(it->second.model, reloaded);
+        mPendingReleases.push_back(previous);
+    }
+    mPendingUploads.push_back(reloaded);
+
+    for (auto& [key, cell] : mCells) {
+        for (size_t i = 0; i < cell.models.size(); i++) {
+            if (cell.models[i] != previous)
+                continue;
+            const ScenePlacement& placement = mPlacements[cell.placements[i]];
+            cell.models[i] = reloaded;
+            cell.bounds[i] = reloaded->hasBounds()
+                ? transformBounds(reloaded->boundsMin, reloaded->boundsMax, placement.modelMatrix)
+                : Bounds{ placement.position, placement.position };
+            cell.lods[i] = 0;
+        }
+    }
+    std::cout << "Reloaded " << result.modelPath << std::endl;
+}
+
+std::vector<std::string> WorldPartition::modelDirectories() const {
+    std::vector<std::string> directories;
+    for (const ScenePlacement& placement : mPlacements) {
+        std::string directory = std::filesystem::path(placement.modelPath).parent_path().generic_string();
+        if (directory.empty())
+            directory = ".";
+        if (std::find(directories.begin(), directories.end(), directory) == directories.end())
+            directories.push_back(directory);
+    }
+    return directories;
+}
+
+std::shared_ptr<Model> WorldPartition::acquireModel(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(mModelMutex);
+        auto it = mModels.find(path);
+        if (it != mModels.end()) {
+            it->second.refs++;
+            return it->second.model;
+        }
+    }
+
+    // Only the loader thread creates models, so nobody can race us to this path
+    std::shared_ptr<Model> model = std::make_shared<Model>(path, true, &mSettings.lod);
+
+    std::lock_guard<std::mutex> lock(mModelMutex);
+    ModelEntry& entry = mModels[path];
+    entry.model = model;
+    entry.refs = 1;
+    return model;
+}
+
+void WorldPartition::releaseModel(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mModelMutex);
+    auto it = mModels.find(path);
+    if (it == mModels.end())
+        return;
+
+    if (--it->second.refs == 0) {
+        mPendingReleases.push_back(std::move(it->second.model));
+        mModels.erase(it);
+    }
+}
+
+void WorldPartition::collectDraws(RenderPacket& packet) {
+    packet.uploads.insert(packet.uploads.end(), mPendingUploads.begin(), mPendingUploads.end());
+    mPendingUploads.clear();
+    {
+        std::lock_guard<std::mutex> lock(mModelMutex);
+        packet.releases.insert(packet.releases.end(), mPendingReleases.begin(), mPendingReleases.end());
+        mPendingReleases.clear();
+    }
+
+    glm::vec3 cameraPosition = glm::vec3(glm::inverse(packet.view)[3]);
+    float projectionScale = packet.projection[1][1];
+
+    for (auto& [key, cell] : mCells) {
+        if (cell.state != CellState::Loaded)
+            continue;
+
+        for (size_t i = 0; i < cell.models.size(); i++) {
+            Model* model = cell.models[i].get();
+            if (model->lodCount() > 1) {
+                float size = screenSize(cell.bounds[i], cameraPosition, projectionScale);
+                cell.lods[i] = (uint8_t)selectLod(cell.lods[i], size, model->lodCount(), mSettings.lod);
+            }
+            packet.cameraDraws.push_back((uint32_t)packet.draws.size());
+            packet.draws.push_back({ model, mPlacements[cell.placements[i]].modelMatrix, cell.bounds[i], cell.lods[i] });
+        }
+    }
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "Physics.hpp"
+#include "Scene.hpp"
+#include "ShapeCache.hpp"
+#include "Renderer.hpp"
+#include "Lod.hpp"
+
+#include <glm/glm.hpp>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class Model;
+
+struct WorldPartitionSettings {
+    float cellSize = 64.0f;           // meters, cells are square on the XZ plane
+    float loadRadius = 96.0f;         // cells closer than this to any active position stream in
+    float unloadRadius = 128.0f;      // and only stream out beyond this, so borders don't thrash
+    int maxFinalizesPerUpdate = 2;    // bounds body insertion and GL upload work per frame
+    LodSettings lod;                  // generated on the loader thread, selected in collectDraws
+};
+
+// Splits a scene into a grid of cells and keeps only the cells around active
+// players resident. Model import, shape cooking and body creation run on a loader
+// thread; the main thread only commits the prepared body batch and queues the GL
+// upload for the render thread, so a cell coming in costs one AddBodiesFinalize
+// rather than a stall.
+class WorldPartition {
+public:
+    WorldPartition(Physics& inPhysics, ShapeCache& inShapeCache, const WorldPartitionSettings& inSettings);
+    ~WorldPartition();
+
+    bool load(const std::string& scenePath);
+
+    // Main thread, once per frame
+    void update(const std::vector<glm::vec3>& activePositions);
+
+    // Blocks until every cell around the given positions is resident, for spawning
+    void preload(const std::vector<glm::vec3>& activePositions);
+
+    // Appends the resident models to the packet, all of them to the camera pass,
+    // along with any GL uploads and releases queued since the last call. Picks each instance's level of detail
+    // from its screen size under the packet's camera, so view and projection must
+    // already be set.
+    void collectDraws(RenderPacket& packet);
+
+    // Hot reload: decodes every resident model that uses the file again on the
+    // loader thread, then swaps it in during a later update(). Collision keeps
+    // the shape it was built with. Returns how many models were queued.
+    size_t reloadModels(const std::string& changedFile);
+
+    // Every directory the scene loads models from, for the file watcher
+    std::vector<std::string> modelDirectories() const;
+
+    bool hasCollision() const { return mResidentBodies > 0; }
+    size_t residentCellCount() const { return mResidentCells; }
+    size_t residentBodyCount() const { return mResidentBodies; }
+
+private:
+    struct CellKey {
+        int x, z;
+        bool operator==(const CellKey& other) const { return x == other.x && z == other.z; }
+    };
+
+    struct CellKeyHash {
+        size_t operator()(const CellKey& key) const { return (size_t)(uint32_t)key.x * 73856093u ^ (size_t)(uint32_t)key.z * 19349663u; }
+    };
+
+    enum class CellState { Unloaded, Loading, Loaded };
+
+    struct Cell {
+        std::vector<size_t> placements;
+        glm::vec2 min = glm::vec2(0.0f), max = glm::vec2(0.0f);
+        bool persistent = false;
+        bool wanted = false;
+        CellState state = CellState::Unloaded;
+
+        // Parallel to placements while loaded
+        std::vector<std::shared_ptr<Model>> models;
+        std::vector<Bounds> bounds;
+        std::vector<uint8_t> lods;  // last selected level, for hysteresis
+        std::vector<JPH::BodyID> bodyIDs;
+    };
+
+    struct LoadJob {
+        CellKey key;
+        std::vector<size_t> placements;
+        std::string modelPath;  // set for a hot reload of one model instead of a cell
+    };
+
+    struct LoadResult {
+        CellKey key;
+        std::vector<std::shared_ptr<Model>> models;
+        BodyBatch bodies;
+        std::string modelPath;  // hot reloads only, with the new model in models
+    };
+
+    void workerLoop();
+    LoadResult loadCell(const LoadJob& job);
+    void finalize(LoadResult& result);
+    void discard(LoadResult& result);
+    void swapReloadedModel(LoadResult& result);
+    void unloadCell(Cell& cell);
+    void markWanted(const std::vector<glm::vec3>& activePositions);
+    void waitUntilIdle();
+
+    std::shared_ptr<Model> acquireModel(const std::string& path);
+    void releaseModel(const std::string& path);
+
+    Physics& mPhysics;
+    ShapeCache& mShapeCache;
+    WorldPartitionSettings mSettings;
+
+    std::vector<ScenePlacement> mPlacements;
+    std::unordered_map<CellKey, Cell, CellKeyHash> mCells;
+    size_t mResidentCells = 0;
+    size_t mResidentBodies = 0;
+
+    // Models shared between cells, released from GL once no resident cell uses them
+    struct ModelEntry {
+        std::shared_ptr<Model> model;
+        int refs = 0;
+    };
+    std::mutex mModelMutex;
+    std::unordered_map<std::string, ModelEntry> mModels;
+
+    // GL work handed to the renderer through collectDraws. Releases are pushed
+    // under mModelMutex alongside the refcount they come from.
+    std::vector<std::shared_ptr<Model>> mPendingUploads;
+    std::vector<std::shared_ptr<Model>> mPendingReleases;
+
+    // Loader thread
+    std::thread mWorker;
+    std::mutex mQueueMutex;
+    std::condition_variable mQueueCondition;
+    std::condition_variable mIdleCondition;
+    std::deque<LoadJob> mJobs;
+    std::vector<LoadResult> mResults;
+    int mJobsInFlight = 0;
+    bool mStopping = false;
+};
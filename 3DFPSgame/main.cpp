@@ -11,7 +11,30 @@
 #include "PlayerController.hpp"
 #include "Model.hpp"
 #include "Physics.hpp"
-#include "Shader.hpp"
+#include "WorldPartition.hpp"
+#include "Projectiles.hpp"
+#include "Weapons.hpp"
+#include "Navigation.hpp"
+#include "Bots.hpp"
+#include "Characters.hpp"
+#include "SpatialHash.hpp"
+#include "Memory.hpp"
+#include "Renderer.hpp"
+#include "Occlusion.hpp"
+#include "TextureCook.hpp"
+#include "Determinism.hpp"
+#include "Recording.hpp"
+#include "LoadTest.hpp"
+#include "Metrics.hpp"
+#include "Startup.hpp"
+#include "FileWatcher.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
 
 
 struct GameVars {
@@ -31,21 +54,96 @@ struct GameVars {
 
     bool firstMouse = true;
     bool cursorEnabled = false;
+
+    // Deterministic mode: fixed physics step, per-tick state hashing, input record/replay
+    bool deterministic = false;
+    double tickAccumulator = 0.0;
+    uint64_t tick = 0;
+    int maxTicksPerFrame = 5;
+
+    size_t botCount = 0;
+    bool allocReport = false;
+    bool renderReport = false;
+
+    ShadowSettings shadows;
+    ShadowStats shadowStats;
+    bool occlusionCulling = true;
+    OcclusionStats occlusionStats;
+    bool cpuSkinning = false;
+
+    // Offline texture cooking: cook everything under the directory and exit
+    std::string cookDirectory;
+    bool forceCook = false;
+
+    // Headless network load test: run it and exit
+    bool loadTestEnabled = false;
+    LoadTestSettings loadTest;
+
+    // Prometheus endpoint on localhost, 0 for none, and the F3 overlay of the same numbers
+    uint16_t metricsPort = 0;
+    bool metricsOverlay = false;
+    bool overlayKeyDown = false;
+    double overlayRefreshTime = 0.0;
+    std::string overlayText;
+
+    // Reload shaders and models when their files change on disk
+    bool hotReload = true;
+};
+
+struct DeterminismVars {
+    StateHashLog hashLog;
+    InputRecorder inputRecorder;
+    InputReplayer inputReplayer;
+};
+
+// Match recording and the playback mode that replaces simulation with a recording
+struct MatchVars {
+    MatchRecorder recorder;
+    std::vector<MatchEvent> pendingEvents;  // impacts since the last recorded tick
+    double recordAccumulator = 0.0;
+
+    MatchPlayer player;
+    double playbackTime = 0.0;
+    size_t spectated = 0;
+    std::vector<ActorFrame> previousFrames;
+    std::vector<ActorFrame> shownFrames;   // interpolated between the last two ticks
+};
+
+// Everything that steps with the physics world. Built by the startup graph
+// instead of at static init, so Jolt comes up while the window opens.
+struct SimulationVars {
+    Physics physics;
+    PlayerController playerController;
+    ProjectileSystem projectiles;
+    BotSystem bots;
+
+    SimulationVars(const glm::vec3& startPos, NavGrid& navGrid, const PhysicsCapacity& capacity)
+        : physics(capacity),
+        playerController(startPos, physics),
+        projectiles(physics),
+        bots(physics, navGrid) {
+    }
 };
 
 GameVars gameVars;
-Physics physics;
-PlayerController playerController(gameVars.startPos, physics);
+WeaponTable weapons;
+NavGrid navGrid;
+std::unique_ptr<SimulationVars> sim;
+std::unique_ptr<WorldPartition> world;
+CharacterAnimator characters;
+SpatialHash actorGrid;
+DeterminismVars determinism;
+MatchVars match;
+FileWatcher fileWatcher;
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     gameVars.screenWidth = width;
     gameVars.screenHeight = height;
-    glViewport(0, 0, width, height);
 }
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
-    if (gameVars.cursorEnabled) return;
-    playerController.processMouse(xpos, ypos);
+    if (gameVars.cursorEnabled || determinism.inputReplayer.isOpen()) return;
+    sim->playerController.processMouse(xpos, ypos);
 }
 
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
@@ -60,32 +158,444 @@ void processInput(GLFWwindow* window) {
     gameVars.deltaTime = currentFrame - gameVars.lastFrame;
     gameVars.lastFrame = currentFrame;
 
-    playerController.update(window, gameVars.deltaTime);
+    if (!gameVars.deterministic && !match.player.isOpen())
+        sim->playerController.update(window, gameVars.deltaTime);
 
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
         gameVars.cursorEnabled = true;
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
     }
+
+    bool overlayKey = glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS;
+    if (overlayKey && !gameVars.overlayKeyDown)
+        gameVars.metricsOverlay = !gameVars.metricsOverlay;
+    gameVars.overlayKeyDown = overlayKey;
+}
+
+// The human players bots hunt. Refilled in place, so ticks don't allocate for it.
+const std::vector<glm::vec3>& humanPositions() {
+    static std::vector<glm::vec3> positions(1);
+    positions[0] = sim->playerController.position;
+    return positions;
+}
+
+// Heap allocations charged to each subsystem during the last frame; all zero is the goal
+void reportAllocations() {
+    std::cout << "Allocations last frame:";
+    for (size_t tag = 0; tag < static_cast<size_t>(MemTag::Count); tag++) {
+        AllocationStats stats = Memory::frameStats(static_cast<MemTag>(tag));
+        std::cout << " " << Memory::tagName(static_cast<MemTag>(tag)) << "=" << stats.allocations
+            << " (" << stats.bytes << " B)";
+    }
+    std::cout << " | frame arena high water " << Memory::frameArena().highWater() << " B";
+    if (!Memory::isTrackingGlobalHeap())
+        std::cout << " | game heap untracked, build with FPS_TRACK_ALLOCATIONS";
+    std::cout << std::endl;
+}
+
+void reportRendering() {
+    const ShadowStats& stats = gameVars.shadowStats;
+    std::cout << "Shadow casters:";
+    for (int c = 0; c < gameVars.shadows.cascadeCount; c++)
+        std::cout << " " << stats.casters[c];
+    std::cout << " | culled " << stats.culled << ", too small " << stats.tooSmall
+        << ", over budget " << stats.overBudget << std::endl;
+
+    const OcclusionStats& occlusion = gameVars.occlusionStats;
+    std::cout << "Occlusion: " << occlusion.occluders << " occluders (" << occlusion.occluderTriangles
+        << " triangles), " << occlusion.frustumCulled << " outside frustum, " << occlusion.occluded << " hidden" << std::endl;
+
+    if (characters.isLoaded())
+        std::cout << "Character poses: " << characters.poseSamples() << " sampled, "
+            << characters.poseHits() << " shared" << std::endl;
 }
 
 void updateFPSCounter(GLFWwindow* window) {
+    static Gauge& fpsGauge = Metrics::registry().gauge("fps_frames_per_second", "Frames rendered per second over the last second");
+
     gameVars.frameCount++;
     double currentTime = glfwGetTime();
     double elapsedTime = currentTime - gameVars.fpsTime;
 
     if (elapsedTime >= 1.0f) {
         double fps = gameVars.frameCount / elapsedTime;
+        fpsGauge.set(fps);
         std::stringstream ss;
         ss << "Game window - FPS: " << fps;
         glfwSetWindowTitle(window, ss.str().c_str());
+        if (gameVars.allocReport)
+            reportAllocations();
+        if (gameVars.renderReport)
+            reportRendering();
 
         gameVars.frameCount = 0;
         gameVars.fpsTime = currentTime;
     }
 }
 
-int main() {
+// The registry summary, rebuilt a few times a second so it stays readable
+void updateMetricsOverlay(RenderPacket& packet) {
+    if (!gameVars.metricsOverlay)
+        return;
+
+    double currentTime = glfwGetTime();
+    if (currentTime >= gameVars.overlayRefreshTime) {
+        gameVars.overlayText.clear();
+        Metrics::registry().writeSummary(gameVars.overlayText);
+        gameVars.overlayRefreshTime = currentTime + 0.25;
+    }
+    packet.overlayText = gameVars.overlayText;
+}
+
+// Shader edits ride along with this packet to the render thread; any other file
+// may be a model or one of its textures
+void pollHotReload(RenderPacket& packet) {
+    if (!gameVars.hotReload)
+        return;
+
+    static std::vector<std::string> changed;
+    changed.clear();
+    fileWatcher.poll(changed);
+    for (const std::string& path : changed) {
+        std::string extension = std::filesystem::path(path).extension().string();
+        if (extension == ".vert" || extension == ".frag") {
+            packet.shaderReloads.push_back(path);
+            continue;
+        }
+        world->reloadModels(path);
+        characters.reloadIfUses(path);
+    }
+}
+
+// Where the world streams in: the recorded actors during playback, otherwise the
+// player and the bots as the simulation last left them
+const std::vector<glm::vec3>& streamingPositions() {
+    static std::vector<glm::vec3> positions;
+    positions.clear();
+    if (match.player.isOpen()) {
+        for (const ActorFrame& frame : match.shownFrames)
+            positions.push_back(frame.position);
+    }
+    else {
+        positions.push_back(sim->playerController.position);
+        sim->bots.appendPositions(positions);
+    }
+    return positions;
+}
+
+// Rebuilds the actor grid and applies this tick's explosions to everyone in range.
+// Actor id 0 is the local player, bots follow in spawn order.
+void resolveExplosions() {
+    static constexpr float cKnockbackPerDamage = 0.1f; // m/s per point, a full grenade hit is 8 m/s
+    static std::vector<glm::vec3> actorPositions;
+    static std::vector<uint32_t> caught;
+    actorPositions.clear();
+    actorPositions.push_back(sim->playerController.position);
+    sim->bots.appendPositions(actorPositions);
+    actorGrid.build(actorPositions);
+
+    for (const ProjectileImpact& impact : sim->projectiles.impacts()) {
+        if (impact.explosionRadius <= 0.0f)
+            continue;
+        caught.clear();
+        actorGrid.queryRadius(impact.position, impact.explosionRadius, caught);
+        for (uint32_t actor : caught) {
+            // Away from the blast and a little upwards, fading to nothing at the edge
+            glm::vec3 offset = actorPositions[actor] - impact.position;
+            float falloff = 1.0f - std::min(glm::length(offset) / impact.explosionRadius, 1.0f);
+            glm::vec3 direction = offset + glm::vec3(0.0f, 0.5f, 0.0f);
+            float length = glm::length(direction);
+            direction = length > 1e-4f ? direction / length : glm::vec3(0.0f, 1.0f, 0.0f);
+            glm::vec3 push = direction * (impact.damage * cKnockbackPerDamage * falloff);
+            if (actor == 0)
+                sim->playerController.addKnockback(push);
+            else
+                sim->bots.addKnockback(actor - 1, push);
+        }
+    }
+}
+
+void collectMatchEvents() {
+    if (!match.recorder.isOpen())
+        return;
+    for (const ProjectileImpact& impact : sim->projectiles.impacts()) {
+        MatchEvent event;
+        event.type = MatchEvent::Impact;
+        event.position = impact.position;
+        event.radius = impact.explosionRadius;
+        match.pendingEvents.push_back(event);
+    }
+}
+
+void recordMatchTick() {
+    if (!match.recorder.isOpen())
+        return;
+
+    static std::vector<ActorFrame> frames;
+    frames.clear();
+    ActorFrame player;
+    player.position = sim->playerController.position;
+    player.yaw = sim->playerController.lastInput.yaw;
+    player.pitch = sim->playerController.lastInput.pitch;
+    player.buttons = sim->playerController.lastInput.buttons;
+    player.weaponSlot = sim->playerController.lastInput.weaponSlot;
+    frames.push_back(player);
+    sim->bots.appendActorFrames(frames);
+
+    match.recorder.record(frames, match.pendingEvents);
+    match.pendingEvents.clear();
+}
+
+// Seeks the playback to tick, clamped to the recording
+void seekPlayback(int64_t tick) {
+    uint32_t target = (uint32_t)std::clamp<int64_t>(tick, 0, (int64_t)match.player.tickCount() - 1);
+    if (!match.player.seek(target))
+        return;
+    match.previousFrames = match.player.actors();
+    match.playbackTime = target / match.player.tickRate();
+}
+
+// Playback mode: advances through the recording in real time instead of simulating.
+// Left/Right jump 5 seconds, Up/Down switch the spectated actor.
+void updatePlayback(GLFWwindow* window) {
+    static bool keysHeld[4] = {};
+    const int keys[4] = { GLFW_KEY_LEFT, GLFW_KEY_RIGHT, GLFW_KEY_UP, GLFW_KEY_DOWN };
+    bool pressed[4];
+    for (int k = 0; k < 4; k++) {
+        bool down = glfwGetKey(window, keys[k]) == GLFW_PRESS;
+        pressed[k] = down && !keysHeld[k];
+        keysHeld[k] = down;
+    }
+
+    int64_t jump = (int64_t)(5.0f * match.player.tickRate());
+    if (pressed[0])
+        seekPlayback((int64_t)match.player.currentTick() - jump);
+    if (pressed[1])
+        seekPlayback((int64_t)match.player.currentTick() + jump);
+
+    match.playbackTime += gameVars.deltaTime;
+    double tickTime = match.playbackTime * match.player.tickRate();
+    while (match.player.currentTick() + 1 <= (uint64_t)tickTime) {
+        match.previousFrames = match.player.actors();
+        if (!match.player.step()) {
+            match.playbackTime = match.player.currentTick() / match.player.tickRate();
+            tickTime = match.player.currentTick();
+            break;
+        }
+    }
+
+    float t = (float)std::clamp(tickTime - match.player.currentTick(), 0.0, 1.0);
+    interpolateActors(match.previousFrames, match.player.actors(), t, match.shownFrames);
+
+    size_t actorCount = std::max<size_t>(match.shownFrames.size(), 1);
+    if (pressed[2])
+        match.spectated = (match.spectated + 1) % actorCount;
+    if (pressed[3])
+        match.spectated = (match.spectated + actorCount - 1) % actorCount;
+    match.spectated = std::min(match.spectated, actorCount - 1);
+}
+
+// Everyone but the spectated actor is drawn as a character
+void appendPlaybackCharacters(std::vector<CharacterState>& outCharacters) {
+    for (size_t i = 0; i < match.shownFrames.size(); i++) {
+        if (i == match.spectated)
+            continue;
+        CharacterState state;
+        state.feet = match.shownFrames[i].position - glm::vec3(0.0f, sim->playerController.getFootOffset(), 0.0f);
+        state.yawDegrees = match.shownFrames[i].yaw;
+        outCharacters.push_back(state);
+    }
+}
+
+glm::mat4 spectatorView() {
+    if (match.shownFrames.empty())
+        return sim->playerController.getViewMatrix();
+    const ActorFrame& frame = match.shownFrames[match.spectated];
+    Camera camera(frame.position);
+    camera.updateRotation(frame.yaw, frame.pitch);
+    return camera.getViewMatrix();
+}
+
+// Gameplay reactions to the last physics step, in one pass over the merged contact events
+void processContacts() {
+    static constexpr float cHardLandingSpeed = 8.0f;
+    static Counter& hardLandings = Metrics::registry().counter("fps_hard_landings_total",
+        "Contacts the local player started faster than the hard landing speed");
+
+    for (const ContactEvent& event : sim->physics.getContactEvents()) {
+        if (event.type == ContactEventType::Added && event.involves(sim->playerController.getBodyID())
+            && event.impactSpeed > cHardLandingSpeed)
+            hardLandings.add();
+    }
+}
+
+// One fixed-length simulation tick: input, player, physics, then the state hash
+void simulateTick(GLFWwindow* window) {
+    auto tickStart = std::chrono::steady_clock::now();
+    PlayerInput input;
+    if (determinism.inputReplayer.isOpen()) {
+        if (!determinism.inputReplayer.read(input)) {
+            std::cout << "Input replay finished after " << gameVars.tick << " ticks." << std::endl;
+            glfwSetWindowShouldClose(window, GLFW_TRUE);
+            return;
+        }
+    }
+    else {
+        input = sim->playerController.sampleInput(window);
+    }
+    determinism.inputRecorder.write(input);
+
+    // Cells finish loading on a tick, never on a frame, so their bodies enter the
+    // world (and take their IDs) at the same point in every run
+    {
+        MemTagScope tag(MemTag::Streaming);
+        world->update(streamingPositions());
+    }
+    {
+        MemTagScope tag(MemTag::Gameplay);
+        sim->playerController.update(input, Physics::cFixedTimeStep);
+        sim->bots.update(humanPositions(), Physics::cFixedTimeStep, true);
+    }
+    {
+        MemTagScope tag(MemTag::Physics);
+        sim->physics.update(Physics::cFixedTimeStep);
+    }
+    {
+        MemTagScope tag(MemTag::Gameplay);
+        processContacts();
+        sim->projectiles.update(Physics::cFixedTimeStep);
+        resolveExplosions();
+        collectMatchEvents();
+        recordMatchTick();
+    }
+
+    if (determinism.hashLog.isOpen()) {
+        StateHasher hasher;
+        sim->physics.hashState(hasher);
+        sim->playerController.hashState(hasher);
+        sim->projectiles.hashState(hasher);
+        sim->bots.hashState(hasher);
+        determinism.hashLog.record(gameVars.tick, hasher.digest());
+    }
+    gameVars.tick++;
+
+    std::chrono::duration<double> tickTime = std::chrono::steady_clock::now() - tickStart;
+    Metrics::recordTick(tickTime.count(), Physics::cFixedTimeStep);
+}
+
+void runFixedTicks(GLFWwindow* window) {
+    gameVars.tickAccumulator += gameVars.deltaTime;
+
+    // Drop time we can't catch up on instead of spiralling; a replay then just runs slower
+    int ticks = 0;
+    while (gameVars.tickAccumulator >= Physics::cFixedTimeStep && ticks < gameVars.maxTicksPerFrame) {
+        simulateTick(window);
+        gameVars.tickAccumulator -= Physics::cFixedTimeStep;
+        ticks++;
+    }
+    if (ticks == gameVars.maxTicksPerFrame)
+        gameVars.tickAccumulator = 0.0;
+}
+
+void parseArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        // Matches a flag that takes a value, noting when the value is missing
+        bool missingValue = false;
+        auto withValue = [&](const char* flag) {
+            if (std::strcmp(argv[i], flag) != 0)
+                return false;
+            missingValue = i + 1 >= argc;
+            return !missingValue;
+        };
+
+        if (std::strcmp(argv[i], "--deterministic") == 0) {
+            gameVars.deterministic = true;
+        }
+        else if (withValue("--hash-log")) {
+            gameVars.deterministic = determinism.hashLog.open(argv[++i]) || gameVars.deterministic;
+        }
+        else if (withValue("--record-input")) {
+            gameVars.deterministic = determinism.inputRecorder.open(argv[++i]) || gameVars.deterministic;
+        }
+        else if (withValue("--replay-input")) {
+            gameVars.deterministic = determinism.inputReplayer.open(argv[++i]) || gameVars.deterministic;
+        }
+        else if (withValue("--record-match")) {
+            match.recorder.open(argv[++i], 1.0f / Physics::cFixedTimeStep);
+        }
+        else if (withValue("--play-match")) {
+            match.player.open(argv[++i]);
+        }
+        else if (withValue("--spectate")) {
+            match.spectated = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--alloc-report") == 0) {
+            gameVars.allocReport = true;
+        }
+        else if (std::strcmp(argv[i], "--render-report") == 0) {
+            gameVars.renderReport = true;
+        }
+        else if (std::strcmp(argv[i], "--no-shadows") == 0) {
+            gameVars.shadows.cascadeCount = 0;
+        }
+        else if (std::strcmp(argv[i], "--no-occlusion") == 0) {
+            gameVars.occlusionCulling = false;
+        }
+        else if (withValue("--cook-textures")) {
+            gameVars.cookDirectory = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--force-cook") == 0) {
+            gameVars.forceCook = true;
+        }
+        else if (withValue("--load-test")) {
+            gameVars.loadTestEnabled = true;
+            gameVars.loadTest.clients = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (withValue("--load-test-seconds")) {
+            gameVars.loadTest.durationSeconds = std::strtof(argv[++i], nullptr);
+        }
+        else if (withValue("--net-latency")) {
+            gameVars.loadTest.link.latencyMs = std::strtof(argv[++i], nullptr);
+        }
+        else if (withValue("--net-jitter")) {
+            gameVars.loadTest.link.jitterMs = std::strtof(argv[++i], nullptr);
+        }
+        else if (withValue("--net-loss")) {
+            gameVars.loadTest.link.lossPercent = std::strtof(argv[++i], nullptr);
+        }
+        else if (withValue("--net-reorder")) {
+            gameVars.loadTest.link.reorderPercent = std::strtof(argv[++i], nullptr);
+        }
+        else if (withValue("--metrics-port")) {
+            gameVars.metricsPort = (uint16_t)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--metrics-overlay") == 0) {
+            gameVars.metricsOverlay = true;
+        }
+        else if (std::strcmp(argv[i], "--no-hot-reload") == 0) {
+            gameVars.hotReload = false;
+        }
+        else if (std::strcmp(argv[i], "--cpu-skinning") == 0) {
+            gameVars.cpuSkinning = true;
+        }
+        else if (withValue("--bots")) {
+            gameVars.botCount = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (missingValue) {
+            std::cout << "Missing value for " << argv[i] << std::endl;
+        }
+        else {
+            std::cout << "Unknown argument: " << argv[i] << std::endl;
+        }
+    }
+}
+
+GLFWwindow* createWindow() {
     glfwInit();
+    // Core 3.3 is all the renderer needs and what Mesa's llvmpipe exposes
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     GLFWwindow* window = glfwCreateWindow(gameVars.screenWidth, gameVars.screenHeight, "Game window", nullptr, nullptr);
     glfwMakeContextCurrent(window);
     gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
@@ -94,40 +604,198 @@ int main() {
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetMouseButtonCallback(window, mouse_button_callback);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    return window;
+}
 
-    glEnable(GL_DEPTH_TEST);
+int main(int argc, char** argv) {
+    parseArgs(argc, argv);
+    if (!gameVars.cookDirectory.empty()) {
+        // Cooking only borrows the physics job system
+        Physics physics;
+        CookStats stats = cookTextures(gameVars.cookDirectory, physics.getJobSystem(), gameVars.forceCook);
+        std::cout << "Cooked " << stats.cooked << " textures (" << stats.upToDate << " up to date, " << stats.failed
+            << " failed): " << stats.sourceBytes / 1024 << " KiB uncompressed -> " << stats.cookedBytes / 1024 << " KiB" << std::endl;
+        return stats.failed > 0 ? 1 : 0;
+    }
 
-    Model model("assets/floor2.fbx");
+    MetricsServer metricsServer;
+    if (gameVars.metricsPort != 0)
+        metricsServer.start(gameVars.metricsPort);
+
+    if (gameVars.loadTestEnabled) {
+        sim = std::make_unique<SimulationVars>(gameVars.startPos, navGrid, PhysicsCapacity::withPlayers(gameVars.loadTest.clients));
+        sim->physics.setDeterministic(gameVars.deterministic);
+        sim->physics.createDefaultFloor();
+        bool weaponsLoaded = weapons.load("weapons/weapons.txt");
+        runLoadTest(sim->physics, &sim->projectiles, weaponsLoaded ? &weapons : nullptr, gameVars.loadTest).print();
+        return 0;
+    }
 
-    Shader shader("shaders/vertex.vert", "shaders/fragment.frag");
+    // Jolt, the window, asset decoding and the world all come up at once. The
+    // renderer compiles its shaders on its own thread while the world loads.
+    GLFWwindow* window = nullptr;
+    std::unique_ptr<Renderer> renderer;
+    ShapeCache shapeCache;
+    bool weaponsLoaded = false;
+
+    StartupGraph startup;
+    StartupGraph::TaskId physicsTask = startup.add("physics", [] {
+        // Room for the local player and every bot on top of the level
+        sim = std::make_unique<SimulationVars>(gameVars.startPos, navGrid, PhysicsCapacity::withPlayers(gameVars.botCount + 1));
+        sim->physics.setDeterministic(gameVars.deterministic);
+    });
+    StartupGraph::TaskId weaponsTask = startup.add("weapons", [&weaponsLoaded] {
+        weaponsLoaded = weapons.load("weapons/weapons.txt");
+    });
+
+    // Bots are drawn with the animated character when there is one
+    startup.add("character", [] {
+        characters.setCpuSkinning(gameVars.cpuSkinning);
+        if ((gameVars.botCount > 0 || match.player.isOpen()) && !characters.load("models/character.fbx"))
+            std::cout << "No character model, bots will be invisible." << std::endl;
+    });
+
+    StartupGraph::TaskId windowTask = startup.addMainThread("window", [&window] {
+        window = createWindow();
+    });
+    // Takes over the GL context, no GL calls on this thread past this point
+    startup.addMainThread("renderer", [&window, &renderer] {
+        renderer = std::make_unique<Renderer>(window, "shaders/vertex.vert", "shaders/fragment.frag");
+    }, { windowTask });
+
+    StartupGraph::TaskId worldTask = startup.add("world", [&shapeCache] {
+        // Playback never moves the local player; the world streams around the recorded actors instead
+        if (match.player.isOpen()) {
+            seekPlayback(0);
+            match.shownFrames = match.player.actors();
+            std::cout << "Playing back " << match.player.tickCount() << " ticks of " << match.player.actors().size()
+                << " actors, Left/Right to seek, Up/Down to switch view" << std::endl;
+        }
+
+        world = std::make_unique<WorldPartition>(sim->physics, shapeCache, WorldPartitionSettings());
+        if (world->load("scenes/main.scene")) {
+            std::vector<glm::vec3> preloadPositions = { sim->playerController.position };
+            for (const ActorFrame& frame : match.shownFrames)
+                preloadPositions.push_back(frame.position);
+            world->preload(preloadPositions);
+        }
+        if (!world->hasCollision()) {
+            std::cout << "Scene has no collision, falling back to the default floor." << std::endl;
+            sim->physics.createDefaultFloor();
+        }
+    }, { physicsTask });
+
+    // Bots navigate the area streamed in around the spawn point
+    startup.add("bots", [] {
+        if (gameVars.botCount > 0 && !match.player.isOpen()
+            && navGrid.build(sim->physics, sim->playerController.position, WorldPartitionSettings().loadRadius)) {
+            sim->bots.spawn(gameVars.botCount);
+            sim->bots.setProjectileSystem(&sim->projectiles);
+            sim->bots.setWeaponTable(&weapons);
+        }
+    }, { worldTask, weaponsTask });
+
+    startup.run();
+
+    sim->playerController.setProjectileSystem(&sim->projectiles);
+    if (weaponsLoaded)
+        sim->playerController.setWeaponTable(&weapons);
+    OcclusionCuller occlusion(sim->physics.getJobSystem());
+
+    if (gameVars.hotReload) {
+        fileWatcher.watch("shaders");
+        fileWatcher.watch("models");
+        for (const std::string& directory : world->modelDirectories())
+            fileWatcher.watch(directory);
+    }
 
     gameVars.fpsTime = glfwGetTime();
 
     while (!glfwWindowShouldClose(window)) {
-        processInput(window);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        glm::mat4 projection = glm::perspective(glm::radians(playerController.currentFov),
-            (float)gameVars.screenWidth / (float)gameVars.screenHeight,
+        Memory::beginFrame();
+        {
+            MemTagScope tag(MemTag::Gameplay);
+            processInput(window);
+        }
+
+        if (match.player.isOpen()) {
+            MemTagScope tag(MemTag::Gameplay);
+            updatePlayback(window);
+        }
+        else if (gameVars.deterministic)
+            runFixedTicks(window);
+        else {
+            // A free-running frame is one variable-length tick
+            auto tickStart = std::chrono::steady_clock::now();
+            {
+                MemTagScope tag(MemTag::Gameplay);
+                sim->bots.update(humanPositions(), gameVars.deltaTime, false);
+            }
+            {
+                MemTagScope tag(MemTag::Physics);
+                sim->physics.update(gameVars.deltaTime);
+            }
+            MemTagScope tag(MemTag::Gameplay);
+            processContacts();
+            sim->projectiles.update(gameVars.deltaTime);
+            resolveExplosions();
+            collectMatchEvents();
+
+            // Recordings are sampled at the fixed tick rate whatever the frame rate
+            match.recordAccumulator += gameVars.deltaTime;
+            for (int ticks = 0; match.recordAccumulator >= Physics::cFixedTimeStep; ticks++) {
+                if (ticks == gameVars.maxTicksPerFrame) {
+                    match.recordAccumulator = 0.0;
+                    break;
+                }
+                recordMatchTick();
+                match.recordAccumulator -= Physics::cFixedTimeStep;
+            }
+
+            std::chrono::duration<double> tickTime = std::chrono::steady_clock::now() - tickStart;
+            Metrics::recordTick(tickTime.count(), Physics::cFixedTimeStep);
+        }
+
+        // A deterministic run streams once per tick instead, see simulateTick
+        MemTagScope streamingTag(MemTag::Streaming);
+        if (match.player.isOpen() || !gameVars.deterministic)
+            world->update(streamingPositions());
+
+        static std::vector<CharacterState> characterStates;
+        characterStates.clear();
+        if (match.player.isOpen())
+            appendPlaybackCharacters(characterStates);
+        else
+            sim->bots.appendCharacters(characterStates);
+        characters.update(characterStates, (float)gameVars.deltaTime);
+
+        // Draws while the next frame simulates
+        MemTagScope renderTag(MemTag::Render);
+        RenderPacket& packet = renderer->beginPacket();
+        float aspect = (float)gameVars.screenWidth / (float)gameVars.screenHeight;
+        packet.viewportWidth = gameVars.screenWidth;
+        packet.viewportHeight = gameVars.screenHeight;
+        float fov = match.player.isOpen() ? gameVars.FOV : sim->playerController.currentFov;
+        packet.projection = glm::perspective(glm::radians(fov), aspect,
             gameVars.nearPlane, gameVars.farPlane);
-
-        glm::mat4 view = playerController.getViewMatrix();
-        glm::mat4 modelMatrix = glm::mat4(1.0f);
-
-        shader.use();
-        shader.setMat4("model", modelMatrix);
-        shader.setMat4("view", view);
-        shader.setMat4("projection", projection);
-
-        model.draw();
+        packet.view = match.player.isOpen() ? spectatorView() : sim->playerController.getViewMatrix();
+        pollHotReload(packet);
+        world->collectDraws(packet);
+        characters.collectDraws(packet);
+        gameVars.shadowStats = buildShadowCascades(gameVars.shadows, packet.view,
+            glm::radians(fov), aspect, gameVars.nearPlane, packet.draws, packet.shadows);
+        if (gameVars.occlusionCulling)
+            gameVars.occlusionStats = occlusion.cull(packet);
+        updateMetricsOverlay(packet);
+        renderer->submit();
 
         updateFPSCounter(window);
-        glfwSwapBuffers(window);
         glfwPollEvents();
-
-        physics.update(gameVars.deltaTime);
     }
 
+    renderer->stop();
+    match.recorder.close();
+    world.reset();  // before the shape cache it borrows
     glfwTerminate();
     return 0;
 }
@@ -1,10 +1,56 @@
 #version 330 core
 in vec2 TexCoord;
+in vec3 WorldPos;
+in vec3 Normal;
+in float ViewDepth;
 
 out vec4 FragColor;
 
 uniform sampler2D texture1;
 
+// Directional light with cascaded shadows, see Shadows.hpp
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 lightViewProjection[4];
+uniform vec4 cascadeSplits;
+uniform int cascadeCount;
+uniform vec3 lightDirection;
+
+const vec3 lightColor = vec3(1.0, 0.96, 0.88);
+const vec3 ambientColor = vec3(0.32, 0.35, 0.42);
+
+float shadowFactor(vec3 normal, float nDotL) {
+	int cascade = cascadeCount;
+	for (int i = 0; i < cascadeCount; i++) {
+		if (ViewDepth < cascadeSplits[i]) {
+			cascade = i;
+			break;
+		}
+	}
+	if (cascade >= cascadeCount)
+		return 1.0;
+
+	// Push the lookup off the surface along the normal, further on grazing angles
+	vec3 offsetPos = WorldPos + normal * (0.02 + 0.05 * (1.0 - nDotL)) * float(cascade + 1);
+	vec4 lightPos = lightViewProjection[cascade] * vec4(offsetPos, 1.0);
+	vec3 coords = lightPos.xyz / lightPos.w * 0.5 + 0.5;
+	if (coords.z > 1.0)
+		return 1.0;
+
+	vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+	float lit = 0.0;
+	for (int x = -1; x <= 1; x++) {
+		for (int y = -1; y <= 1; y++)
+			lit += texture(shadowMap, vec4(coords.xy + vec2(x, y) * texel, float(cascade), coords.z));
+	}
+	return lit / 9.0;
+}
+
 void main() {
-	FragColor = texture(texture1, TexCoord);
-}
\ No newline at end of file
+	vec4 albedo = texture(texture1, TexCoord);
+	vec3 normal = normalize(Normal);
+	float nDotL = max(dot(normal, -lightDirection), 0.0);
+
+	float shadow = nDotL > 0.0 ? shadowFactor(normal, nDotL) : 0.0;
+	vec3 lighting = ambientColor + lightColor * nDotL * shadow;
+	FragColor = vec4(albedo.rgb * lighting, albedo.a);
+}
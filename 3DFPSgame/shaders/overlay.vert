@@ -0,0 +1,8 @@
+#version 330 core
+layout (location = 0) in vec2 aPos;  // pixels from the top left corner
+
+uniform vec2 viewport;
+
+void main() {
+    gl_Position = vec4(aPos.x / viewport.x * 2.0 - 1.0, 1.0 - aPos.y / viewport.y * 2.0, 0.0, 1.0);
+}
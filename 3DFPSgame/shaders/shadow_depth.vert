@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 3) in uvec4 aJoints;
+layout (location = 4) in vec4 aWeights;
+
+uniform mat4 model;
+uniform mat4 lightViewProjection;
+
+uniform bool skinned;
+uniform mat4 joints[64];
+
+void main() {
+    mat4 skin = mat4(1.0);
+    if (skinned) {
+        skin = aWeights.x * joints[aJoints.x] + aWeights.y * joints[aJoints.y]
+            + aWeights.z * joints[aJoints.z] + aWeights.w * joints[aJoints.w];
+    }
+    gl_Position = lightViewProjection * model * skin * vec4(aPos, 1.0);
+}
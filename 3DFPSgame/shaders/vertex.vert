@@ -2,14 +2,36 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in uvec4 aJoints;
+layout (location = 4) in vec4 aWeights;
 
 out vec2 TexCoord;
+out vec3 WorldPos;
+out vec3 Normal;
+out float ViewDepth;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// GPU skinning, see Animation.hpp; CPU-skinned meshes arrive already posed
+uniform bool skinned;
+uniform mat4 joints[64];
+
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    mat4 skin = mat4(1.0);
+    if (skinned) {
+        skin = aWeights.x * joints[aJoints.x] + aWeights.y * joints[aJoints.y]
+            + aWeights.z * joints[aJoints.z] + aWeights.w * joints[aJoints.w];
+    }
+
+    vec4 worldPos = model * skin * vec4(aPos, 1.0);
+    vec4 viewPos = view * worldPos;
+    gl_Position = projection * viewPos;
+
     TexCoord = aTexCoord;
-}
\ No newline at end of file
+    WorldPos = worldPos.xyz;
+    // Scene placements only use uniform scale, so the model matrix works for normals
+    Normal = mat3(model) * mat3(skin) * aNormal;
+    ViewDepth = -viewPos.z;
+}